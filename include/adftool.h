@@ -75,6 +75,12 @@
 # define LIBADFTOOL_DEALLOC_FIR \
   LIBADFTOOL_DEALLOC (adftool_fir_free, 1)
 
+# define LIBADFTOOL_DEALLOC_FIR_STREAM \
+  LIBADFTOOL_DEALLOC (adftool_fir_stream_free, 1)
+
+# define LIBADFTOOL_DEALLOC_IIR \
+  LIBADFTOOL_DEALLOC (adftool_iir_free, 1)
+
 # define LIBADFTOOL_DEALLOC_TIMESPEC \
   LIBADFTOOL_DEALLOC (adftool_timespec_free, 1)
 
@@ -96,6 +102,9 @@
 # define LIBADFTOOL_DEALLOC_CHANNEL_PROCESSOR_GROUP \
   LIBADFTOOL_DEALLOC (adftool_channel_processor_group_free, 1)
 
+# define LIBADFTOOL_DEALLOC_EEG_APPENDER \
+  LIBADFTOOL_DEALLOC (adftool_eeg_appender_free, 1)
+
 # ifdef __cplusplus
 extern "C"
 {
@@ -333,6 +342,41 @@ extern "C"
     int adftool_eeg_set_data (struct adftool_file *file, size_t n_points,
 			      size_t n_channels, const double *data);
 
+# define ADFTOOL_EEG_COMPRESSION_NONE 0
+# define ADFTOOL_EEG_COMPRESSION_DEFLATE 1
+# define ADFTOOL_EEG_COMPRESSION_LZ4 2
+
+  extern LIBADFTOOL_API
+    int adftool_eeg_set_data_chunked (struct adftool_file *file,
+				      size_t n_points, size_t n_channels,
+				      const double *data,
+				      size_t chunk_points,
+				      size_t chunk_channels, int compression,
+				      int compression_level);
+
+  struct adftool_eeg_appender;
+
+  extern LIBADFTOOL_API
+    void adftool_eeg_appender_free (struct adftool_eeg_appender *appender);
+
+  LIBADFTOOL_DEALLOC_EEG_APPENDER extern LIBADFTOOL_API
+    struct adftool_eeg_appender *adftool_eeg_appender_alloc (struct
+							     adftool_file
+							     *file,
+							     size_t
+							     n_channels,
+							     const double
+							     *physical_min,
+							     const double
+							     *physical_max);
+
+  extern LIBADFTOOL_API
+    int adftool_eeg_appender_push (struct adftool_eeg_appender *appender,
+				   size_t n_points, const double *data);
+
+  extern LIBADFTOOL_API
+    int adftool_eeg_appender_finish (struct adftool_eeg_appender *appender);
+
   extern LIBADFTOOL_API
     int adftool_eeg_get_data (struct adftool_file *file,
 			      size_t time_start, size_t time_length,
@@ -340,6 +384,29 @@ extern "C"
 			      size_t channel_length, size_t *channel_max,
 			      double *data);
 
+  extern LIBADFTOOL_API
+    int adftool_eeg_get_data_float (struct adftool_file *file,
+				    size_t time_start, size_t time_length,
+				    size_t *time_max, size_t channel_start,
+				    size_t channel_length,
+				    size_t *channel_max, float *data);
+
+  extern LIBADFTOOL_API
+    int adftool_eeg_get_data_raw (struct adftool_file *file,
+				  size_t time_start, size_t time_length,
+				  size_t *time_max, size_t channel_start,
+				  size_t channel_length, size_t *channel_max,
+				  uint16_t * data, size_t *block_length,
+				  double *scales, double *offsets);
+
+  extern LIBADFTOOL_API
+    int adftool_eeg_get_envelope (struct adftool_file *file,
+				  size_t time_start, size_t time_length,
+				  size_t n_pixels, size_t channel_start,
+				  size_t channel_length, size_t *first_bin,
+				  size_t *bin_length, size_t *n_bins,
+				  double *min, double *max, double *mean);
+
   extern LIBADFTOOL_API
     int adftool_eeg_get_time (struct adftool_file *file,
 			      size_t observation, struct timespec *time,
@@ -384,6 +451,89 @@ extern "C"
 			    size_t signal_length, const double *signal,
 			    double *filtered);
 
+  extern LIBADFTOOL_API
+    size_t adftool_fir_apply_decimated (const struct adftool_fir *filter,
+					size_t signal_length,
+					const double *signal,
+					size_t decimation, double *filtered);
+
+  extern LIBADFTOOL_API
+    void adftool_fir_release (const struct adftool_fir *filter);
+
+  extern LIBADFTOOL_API
+    const struct adftool_fir *adftool_fir_acquire (double sfreq,
+						   double freq_low,
+						   double freq_high,
+						   double trans_low,
+						   double trans_high);
+
+  extern LIBADFTOOL_API
+    void adftool_fir_apply_multi (const struct adftool_fir *filter,
+				  size_t signal_length, size_t n_channels,
+				  int channel_major, const double *signal,
+				  double *filtered);
+
+  struct adftool_fir_stream;
+
+  extern LIBADFTOOL_API
+    void adftool_fir_stream_free (struct adftool_fir_stream *stream);
+
+  LIBADFTOOL_DEALLOC_FIR_STREAM extern LIBADFTOOL_API
+    struct adftool_fir_stream *adftool_fir_stream_alloc (const struct
+							 adftool_fir
+							 *filter);
+
+  LIBADFTOOL_DEALLOC_FIR_STREAM extern LIBADFTOOL_API
+    struct adftool_fir_stream
+    *adftool_fir_stream_alloc_decimated (const struct adftool_fir *filter,
+					 size_t decimation);
+
+  extern LIBADFTOOL_API
+    void adftool_fir_stream_reset (struct adftool_fir_stream *stream,
+				   size_t history_length,
+				   const double *history);
+
+  extern LIBADFTOOL_API
+    int adftool_fir_stream_push (struct adftool_fir_stream *stream,
+				 size_t n_samples, const double *samples,
+				 size_t *n_filtered, double *filtered);
+
+  extern LIBADFTOOL_API
+    int adftool_fir_stream_finish (struct adftool_fir_stream *stream,
+				   size_t *n_filtered, double *filtered);
+
+  struct adftool_iir;
+
+  extern LIBADFTOOL_API void adftool_iir_free (struct adftool_iir *filter);
+
+  LIBADFTOOL_DEALLOC_IIR extern LIBADFTOOL_API
+    struct adftool_iir *adftool_iir_alloc (size_t order);
+
+  extern LIBADFTOOL_API
+    size_t adftool_iir_order (const struct adftool_iir *filter);
+
+  extern LIBADFTOOL_API
+    void adftool_iir_design_bandpass (struct adftool_iir *filter,
+				      double sfreq,
+				      double freq_low, double freq_high);
+
+  extern LIBADFTOOL_API
+    size_t adftool_iir_settle_length (const struct adftool_iir *filter);
+
+  extern LIBADFTOOL_API
+    void adftool_iir_apply (const struct adftool_iir *filter,
+			    size_t signal_length, const double *signal,
+			    double *filtered);
+
+  extern LIBADFTOOL_API
+    int adftool_iir_apply_zero_phase (const struct adftool_iir *filter,
+				      size_t signal_length,
+				      const double *signal,
+				      double *filtered);
+
+# define ADFTOOL_FILTER_FIR 0
+# define ADFTOOL_FILTER_IIR 1
+
   /* These API functions are needed for emscripten, because it’s not
      easy to compute the address of something in JS. */
 
@@ -537,6 +687,17 @@ extern "C"
 					    file_synchronizer,
 					    size_t max_active_channels);
 
+  LIBADFTOOL_DEALLOC_CHANNEL_PROCESSOR_GROUP extern LIBADFTOOL_API
+    struct adftool_channel_processor_group
+    *adftool_channel_processor_group_alloc_with_cache (struct adftool_file
+						       *file,
+						       pthread_mutex_t *
+						       file_synchronizer,
+						       size_t
+						       max_active_channels,
+						       size_t page_length,
+						       size_t cache_budget);
+
   extern LIBADFTOOL_API int
     adftool_channel_processor_group_get (struct
 					 adftool_channel_processor_group
@@ -549,6 +710,68 @@ extern "C"
 					 size_t *nearest_length,
 					 double *data);
 
+  extern LIBADFTOOL_API int
+    adftool_channel_processor_group_get_derived (struct
+						 adftool_channel_processor_group
+						 *group, size_t n_terms,
+						 const struct adftool_term
+						 *const *channel_types,
+						 const double *weights,
+						 int filter_family,
+						 double filter_low,
+						 double filter_high,
+						 size_t decimation,
+						 size_t start_index,
+						 size_t length,
+						 size_t *nearest_start,
+						 size_t *nearest_length,
+						 double *data);
+
+  extern LIBADFTOOL_API size_t
+    adftool_channel_processor_group_spectrogram_bins (struct
+						      adftool_channel_processor_group
+						      *group,
+						      size_t window_length,
+						      double freq_low,
+						      double freq_high,
+						      double *first_frequency,
+						      double *bin_width);
+
+  extern LIBADFTOOL_API int
+    adftool_channel_processor_group_get_spectrogram (struct
+						     adftool_channel_processor_group
+						     *group, size_t n_terms,
+						     const struct adftool_term
+						     *const *channel_types,
+						     const double *weights,
+						     size_t window_length,
+						     size_t hop,
+						     double freq_low,
+						     double freq_high,
+						     size_t start_frame,
+						     size_t n_frames,
+						     size_t *nearest_start,
+						     size_t *nearest_length,
+						     double *power);
+
+  extern LIBADFTOOL_API void
+    adftool_channel_processor_group_set_notification (struct
+						      adftool_channel_processor_group
+						      *group,
+						      void (*notify) (void *),
+						      void *context);
+
+  extern LIBADFTOOL_API void
+    adftool_channel_processor_group_set_page_compression (struct
+							  adftool_channel_processor_group
+							  *group,
+							  int compress);
+
+  extern LIBADFTOOL_API int
+    adftool_channel_processor_group_start_workers (struct
+						   adftool_channel_processor_group
+						   *group, size_t n_workers);
+
   extern LIBADFTOOL_API int
     adftool_channel_processor_group_populate_cache (struct
 						    adftool_channel_processor_group
@@ -1585,6 +1808,54 @@ namespace adftool
 	  return std::nullopt;
 	}
     }
+    std::optional<std::tuple<size_t, size_t, std::vector<float>>> get_eeg_data_float (size_t time_start, size_t n_times, size_t channel) const
+    {
+      size_t time_max, channel_max;
+      std::vector<float> output;
+      output.resize (n_times);
+      std::fill (output.begin (), output.end (), NAN);
+      int c_error = adftool_eeg_get_data_float (this->ptr, time_start, n_times, &time_max, channel, 1, &channel_max, output.data ());
+      if (c_error == 0)
+	{
+	  return std::tuple<size_t, size_t, std::vector<float>> (time_max, channel_max, output);
+	}
+      else
+	{
+	  return std::nullopt;
+	}
+    }
+    /* The codes, the block length, and the decoder of each block. */
+    std::optional<std::tuple<size_t, size_t, std::vector<uint16_t>, size_t, std::vector<double>, std::vector<double>>> get_eeg_data_raw (size_t time_start, size_t n_times, size_t channel) const
+    {
+      size_t time_max, channel_max, block_length;
+      int c_error = adftool_eeg_get_data_raw (this->ptr, 0, 0, &time_max, 0, 0, &channel_max, NULL, &block_length, NULL, NULL);
+      if (c_error != 0)
+	{
+	  return std::nullopt;
+	}
+      size_t n_blocks = 0;
+      if (n_times != 0)
+	{
+	  n_blocks = (time_start + n_times - 1) / block_length - time_start / block_length + 1;
+	}
+      std::vector<uint16_t> output;
+      std::vector<double> scales;
+      std::vector<double> offsets;
+      output.resize (n_times);
+      scales.resize (n_blocks);
+      offsets.resize (n_blocks);
+      std::fill (scales.begin (), scales.end (), NAN);
+      std::fill (offsets.begin (), offsets.end (), NAN);
+      c_error = adftool_eeg_get_data_raw (this->ptr, time_start, n_times, &time_max, channel, 1, &channel_max, output.data (), &block_length, scales.data (), offsets.data ());
+      if (c_error == 0)
+	{
+	  return std::tuple<size_t, size_t, std::vector<uint16_t>, size_t, std::vector<double>, std::vector<double>> (time_max, channel_max, output, block_length, scales, offsets);
+	}
+      else
+	{
+	  return std::nullopt;
+	}
+    }
   };
 }
 /* *INDENT-ON* */
@@ -7,7 +7,6 @@
 #include <locale.h>
 #include <attribute.h>
 #include <adftool.h>
-#include <time.h>
 #include <pthread.h>
 #include "readline.h"
 #include "safe-alloc.h"
@@ -30,17 +29,10 @@
 
 static inline int parse_command (void);
 
-static int continue_thread = 0;
 static pthread_mutex_t file_synchronizer;
 static struct adftool_file *file;
 static struct adftool_channel_processor_group *group = NULL;
 
-static void *worker_thread (void *ctx);
-
-#define NUM_THREADS 7
-
-static pthread_t threads[NUM_THREADS];
-
 int
 main (int argc, char *argv[])
 {
@@ -71,36 +63,22 @@ main (int argc, char *argv[])
       fprintf (stderr, "Cannot allocate a group.\n");
       return 1;
     }
-  continue_thread = 1;
-  for (size_t i = 0; i < NUM_THREADS; i++)
-    {
-      if (pthread_create (&(threads[i]), NULL, worker_thread, NULL) != 0)
-	{
-	  fprintf (stderr, "Cannot create a thread.\n");
-	  return 1;
-	}
-    }
-  while (parse_command () != 0)
-    {
-      /* continue */
-    }
-  if (pthread_mutex_lock (&file_synchronizer) != 0)
+  /* Compressed pages keep more history, at the cost of unpacking
+     them on each request. */
+  const char *compress_pages = getenv ("ADFTOOL_MT_COMPRESS_PAGES");
+  if (compress_pages != NULL && *compress_pages != '\0'
+      && STRNEQ (compress_pages, "0"))
     {
-      abort ();
+      adftool_channel_processor_group_set_page_compression (group, 1);
     }
-  continue_thread = 0;
-  if (pthread_mutex_unlock (&file_synchronizer) != 0)
+  if (adftool_channel_processor_group_start_workers (group, 0) != 0)
     {
-      abort ();
+      fprintf (stderr, "Cannot create a thread.\n");
+      return 1;
     }
-  for (size_t i = 0; i < NUM_THREADS; i++)
+  while (parse_command () != 0)
     {
-      void *retval = NULL;
-      if (pthread_join (threads[i], &retval) != 0)
-	{
-	  fprintf (stderr, "Cannot cancel a thread.\n");
-	  return 1;
-	}
+      /* continue */
     }
   adftool_channel_processor_group_free (group);
   adftool_file_close (file);
@@ -109,8 +87,12 @@ main (int argc, char *argv[])
 }
 
 static int read_header (struct adftool_term **channel_type,
+			struct adftool_term **reference,
+			int *filter_family,
 			double *filter_low,
 			double *filter_high,
+			size_t *decimation,
+			size_t *spectrogram_window,
 			size_t *start_index, size_t *length, int *done);
 
 static inline int
@@ -118,30 +100,81 @@ parse_command (void)
 {
   int cont = 0;
   struct adftool_term *channel_type = NULL;
+  struct adftool_term *reference = NULL;
+  int filter_family = ADFTOOL_FILTER_FIR;
   double filter_low = 0.53, filter_high = 35.0;
+  size_t decimation = 1;
+  size_t spectrogram_window = 0;
   size_t start_index = 0, length = 5120;
   int done = 0;
   do
     {
       cont =
-	read_header (&channel_type, &filter_low, &filter_high, &start_index,
-		     &length, &done);
+	read_header (&channel_type, &reference, &filter_family, &filter_low,
+		     &filter_high, &decimation, &spectrogram_window,
+		     &start_index, &length, &done);
     }
   while (!done);
   if (channel_type != NULL)
     {
       size_t nearest_start, nearest_length;
-      double *data = calloc (length, sizeof (double));
+      /* With a spectrogram window, each line is a frame, the
+         decimation is the hop and the filter band is the frequency
+         band. */
+      double first_frequency = 0, bin_width = 0;
+      size_t n_bins = 1;
+      if (spectrogram_window != 0)
+	{
+	  n_bins =
+	    adftool_channel_processor_group_spectrogram_bins (group,
+							      spectrogram_window,
+							      filter_low,
+							      filter_high,
+							      &first_frequency,
+							      &bin_width);
+	}
+      double *data = calloc (length * n_bins, sizeof (double));
       if (data == NULL)
 	{
 	  abort ();
 	}
-      int error =
-	adftool_channel_processor_group_get (group, channel_type, filter_low,
-					     filter_high, start_index, length,
-					     &nearest_start, &nearest_length,
-					     data);
-      if (error < 0)
+      /* With a reference, the bipolar derivation is filtered. */
+      const struct adftool_term *terms[] = { channel_type, reference };
+      static const double weights[] = { 1, -1 };
+      int error;
+      if (spectrogram_window != 0)
+	{
+	  error =
+	    adftool_channel_processor_group_get_spectrogram (group,
+							     (reference ? 2 :
+							      1), terms,
+							     weights,
+							     spectrogram_window,
+							     decimation,
+							     filter_low,
+							     filter_high,
+							     start_index,
+							     length,
+							     &nearest_start,
+							     &nearest_length,
+							     data);
+	}
+      else
+	{
+	  error =
+	    adftool_channel_processor_group_get_derived (group,
+							 (reference ? 2 : 1),
+							 terms, weights,
+							 filter_family,
+							 filter_low,
+							 filter_high,
+							 decimation,
+							 start_index, length,
+							 &nearest_start,
+							 &nearest_length,
+							 data);
+	}
+      if (error < 0 || n_bins == 0)
 	{
 	  printf ("HTTP/1.1 400 Bad Request\r\n" "\r\n");
 	}
@@ -149,25 +182,40 @@ parse_command (void)
 	{
 	  printf ("HTTP/1.1 200 OK\r\n"
 		  "Adftool-Start: %lu\r\n"
-		  "Adftool-Length: %lu\r\n"
-		  "Content-Type: text/plain\r\n"
-		  "\r\n", nearest_start, nearest_length);
+		  "Adftool-Length: %lu\r\n", nearest_start, nearest_length);
+	  if (spectrogram_window != 0)
+	    {
+	      printf ("Adftool-First-Frequency: %.12g\r\n"
+		      "Adftool-Bin-Width: %.12g\r\n", first_frequency,
+		      bin_width);
+	    }
+	  printf ("Content-Type: text/plain\r\n" "\r\n");
 	  for (size_t i = 0; i < length; i++)
 	    {
-	      printf ("%.12g\r\n", data[i]);
+	      for (size_t b = 0; b < n_bins; b++)
+		{
+		  printf ("%s%.12g", (b == 0 ? "" : " "),
+			  data[i * n_bins + b]);
+		}
+	      printf ("\r\n");
 	    }
 	  printf ("\r\n");
 	}
       free (data);
     }
+  adftool_term_free (reference);
   adftool_term_free (channel_type);
   return cont;
 }
 
 static int
 read_header (struct adftool_term **channel_type,
+	     struct adftool_term **reference,
+	     int *filter_family,
 	     double *filter_low,
 	     double *filter_high,
+	     size_t *decimation,
+	     size_t *spectrogram_window,
 	     size_t *start_index, size_t *length, int *done)
 {
   char *line = readline ("HTTP header: ");
@@ -222,13 +270,15 @@ read_header (struct adftool_term **channel_type,
     && strncmp (line + header_name_start, \
                 header, \
 		strlen (header)) == 0)
-  if (HEADER_IS ("adftool-channel-type"))
+  if (HEADER_IS ("adftool-channel-type") || HEADER_IS ("adftool-reference"))
     {
+      struct adftool_term **term =
+	(HEADER_IS ("adftool-channel-type") ? channel_type : reference);
       size_t consumed = 0;
-      if (*channel_type == NULL)
+      if (*term == NULL)
 	{
-	  *channel_type = adftool_term_alloc ();
-	  if (*channel_type == NULL)
+	  *term = adftool_term_alloc ();
+	  if (*term == NULL)
 	    {
 	      abort ();
 	    }
@@ -238,8 +288,7 @@ read_header (struct adftool_term **channel_type,
 	  header_value++;
 	}
       if (adftool_term_parse_n3
-	  (header_value, strlen (header_value), &consumed,
-	   *channel_type) != 0)
+	  (header_value, strlen (header_value), &consumed, *term) != 0)
 	{
 	  printf ("HTTP/1.1 400 Bad Request\r\n\r\n");
 	  goto cleanup;
@@ -252,6 +301,26 @@ read_header (struct adftool_term **channel_type,
 	  goto cleanup;
 	}
     }
+  else if (HEADER_IS ("adftool-filter"))
+    {
+      while (*header_value == ' ' || *header_value == '\t')
+	{
+	  header_value++;
+	}
+      if (STREQ (header_value, "fir") || STREQ (header_value, "FIR"))
+	{
+	  *filter_family = ADFTOOL_FILTER_FIR;
+	}
+      else if (STREQ (header_value, "iir") || STREQ (header_value, "IIR"))
+	{
+	  *filter_family = ADFTOOL_FILTER_IIR;
+	}
+      else
+	{
+	  printf ("HTTP/1.1 400 Bad Request\r\n\r\n");
+	  goto cleanup;
+	}
+    }
   else if (HEADER_IS ("adftool-highpass") || HEADER_IS ("adftool-lowpass"))
     {
       char *enddouble = NULL;
@@ -300,7 +369,9 @@ read_header (struct adftool_term **channel_type,
 	  *filter_high = value_hz;
 	}
     }
-  else if (HEADER_IS ("adftool-start-index") || HEADER_IS ("adftool-length"))
+  else if (HEADER_IS ("adftool-start-index") || HEADER_IS ("adftool-length")
+	   || HEADER_IS ("adftool-decimation")
+	   || HEADER_IS ("adftool-spectrogram-window"))
     {
       char *endvalue = NULL;
       size_t value = strtoul (header_value, &endvalue, 10);
@@ -316,6 +387,19 @@ read_header (struct adftool_term **channel_type,
 	    {
 	      *start_index = value;
 	    }
+	  else if (HEADER_IS ("adftool-decimation"))
+	    {
+	      if (value == 0)
+		{
+		  printf ("HTTP/1.1 400 Bad Request\r\n\r\n");
+		  goto cleanup;
+		}
+	      *decimation = value;
+	    }
+	  else if (HEADER_IS ("adftool-spectrogram-window"))
+	    {
+	      *spectrogram_window = value;
+	    }
 	  else
 	    {
 	      *length = value;
@@ -332,45 +416,3 @@ cleanup:
   FREE (line);
   return 1;
 }
-
-static void *
-worker_thread (void *ctx)
-{
-  (void) ctx;
-  int work_done = 0;
-  int my_continue = 1;
-  do
-    {
-      if (adftool_channel_processor_group_populate_cache (group, &work_done) <
-	  0)
-	{
-	  fprintf (stderr, "Error: thread failed.\n");
-	  return NULL;
-	}
-      if (!work_done)
-	{
-	  /* Sleep a bit. */
-	  static const struct timespec sleep_request = {
-	    .tv_sec = 0,
-	    .tv_nsec = 150 * 1000 * 1000
-	  };
-	  struct timespec sleep_remaining = { 0 };
-	  if (nanosleep (&sleep_request, &sleep_remaining) != 0)
-	    {
-	      fprintf (stderr, "Error: thread can’t sleep.\n");
-	      return NULL;
-	    }
-	}
-      if (pthread_mutex_lock (&file_synchronizer) != 0)
-	{
-	  abort ();
-	}
-      my_continue = continue_thread;
-      if (pthread_mutex_unlock (&file_synchronizer) != 0)
-	{
-	  abort ();
-	}
-    }
-  while (my_continue);
-  return NULL;
-}
@@ -94,6 +94,8 @@ static PyObject *add_channel_type (struct adftool_py_file *, PyObject *);
 static PyObject *get_channel_types (struct adftool_py_file *, PyObject *);
 static PyObject *find_channels_by_type (struct adftool_py_file *, PyObject *);
 static PyObject *eeg_get_data (struct adftool_py_file *, PyObject *);
+static PyObject *eeg_get_data_float (struct adftool_py_file *, PyObject *);
+static PyObject *eeg_get_data_raw (struct adftool_py_file *, PyObject *);
 static PyObject *eeg_set_data (struct adftool_py_file *, PyObject *);
 static PyObject *eeg_get_time (struct adftool_py_file *, PyObject *);
 static PyObject *eeg_set_time (struct adftool_py_file *, PyObject *);
@@ -240,6 +242,16 @@ static PyMethodDef adftool_file_methods[] = {
    N_("Query all the channels of a specific type.")},
   {"get_eeg_data", (PyCFunction) eeg_get_data, METH_NOARGS,
    N_("Get the raw EEG data.")},
+  {"get_eeg_data_float", (PyCFunction) eeg_get_data_float, METH_VARARGS,
+   N_("Get the raw EEG data from an optional start for an optional "
+      "length, as a bytes object of row-oriented single precision "
+      "floats.")},
+  {"get_eeg_data_raw", (PyCFunction) eeg_get_data_raw, METH_VARARGS,
+   N_("Get the raw EEG data from an optional start for an optional "
+      "length, without decoding it. Return the number of observations, "
+      "the number of channels, a bytes object of row-oriented unsigned "
+      "16-bit codes, the block length, and the list of scales and "
+      "offsets of each block.")},
   {"set_eeg_data", (PyCFunction) eeg_set_data, METH_VARARGS,
    N_("Set all the raw EEG data at once.")},
   {"get_eeg_time", (PyCFunction) eeg_get_time, METH_NOARGS,
@@ -1369,6 +1381,132 @@ eeg_get_data (struct adftool_py_file *self, PyObject * args)
   return full;
 }
 
+static int
+eeg_get_window (struct adftool_py_file *self, PyObject * args,
+		Py_ssize_t *start, Py_ssize_t *length, size_t *n_channels)
+{
+  /* Parse the optional window, and clip it to the recording. */
+  size_t n_times;
+  *start = 0;
+  *length = -1;
+  if (!PyArg_ParseTuple (args, "|nn", start, length))
+    {
+      return 1;
+    }
+  int error =
+    adftool_eeg_get_data (self->ptr, 0, 0, &n_times, 0, 0, n_channels, NULL);
+  if (error)
+    {
+      PyErr_SetString (adftool_io_error, _("No EEG data in the file."));
+      return 1;
+    }
+  if (*start < 0 || (size_t) *start > n_times)
+    {
+      *start = n_times;
+    }
+  if (*length < 0 || (size_t) (*start + *length) > n_times)
+    {
+      *length = n_times - *start;
+    }
+  return 0;
+}
+
+static PyObject *
+eeg_get_data_float (struct adftool_py_file *self, PyObject * args)
+{
+  Py_ssize_t start, length;
+  size_t n_channels, time_check, chan_check;
+  if (eeg_get_window (self, args, &start, &length, &n_channels) != 0)
+    {
+      return NULL;
+    }
+  PyObject *bytes =
+    PyBytes_FromStringAndSize (NULL, length * n_channels * sizeof (float));
+  if (bytes == NULL)
+    {
+      return NULL;
+    }
+  int error =
+    adftool_eeg_get_data_float (self->ptr, start, length, &time_check, 0,
+				n_channels, &chan_check,
+				(float *) PyBytes_AsString (bytes));
+  if (error)
+    {
+      PyErr_SetString (adftool_io_error, _("No EEG data in the file."));
+      Py_DECREF (bytes);
+      return NULL;
+    }
+  PyObject *full = Py_BuildValue ("(nnO)", length, n_channels, bytes);
+  Py_DECREF (bytes);
+  return full;
+}
+
+static PyObject *
+eeg_get_data_raw (struct adftool_py_file *self, PyObject * args)
+{
+  Py_ssize_t start, length;
+  size_t n_channels, time_check, chan_check, block_length;
+  if (eeg_get_window (self, args, &start, &length, &n_channels) != 0)
+    {
+      return NULL;
+    }
+  int error =
+    adftool_eeg_get_data_raw (self->ptr, 0, 0, &time_check, 0, 0,
+			      &chan_check, NULL, &block_length, NULL, NULL);
+  if (error)
+    {
+      PyErr_SetString (adftool_io_error, _("No EEG data in the file."));
+      return NULL;
+    }
+  size_t n_blocks = 0;
+  if (length != 0)
+    {
+      n_blocks = (start + length - 1) / block_length - start / block_length + 1;
+    }
+  PyObject *bytes = PyBytes_FromStringAndSize (NULL,
+					       length * n_channels
+					       * sizeof (uint16_t));
+  double *scales = malloc (n_blocks * n_channels * sizeof (double));
+  double *offsets = malloc (n_blocks * n_channels * sizeof (double));
+  if (bytes == NULL || scales == NULL || offsets == NULL)
+    {
+      Py_XDECREF (bytes);
+      free (scales);
+      free (offsets);
+      return NULL;
+    }
+  error =
+    adftool_eeg_get_data_raw (self->ptr, start, length, &time_check, 0,
+			      n_channels, &chan_check,
+			      (uint16_t *) PyBytes_AsString (bytes),
+			      &block_length, scales, offsets);
+  if (error)
+    {
+      PyErr_SetString (adftool_io_error, _("No EEG data in the file."));
+      Py_DECREF (bytes);
+      free (scales);
+      free (offsets);
+      return NULL;
+    }
+  PyObject *py_scales = PyList_New (n_blocks * n_channels);
+  PyObject *py_offsets = PyList_New (n_blocks * n_channels);
+  for (size_t i = 0; i < n_blocks * n_channels; i++)
+    {
+      error = PyList_SetItem (py_scales, i, PyFloat_FromDouble (scales[i]));
+      assert (error == 0);
+      error = PyList_SetItem (py_offsets, i, PyFloat_FromDouble (offsets[i]));
+      assert (error == 0);
+    }
+  free (scales);
+  free (offsets);
+  PyObject *full = Py_BuildValue ("(nnOnOO)", length, n_channels, bytes,
+				  block_length, py_scales, py_offsets);
+  Py_DECREF (bytes);
+  Py_DECREF (py_scales);
+  Py_DECREF (py_offsets);
+  return full;
+}
+
 static PyObject *
 eeg_set_data (struct adftool_py_file *self, PyObject * args)
 {
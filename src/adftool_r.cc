@@ -563,6 +563,33 @@ namespace adftool_r
 	}
       return ret;
     }
+    Rcpp::List get_eeg_data_raw (size_t start, size_t length, size_t channel) const
+    {
+      Rcpp::List ret = Rcpp::List ();
+      const std::string n_key = "n";
+      const std::string p_key = "p";
+      const std::string data_key = "data";
+      const std::string block_length_key = "block_length";
+      const std::string scales_key = "scales";
+      const std::string offsets_key = "offsets";
+      const auto data = t.get_eeg_data_raw (start, length, channel);
+      if (data.has_value ())
+	{
+	  ret[n_key] = std::get<0> (data.value ());
+	  ret[p_key] = std::get<1> (data.value ());
+	  std::vector<uint16_t> codes = std::get<2> (data.value ());
+	  Rcpp::IntegerVector r_codes = Rcpp::IntegerVector (codes.size ());
+	  for (auto i = codes.begin (); i != codes.end (); i++)
+	    {
+	      r_codes[i - codes.begin ()] = *i;
+	    }
+	  ret[data_key] = r_codes;
+	  ret[block_length_key] = std::get<3> (data.value ());
+	  ret[scales_key] = Rcpp::wrap (std::get<4> (data.value ()));
+	  ret[offsets_key] = Rcpp::wrap (std::get<5> (data.value ()));
+	}
+      return ret;
+    }
   };
 }
 
@@ -636,7 +663,8 @@ _rcpp_module_boot_adftool ()
     .method ("delete", &adftool_r::file::delete_statement, _("Try and delete all statements that match a pattern in file. Return wether it succeeded."))
     .method ("insert", &adftool_r::file::insert_statement, _("Try and insert a new statement in file. Return wether it succeeded."))
     .method ("set_eeg_data", &adftool_r::file::set_eeg_data, _("Try and set all the EEG data at once. Return wether it succeeded. The data must be row-oriented."))
-    .method ("get_eeg_data", &adftool_r::file::get_eeg_data, _("Read a temporal slice of a channel. If the request is larger than what is available, fill the rest with NAN values. The return value is a list, with key n bound to the number of time points available, p bound to the total number of channels, and data bound to the requested data."));
+    .method ("get_eeg_data", &adftool_r::file::get_eeg_data, _("Read a temporal slice of a channel. If the request is larger than what is available, fill the rest with NAN values. The return value is a list, with key n bound to the number of time points available, p bound to the total number of channels, and data bound to the requested data."))
+    .method ("get_eeg_data_raw", &adftool_r::file::get_eeg_data_raw, _("Read a temporal slice of a channel, without decoding it. The return value is a list, with key n bound to the number of time points available, p bound to the total number of channels, data bound to the integer codes, block_length bound to the number of observations that share a decoder, and scales and offsets bound to the decoder of each block touched by the request. Observation start + i is decoded as data[i] * scales[b] + offsets[b], where b is (start + i) %/% block_length - start %/% block_length."));
   /* Rcpp stuff: */
   Rcpp::XPtr<Rcpp::Module> mod_xp (&adftool, false);
   ::setCurrentScope (0);
@@ -0,0 +1,110 @@
+#include <config.h>
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+#include "libadftool/eeg_kernels.h"
+
+/* Compare the speed of the decoding and encoding kernels on a
+   256-channel recording. This is not a test: run it with make
+   bench. */
+
+#define N_ROWS 4096
+#define N_CHANNELS 256
+#define N_REPETITIONS 50
+
+static const char *isa_names[] = { "scalar", "sse2", "avx2" };
+
+static double
+elapsed (const struct timespec *start, const struct timespec *stop)
+{
+  return ((stop->tv_sec - start->tv_sec)
+	  + 1e-9 * (stop->tv_nsec - start->tv_nsec));
+}
+
+static void
+benchmark_isa (enum eeg_kernels_isa isa, double *decode_time,
+	       double *encode_time)
+{
+  uint16_t *encoded = malloc (N_ROWS * N_CHANNELS * sizeof (uint16_t));
+  double *scales = malloc (N_CHANNELS * sizeof (double));
+  double *offsets = malloc (N_CHANNELS * sizeof (double));
+  double *decoded = malloc (N_ROWS * N_CHANNELS * sizeof (double));
+  if (encoded == NULL || scales == NULL || offsets == NULL
+      || decoded == NULL)
+    {
+      abort ();
+    }
+  for (size_t j = 0; j < N_CHANNELS; j++)
+    {
+      scales[j] = 1e-3;
+      offsets[j] = -32.768;
+    }
+  for (size_t i = 0; i < N_ROWS * N_CHANNELS; i++)
+    {
+      encoded[i] = i % 65536;
+    }
+  struct timespec decode_start, encode_start, stop;
+  clock_gettime (CLOCK_MONOTONIC, &decode_start);
+  for (size_t k = 0; k < N_REPETITIONS; k++)
+    {
+      eeg_kernels_decode (isa, N_ROWS, N_CHANNELS, encoded, scales, offsets,
+			  N_CHANNELS, decoded);
+    }
+  clock_gettime (CLOCK_MONOTONIC, &encode_start);
+  for (size_t k = 0; k < N_REPETITIONS; k++)
+    {
+      eeg_kernels_encode (isa, N_ROWS, N_CHANNELS, decoded, offsets, scales,
+			  encoded);
+    }
+  clock_gettime (CLOCK_MONOTONIC, &stop);
+  *decode_time = elapsed (&decode_start, &encode_start);
+  *encode_time = elapsed (&encode_start, &stop);
+  free (decoded);
+  free (offsets);
+  free (scales);
+  free (encoded);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  static const enum eeg_kernels_isa isas[] =
+    { EEG_KERNELS_SCALAR, EEG_KERNELS_SSE2, EEG_KERNELS_AVX2 };
+  double scalar_decode = 0, scalar_encode = 0;
+  printf (_("%d repetitions of %d rows × %d channels:\n"),
+	  N_REPETITIONS, N_ROWS, N_CHANNELS);
+  for (size_t k = 0; k < sizeof (isas) / sizeof (isas[0]); k++)
+    {
+      if (!eeg_kernels_isa_supported (isas[k]))
+	{
+	  continue;
+	}
+      double decode_time, encode_time;
+      benchmark_isa (isas[k], &decode_time, &encode_time);
+      if (isas[k] == EEG_KERNELS_SCALAR)
+	{
+	  scalar_decode = decode_time;
+	  scalar_encode = encode_time;
+	}
+      printf (_("%s: decode %.4f s (× %.1f), encode %.4f s (× %.1f)\n"),
+	      isa_names[isas[k]], decode_time, scalar_decode / decode_time,
+	      encode_time, scalar_encode / encode_time);
+    }
+  return 0;
+}
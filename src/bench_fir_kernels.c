@@ -0,0 +1,187 @@
+#include <config.h>
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+#include "libadftool/fir_kernels.h"
+#include "libadftool/fft.h"
+
+/* Compare the speed of the direct-form FIR kernels with FFT
+   overlap-save, for orders from 65 to 2049, to tune the order from
+   which adftool_fir_apply uses the FFT. Also compare filtering a
+   montage channel by channel and all at once. This is not a test:
+   run it with make bench. */
+
+#define BENCHMARK_LENGTH 65536
+#define N_REPETITIONS 5
+
+static const char *isa_names[] = { "scalar", "sse2", "avx2" };
+
+static const enum eeg_kernels_isa isas[] =
+  { EEG_KERNELS_SCALAR, EEG_KERNELS_SSE2, EEG_KERNELS_AVX2 };
+
+#define N_ISAS (sizeof (isas) / sizeof (isas[0]))
+
+static double
+now (void)
+{
+  struct timespec t;
+  clock_gettime (CLOCK_MONOTONIC, &t);
+  return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+static void
+example_filter (size_t half_m, double *coef_0, double *coefficients)
+{
+  *coef_0 = 0.5;
+  for (size_t j = 0; j < half_m; j++)
+    {
+      coefficients[j] = ((double) ((j * 37) % 11) - 5) / (10 * (j + 1));
+    }
+}
+
+static void
+example_signal (size_t signal_length, double *signal)
+{
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      signal[i] = ((double) ((i * 7919) % 101) - 50) / 7;
+    }
+}
+
+static void
+benchmark (size_t half_m)
+{
+  const size_t order = 2 * half_m + 1;
+  /* The same block size as adftool_fir_alloc. */
+  const size_t n = fft_size_at_least (4 * order);
+  double *coefficients = malloc (half_m * sizeof (double));
+  double *signal = malloc (BENCHMARK_LENGTH * sizeof (double));
+  double *filtered = malloc (BENCHMARK_LENGTH * sizeof (double));
+  double *twiddles = malloc (n * sizeof (double));
+  double *spectrum = malloc (2 * n * sizeof (double));
+  double *work = malloc (2 * n * sizeof (double));
+  if (coefficients == NULL || signal == NULL || filtered == NULL
+      || twiddles == NULL || spectrum == NULL || work == NULL)
+    {
+      abort ();
+    }
+  double coef_0;
+  example_filter (half_m, &coef_0, coefficients);
+  example_signal (BENCHMARK_LENGTH, signal);
+  fft_twiddles (n, twiddles);
+  fft_filter_spectrum (n, twiddles, half_m, coef_0, coefficients, spectrum);
+  double fft_start = now ();
+  for (size_t r = 0; r < N_REPETITIONS; r++)
+    {
+      fft_overlap_save (n, twiddles, spectrum, half_m, BENCHMARK_LENGTH,
+			signal, filtered, work);
+    }
+  const double fft_time = (now () - fft_start) / N_REPETITIONS;
+  printf (_("Order %lu: FFT %.4f s"), (unsigned long) order, fft_time);
+  for (size_t k = 0; k < N_ISAS; k++)
+    {
+      if (!eeg_kernels_isa_supported (isas[k]))
+	{
+	  continue;
+	}
+      const double start = now ();
+      for (size_t r = 0; r < N_REPETITIONS; r++)
+	{
+	  fir_kernels_apply (isas[k], half_m, coef_0, coefficients,
+			     BENCHMARK_LENGTH, signal, filtered);
+	}
+      const double direct_time = (now () - start) / N_REPETITIONS;
+      printf (_(", %s %.4f s (%s)"), isa_names[isas[k]], direct_time,
+	      (direct_time < fft_time ? _("direct") : _("FFT")));
+    }
+  printf ("\n");
+  free (work);
+  free (spectrum);
+  free (twiddles);
+  free (filtered);
+  free (signal);
+  free (coefficients);
+}
+
+static void
+benchmark_interleaved (enum eeg_kernels_isa isa, size_t half_m,
+		       size_t n_channels)
+{
+  const size_t signal_length = 5120;
+  double *coefficients = malloc (half_m * sizeof (double));
+  double *signal = malloc (signal_length * n_channels * sizeof (double));
+  double *filtered = malloc (signal_length * n_channels * sizeof (double));
+  if (coefficients == NULL || signal == NULL || filtered == NULL)
+    {
+      abort ();
+    }
+  double coef_0;
+  example_filter (half_m, &coef_0, coefficients);
+  example_signal (signal_length * n_channels, signal);
+  const double separate_start = now ();
+  for (size_t r = 0; r < N_REPETITIONS; r++)
+    {
+      for (size_t c = 0; c < n_channels; c++)
+	{
+	  fir_kernels_apply (isa, half_m, coef_0, coefficients,
+			     signal_length, signal + c * signal_length,
+			     filtered + c * signal_length);
+	}
+    }
+  const double interleaved_start = now ();
+  for (size_t r = 0; r < N_REPETITIONS; r++)
+    {
+      fir_kernels_apply_interleaved (isa, half_m, coef_0, coefficients,
+				     signal_length, n_channels, signal,
+				     filtered);
+    }
+  const double stop = now ();
+  printf (_("Order %lu, %lu channels, %s: "
+	    "one by one %.4f s, interleaved %.4f s\n"),
+	  (unsigned long) (2 * half_m + 1), (unsigned long) n_channels,
+	  isa_names[isa], (interleaved_start - separate_start) / N_REPETITIONS,
+	  (stop - interleaved_start) / N_REPETITIONS);
+  free (filtered);
+  free (signal);
+  free (coefficients);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  /* A 64-channel montage, filtered channel by channel, or all at
+     once. */
+  for (size_t k = 0; k < N_ISAS; k++)
+    {
+      if (eeg_kernels_isa_supported (isas[k]))
+	{
+	  benchmark_interleaved (isas[k], 32, 64);
+	}
+    }
+  /* Powers of 2, and half-way between them, for a finer crossover. */
+  for (size_t half_m = 32; half_m <= 1024; half_m *= 2)
+    {
+      benchmark (half_m);
+      if (half_m < 1024)
+	{
+	  benchmark (half_m + half_m / 2);
+	}
+    }
+  return 0;
+}
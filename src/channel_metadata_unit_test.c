@@ -47,10 +47,27 @@ main (int argc, char *argv[])
     {
       abort ();
     }
+  double decoded[2];
+  size_t n_points, n_channels;
+  /* Reading the data caches the channel decoders… */
+  if (adftool_eeg_get_data
+      (file, 0, 2, &n_points, 0, 1, &n_channels, decoded) != 0)
+    {
+      abort ();
+    }
+  assert (decoded[0] > 0.99 && decoded[0] < 1.01);
   if (channel_decoder_set (file, identifier, 42, 18) != 0)
     {
       abort ();
     }
+  /* … and changing a decoder must invalidate them. The channel
+     decoder now calibrates the block-quantized value, 1. */
+  if (adftool_eeg_get_data
+      (file, 0, 2, &n_points, 0, 1, &n_channels, decoded) != 0)
+    {
+      abort ();
+    }
+  assert (decoded[0] > 59.99 && decoded[0] < 60.01);
   struct adftool_term *type_channel = adftool_term_alloc ();
   if (type_channel == NULL)
     {
@@ -45,7 +45,9 @@ main (int argc, char *argv[])
     }
   term_set_named (channel_type, LYTONEPAL_ONTOLOGY_PREFIX "Fp2");
   struct adftool_channel_processor *processor =
-    channel_processor_alloc (file, &sync, channel_type, 0.3, 35);
+    channel_processor_alloc (file, &sync, NULL,
+			     CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH,
+			     channel_type, ADFTOOL_FILTER_FIR, 0.3, 35, 1);
   if (processor == NULL)
     {
       fail_test ();
@@ -93,6 +95,87 @@ main (int argc, char *argv[])
     {
       assert (isnan (data[i]));
     }
+  /* Reading several channels at once decodes the same values as
+     reading them one by one, and pads the end with 0. */
+  const size_t channel_indices[] = { 2, 0 };
+  double *columns, *expected;
+  if (ALLOC_N (columns, 2 * 100) < 0 || ALLOC_N (expected, 100) < 0)
+    {
+      fail_test ();
+    }
+  size_t time_max, channel_max;
+  error =
+    channel_processor_read (file, &sync, 5070, 100, &time_max, 2,
+			    channel_indices, columns);
+  assert (error == 0);
+  assert (time_max == 5120);
+  for (size_t k = 0; k < 2; k++)
+    {
+      if (adftool_eeg_get_data (file, 5070, 100, &time_max,
+				channel_indices[k], 1, &channel_max,
+				expected) != 0)
+	{
+	  fail_test ();
+	}
+      for (size_t i = 0; i < 50; i++)
+	{
+	  assert (fabs (columns[k * 100 + i] - expected[i])
+		  <= 1e-9 * fabs (expected[i]));
+	}
+      for (size_t i = 50; i < 100; i++)
+	{
+	  assert (columns[k * 100 + i] == 0);
+	}
+    }
+  FREE (expected);
+  FREE (columns);
+  /* A file without raw data cannot be read. */
+  struct adftool_file *empty = adftool_file_open_data (0, NULL);
+  if (empty == NULL)
+    {
+      fail_test ();
+    }
+  double empty_columns[10];
+  error =
+    channel_processor_read (empty, &sync, 0, 10, &time_max, 1,
+			    channel_indices, empty_columns);
+  assert (error != 0);
+  adftool_file_close (empty);
+  /* Packing is lossless, even for the widest differences, and a
+     block of constant values takes one byte. */
+  static const size_t n_values = 200;
+  int16_t *values, *unpacked;
+  uint8_t *packed;
+  if (ALLOC_N (values, n_values) < 0 || ALLOC_N (unpacked, n_values) < 0
+      || ALLOC_N (packed, 3 * n_values) < 0)
+    {
+      fail_test ();
+    }
+  for (size_t i = 0; i < n_values; i++)
+    {
+      values[i] = (i < 64 ? 17 : (i < 128 ? 5 - (int) i : 32767));
+      if (i >= 128 && i % 2 == 0)
+	{
+	  values[i] = -32767;
+	}
+    }
+  length = channel_processor_pack (n_values, values, 3 * n_values, packed);
+  assert (length != 0);
+  channel_processor_unpack (n_values, packed, unpacked);
+  for (size_t i = 0; i < n_values; i++)
+    {
+      assert (unpacked[i] == values[i]);
+    }
+  for (size_t i = 0; i < n_values; i++)
+    {
+      values[i] = 0;
+    }
+  length = channel_processor_pack (n_values, values, 3 * n_values, packed);
+  assert (length == 4);
+  assert (channel_processor_pack (n_values, values, 3, packed) == 0);
+  FREE (packed);
+  FREE (unpacked);
+  FREE (values);
   FREE (data);
   channel_processor_free (processor);
   term_free (channel_type);
@@ -10,6 +10,7 @@
 #include "progname.h"
 #include <locale.h>
 #include <assert.h>
+#include <time.h>
 
 #define _(String) gettext(String)
 #define N_(String) (String)
@@ -21,6 +22,13 @@
 #define fail_test() \
   (fprintf (stderr, "%s:%d: test failed.\n", __FILE__, __LINE__), abort ())
 
+static void
+count_notification (void *context)
+{
+  size_t *n_notified = context;
+  *n_notified += 1;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -48,7 +56,11 @@ main (int argc, char *argv[])
   term_set_named (fp1, LYTONEPAL_ONTOLOGY_PREFIX "Fp1");
   term_set_named (fp2, LYTONEPAL_ONTOLOGY_PREFIX "Fp2");
   struct adftool_channel_processor_group *group =
-    channel_processor_group_alloc (file, &sync, 2);
+    channel_processor_group_alloc (file, &sync, 2,
+				   CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH,
+				   2 * 256
+				   * channel_processor_page_bytes
+				   (CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH));
   if (group == NULL)
     {
       fail_test ();
@@ -67,8 +79,8 @@ main (int argc, char *argv[])
       data2[i] = 42;
     }
   int error1 =
-    channel_processor_group_get (group, fp1, 0.53, 35, 2560, n_data,
-				 &start_index, &length,
+    channel_processor_group_get (group, fp1, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 1, 2560, n_data, &start_index, &length,
 				 data1);
   assert (error1 == 0);
   /* The cache is empty; thus we don’t know the limits yet. */
@@ -79,8 +91,8 @@ main (int argc, char *argv[])
       assert (isnan (data1[i]));
     }
   int error2 =
-    channel_processor_group_get (group, fp2, 0.53, 35, 2560, n_data,
-				 &start_index, &length,
+    channel_processor_group_get (group, fp2, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 1, 2560, n_data, &start_index, &length,
 				 data2);
   assert (error2 == 0);
   /* The cache is empty; thus we don’t know the limits yet. */
@@ -98,8 +110,9 @@ main (int argc, char *argv[])
     }
   while (work_done);
   error1 =
-    channel_processor_group_get (group, fp1, 0.53, 35, 0, n_data,
-				 &start_index, &length, data1);
+    channel_processor_group_get (group, fp1, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 1, 0, n_data, &start_index, &length,
+				 data1);
   assert (error1 == 0);
   /* The cache is now filled; thus we do know the limits. */
   assert (start_index == 0);
@@ -114,8 +127,9 @@ main (int argc, char *argv[])
       assert (isnan (data1[i]));
     }
   error2 =
-    channel_processor_group_get (group, fp2, 0.53, 35, 0, n_data,
-				 &start_index, &length, data2);
+    channel_processor_group_get (group, fp2, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 1, 0, n_data, &start_index, &length,
+				 data2);
   assert (error2 == 0);
   /* The cache is now filled; thus we do know the limits. */
   assert (start_index == 0);
@@ -129,6 +143,529 @@ main (int argc, char *argv[])
     {
       assert (isnan (data2[i]));
     }
+  /* Both channels share the filter, so they have been filtered
+     together. The result is the same as for a channel alone. */
+  struct adftool_channel_processor *alone =
+    channel_processor_alloc (file, &sync, NULL,
+			     CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH, fp2,
+			     ADFTOOL_FILTER_FIR, 0.53, 35, 1);
+  if (alone == NULL)
+    {
+      fail_test ();
+    }
+  do
+    {
+      int error = channel_processor_populate_cache (alone, &work_done);
+      assert (error == 0);
+    }
+  while (work_done);
+  error1 =
+    channel_processor_get (alone, 0, n_data, &start_index, &length, data1);
+  assert (error1 == 0);
+  assert (length == 5120);
+  double amplitude = 0;
+  for (size_t i = 0; i < length; i++)
+    {
+      if (fabs (data1[i]) > amplitude)
+	{
+	  amplitude = fabs (data1[i]);
+	}
+    }
+  for (size_t i = 0; i < length; i++)
+    {
+      assert (fabs (data1[i] - data2[i]) <= 1e-4 * amplitude);
+    }
+  channel_processor_free (alone);
+  /* The same, with one sample in 4. */
+  for (size_t k = 0; k < 2; k++)
+    {
+      error1 =
+	channel_processor_group_get (group, (k == 0 ? fp1 : fp2),
+				     ADFTOOL_FILTER_FIR, 0.53, 35,
+				     4, 0, n_data, &start_index, &length,
+				     data2);
+      assert (error1 == 0);
+    }
+  do
+    {
+      int error = channel_processor_group_populate_cache (group, &work_done);
+      assert (error == 0);
+    }
+  while (work_done);
+  error2 =
+    channel_processor_group_get (group, fp2, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 4, 0, n_data, &start_index, &length,
+				 data2);
+  assert (error2 == 0);
+  assert (start_index == 0);
+  assert (length == 5120 / 4);
+  alone =
+    channel_processor_alloc (file, &sync, NULL,
+			     CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH, fp2,
+			     ADFTOOL_FILTER_FIR, 0.53, 35, 4);
+  if (alone == NULL)
+    {
+      fail_test ();
+    }
+  do
+    {
+      int error = channel_processor_populate_cache (alone, &work_done);
+      assert (error == 0);
+    }
+  while (work_done);
+  error1 =
+    channel_processor_get (alone, 0, n_data, &start_index, &length, data1);
+  assert (error1 == 0);
+  assert (length == 5120 / 4);
+  amplitude = 0;
+  for (size_t i = 0; i < length; i++)
+    {
+      assert (!isnan (data2[i]));
+      if (fabs (data1[i]) > amplitude)
+	{
+	  amplitude = fabs (data1[i]);
+	}
+    }
+  assert (amplitude > 0);
+  for (size_t i = 0; i < length; i++)
+    {
+      assert (fabs (data1[i] - data2[i]) <= 1e-4 * amplitude);
+    }
+  channel_processor_free (alone);
+  /* With the IIR filter, the pages are the same as the whole
+     recording filtered at once. */
+  alone =
+    channel_processor_alloc (file, &sync, NULL,
+			     CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH, fp2,
+			     ADFTOOL_FILTER_IIR, 0.53, 35, 1);
+  if (alone == NULL)
+    {
+      fail_test ();
+    }
+  do
+    {
+      int error = channel_processor_populate_cache (alone, &work_done);
+      assert (error == 0);
+    }
+  while (work_done);
+  error1 =
+    channel_processor_get (alone, 0, n_data, &start_index, &length, data1);
+  assert (error1 == 0);
+  assert (length == 5120);
+  size_t time_max, channel_max;
+  if (adftool_eeg_get_data (file, 0, length, &time_max,
+			    alone->channel_indices[0], 1, &channel_max,
+			    data2) != 0
+      || adftool_iir_apply_zero_phase (alone->iir, length, data2, data2) != 0)
+    {
+      fail_test ();
+    }
+  amplitude = 0;
+  for (size_t i = 0; i < length; i++)
+    {
+      if (fabs (data2[i]) > amplitude)
+	{
+	  amplitude = fabs (data2[i]);
+	}
+    }
+  assert (amplitude > 0);
+  for (size_t i = 0; i < length; i++)
+    {
+      assert (fabs (data1[i] - data2[i]) <= 1e-4 * amplitude);
+    }
+  channel_processor_free (alone);
+  /* The budget is raised to one page for each channel, which is
+     enough for the decimated recording. */
+  channel_processor_group_free (group);
+  group =
+    channel_processor_group_alloc (file, &sync, 2,
+				   CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH, 1);
+  if (group == NULL)
+    {
+      fail_test ();
+    }
+  for (size_t k = 0; k < 2; k++)
+    {
+      error1 =
+	channel_processor_group_get (group, (k == 0 ? fp1 : fp2),
+				     ADFTOOL_FILTER_FIR, 0.53, 35, 2, 0,
+				     n_data, &start_index, &length, data1);
+      assert (error1 == 0);
+    }
+  do
+    {
+      int error = channel_processor_group_populate_cache (group, &work_done);
+      assert (error == 0);
+    }
+  while (work_done);
+  assert (group->page_cache->max_pages == 2);
+  assert (group->page_cache->n_pages == 2);
+  for (size_t k = 0; k < 2; k++)
+    {
+      error1 =
+	channel_processor_group_get (group, (k == 0 ? fp1 : fp2),
+				     ADFTOOL_FILTER_FIR, 0.53, 35, 2, 0,
+				     n_data, &start_index, &length, data1);
+      assert (error1 == 0);
+      assert (start_index == 0);
+      assert (length == 2560);
+      for (size_t i = 0; i < length; i++)
+	{
+	  assert (!isnan (data1[i]));
+	}
+    }
+  /* With shorter pages, the signal is the same as with the default
+     pages. */
+  error1 =
+    channel_processor_group_get (group, fp2, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 1, 0, n_data, &start_index, &length, data1);
+  assert (error1 == 0);
+  do
+    {
+      int error = channel_processor_group_populate_cache (group, &work_done);
+      assert (error == 0);
+    }
+  while (work_done);
+  error1 =
+    channel_processor_group_get (group, fp2, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 1, 0, n_data, &start_index, &length, data1);
+  assert (error1 == 0);
+  assert (length == 5120);
+  channel_processor_group_free (group);
+  group = channel_processor_group_alloc (file, &sync, 2, 1000, 1);
+  if (group == NULL)
+    {
+      fail_test ();
+    }
+  assert (group->page_cache->max_pages == 2);
+  error2 =
+    channel_processor_group_get (group, fp2, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 1, 1000, 2000, &start_index, &length,
+				 data2);
+  assert (error2 == 0);
+  do
+    {
+      int error = channel_processor_group_populate_cache (group, &work_done);
+      assert (error == 0);
+    }
+  while (work_done);
+  error2 =
+    channel_processor_group_get (group, fp2, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 1, 1000, 2000, &start_index, &length,
+				 data2);
+  assert (error2 == 0);
+  assert (start_index == 1000);
+  assert (length == 2000);
+  amplitude = 0;
+  for (size_t i = 0; i < length; i++)
+    {
+      if (fabs (data1[1000 + i]) > amplitude)
+	{
+	  amplitude = fabs (data1[1000 + i]);
+	}
+    }
+  assert (amplitude > 0);
+  for (size_t i = 0; i < length; i++)
+    {
+      assert (fabs (data1[1000 + i] - data2[i]) <= 1e-4 * amplitude);
+    }
+  /* The bipolar derivation Fp1 - Fp2 is filtered as its own channel,
+     and equals the difference of the filtered channels. */
+  const struct adftool_term *bipolar[] = { fp1, fp2 };
+  static const double bipolar_weights[] = { 1, -1 };
+  double *data3;
+  if (ALLOC_N (data3, n_data) < 0)
+    {
+      fail_test ();
+    }
+  channel_processor_group_free (group);
+  group =
+    channel_processor_group_alloc (file, &sync, 3,
+				   CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH,
+				   3 * 4
+				   * channel_processor_page_bytes
+				   (CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH));
+  if (group == NULL)
+    {
+      fail_test ();
+    }
+  for (int pass = 0; pass < 2; pass++)
+    {
+      error1 =
+	channel_processor_group_get (group, fp1, ADFTOOL_FILTER_FIR, 0.53,
+				     35, 1, 0, n_data, &start_index, &length,
+				     data1);
+      assert (error1 == 0);
+      error2 =
+	channel_processor_group_get (group, fp2, ADFTOOL_FILTER_FIR, 0.53,
+				     35, 1, 0, n_data, &start_index, &length,
+				     data2);
+      assert (error2 == 0);
+      int error3 =
+	channel_processor_group_get_derived (group, 2, bipolar,
+					     bipolar_weights,
+					     ADFTOOL_FILTER_FIR, 0.53, 35, 1,
+					     0, n_data, &start_index,
+					     &length, data3);
+      assert (error3 == 0);
+      do
+	{
+	  int error =
+	    channel_processor_group_populate_cache (group, &work_done);
+	  assert (error == 0);
+	}
+      while (work_done);
+    }
+  /* An unknown filter family is an error, not a FIR filter. */
+  int error_family =
+    channel_processor_group_get_derived (group, 2, bipolar, bipolar_weights,
+					 CHANNEL_PROCESSOR_SPECTROGRAM, 0.53,
+					 35, 1, 0, n_data, &start_index,
+					 &length, data3);
+  assert (error_family != 0);
+  assert (group->n_active_channels == 3);
+  assert (length == 5120);
+  amplitude = 0;
+  for (size_t i = 0; i < length; i++)
+    {
+      assert (!isnan (data3[i]));
+      if (fabs (data1[i]) > amplitude)
+	{
+	  amplitude = fabs (data1[i]);
+	}
+      if (fabs (data2[i]) > amplitude)
+	{
+	  amplitude = fabs (data2[i]);
+	}
+    }
+  assert (amplitude > 0);
+  for (size_t i = 0; i < length; i++)
+    {
+      assert (fabs (data3[i] - (data1[i] - data2[i])) <= 1e-4 * amplitude);
+    }
+  FREE (data3);
+  /* Each frame of the spectrogram is the power spectral density of
+     the Hann-tapered samples. */
+  const struct adftool_term *single[] = { fp1 };
+  static const double unit_weight[] = { 1 };
+  static const size_t window_length = 256;
+  static const size_t hop = 128;
+  struct timespec start_time;
+  double sfreq;
+  if (adftool_eeg_get_time (file, 0, &start_time, &sfreq) != 0)
+    {
+      fail_test ();
+    }
+  size_t fft_size, first_bin;
+  const size_t n_bins =
+    channel_processor_spectrogram_bins (sfreq, window_length, 1, 30,
+					&fft_size, &first_bin);
+  assert (fft_size == window_length);
+  assert (n_bins > 0);
+  double *power;
+  if (ALLOC_N (power, 40 * n_bins) < 0)
+    {
+      fail_test ();
+    }
+  for (int pass = 0; pass < 2; pass++)
+    {
+      int error3 =
+	channel_processor_group_get_spectrogram (group, 1, single,
+						 unit_weight, window_length,
+						 hop, 1, 30, 0, 40,
+						 &start_index, &length, power);
+      assert (error3 == 0);
+      do
+	{
+	  int error =
+	    channel_processor_group_populate_cache (group, &work_done);
+	  assert (error == 0);
+	}
+      while (work_done);
+    }
+  assert (start_index == 0);
+  assert (length == 5120 / hop);
+  if (adftool_eeg_get_data (file, 10 * hop, window_length, &time_max,
+			    group->active_channels[0]->channel_indices[0], 1,
+			    &channel_max, data2) != 0)
+    {
+      fail_test ();
+    }
+  double *spectrum, *twiddles;
+  if (ALLOC_N (spectrum, 2 * fft_size) < 0
+      || ALLOC_N (twiddles, fft_size) < 0)
+    {
+      fail_test ();
+    }
+  double taper_power = 0;
+  for (size_t i = 0; i < window_length; i++)
+    {
+      const double taper = 0.5 - 0.5 * cos (2 * M_PI * i / window_length);
+      spectrum[2 * i] = data2[i] * taper;
+      spectrum[2 * i + 1] = 0;
+      taper_power += taper * taper;
+    }
+  fft_twiddles (fft_size, twiddles);
+  fft_transform (fft_size, twiddles, false, spectrum);
+  for (size_t b = 0; b < n_bins; b++)
+    {
+      const size_t k = first_bin + b;
+      const double density =
+	2 * (spectrum[2 * k] * spectrum[2 * k]
+	     + spectrum[2 * k + 1] * spectrum[2 * k + 1])
+	/ (sfreq * taper_power);
+      assert (fabs (power[10 * n_bins + b] - 10 * log10 (density)) < 0.05);
+    }
+  FREE (twiddles);
+  FREE (spectrum);
+  FREE (power);
+  /* With packed pages, the data is the same, in less memory. */
+  channel_processor_group_free (group);
+  group =
+    channel_processor_group_alloc (file, &sync, 1,
+				   CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH,
+				   4
+				   * channel_processor_page_bytes
+				   (CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH));
+  if (group == NULL)
+    {
+      fail_test ();
+    }
+  channel_processor_group_set_page_packing (group, true);
+  for (int pass = 0; pass < 2; pass++)
+    {
+      error2 =
+	channel_processor_group_get (group, fp1, ADFTOOL_FILTER_FIR, 0.53,
+				     35, 1, 0, n_data, &start_index, &length,
+				     data2);
+      assert (error2 == 0);
+      do
+	{
+	  int error =
+	    channel_processor_group_populate_cache (group, &work_done);
+	  assert (error == 0);
+	}
+      while (work_done);
+    }
+  assert (length == 5120);
+  for (size_t i = 0; i < length; i++)
+    {
+      assert (fabs (data2[i] - data1[i]) <= 1e-4 * amplitude);
+    }
+  assert (group->page_cache->n_pages != 0);
+  assert (group->page_cache->used_bytes
+	  < (group->page_cache->n_pages
+	     * channel_processor_page_bytes
+	     (CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH)));
+  /* The visible page is filtered first, then the next one, in the
+     direction of the last move. */
+  channel_processor_group_free (group);
+  group =
+    channel_processor_group_alloc (file, &sync, 1, 1000, 16 * 1000 * 2);
+  if (group == NULL)
+    {
+      fail_test ();
+    }
+  /* Only the visible pages are notified. */
+  size_t n_notified = 0;
+  channel_processor_group_set_notification (group, count_notification,
+					    &n_notified);
+  error1 =
+    channel_processor_group_get (group, fp1, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 1, 2000, 1000, &start_index, &length, data1);
+  assert (error1 == 0);
+  struct adftool_channel_processor *processor = group->active_channels[0];
+  int error = channel_processor_group_populate_cache (group, &work_done);
+  assert (error == 0 && work_done);
+  assert (channel_processor_has_page (processor, 2));
+  assert (!channel_processor_has_page (processor, 3));
+  assert (n_notified == 1);
+  error = channel_processor_group_populate_cache (group, &work_done);
+  assert (error == 0 && work_done);
+  assert (channel_processor_has_page (processor, 3));
+  assert (n_notified == 1);
+  error = channel_processor_group_populate_cache (group, &work_done);
+  assert (error == 0 && !work_done);
+  error1 =
+    channel_processor_group_get (group, fp1, ADFTOOL_FILTER_FIR, 0.53, 35,
+				 1, 1000, 1000, &start_index, &length, data1);
+  assert (error1 == 0);
+  error = channel_processor_group_populate_cache (group, &work_done);
+  assert (error == 0 && work_done);
+  assert (channel_processor_has_page (processor, 1));
+  assert (!channel_processor_has_page (processor, 0));
+  error = channel_processor_group_populate_cache (group, &work_done);
+  assert (error == 0 && work_done);
+  assert (channel_processor_has_page (processor, 0));
+  assert (n_notified == 2);
+  /* With the worker pool, the data arrives without populating the
+     cache by hand. With only one slot, the processors are dropped
+     while the workers may still be filtering them. */
+  channel_processor_group_free (group);
+  group =
+    channel_processor_group_alloc (file, &sync, 1,
+				   CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH, 1);
+  if (group == NULL || channel_processor_group_start_workers (group, 3) != 0)
+    {
+      fail_test ();
+    }
+  assert (channel_processor_group_start_workers (group, 3) != 0);
+  for (size_t k = 0; k < 10; k++)
+    {
+      error1 =
+	channel_processor_group_get (group, (k % 2 == 0 ? fp1 : fp2),
+				     ADFTOOL_FILTER_FIR, 0.53, 35, 1, 0,
+				     n_data, &start_index, &length, data1);
+      assert (error1 == 0);
+    }
+  bool complete = false;
+  for (size_t attempt = 0; attempt < 1000 && !complete; attempt++)
+    {
+      static const struct timespec sleep_request = {
+	.tv_sec = 0,
+	.tv_nsec = 10 * 1000 * 1000
+      };
+      nanosleep (&sleep_request, NULL);
+      error1 =
+	channel_processor_group_get (group, fp2, ADFTOOL_FILTER_FIR, 0.53,
+				     35, 1, 0, n_data, &start_index, &length,
+				     data1);
+      assert (error1 == 0);
+      complete = (length != 0);
+      for (size_t i = 0; i < length; i++)
+	{
+	  if (isnan (data1[i]))
+	    {
+	      complete = false;
+	    }
+	}
+    }
+  assert (complete);
+  assert (length == 5120);
+  /* A decimation of 0 is a decimation of 1: the second request finds
+     the processor of the first. */
+  channel_processor_group_free (group);
+  group = channel_processor_group_alloc (file, &sync, 2, 0, 0);
+  if (group == NULL)
+    {
+      fail_test ();
+    }
+  for (size_t k = 0; k < 2; k++)
+    {
+      error1 =
+	channel_processor_group_get_derived (group, 1, single, unit_weight,
+					     ADFTOOL_FILTER_FIR, 0.53, 35, 0,
+					     0, 1000, &start_index, &length,
+					     data1);
+      assert (error1 == 0);
+      assert (group->n_active_channels == 1);
+    }
+  /* A cache whose size does not fit in a size_t is refused, instead
+     of wrapping around to a small one. */
+  assert (channel_processor_group_alloc (file, &sync, 1, SIZE_MAX / 2, 0)
+	  == NULL);
+  assert (channel_processor_group_alloc (file, &sync, SIZE_MAX / 4096, 0, 0)
+	  == NULL);
   FREE (data1);
   FREE (data2);
   channel_processor_group_free (group);
@@ -0,0 +1,122 @@
+#include <config.h>
+
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+#define N_CHANNELS 3
+
+static double
+example_value (size_t i, size_t j)
+{
+  return ((double) ((i * (j + 3)) % 41) - 20) / 2;
+}
+
+static void
+push_block (struct adftool_eeg_appender *appender, size_t start,
+	    size_t n_points)
+{
+  double *block = malloc (n_points * N_CHANNELS * sizeof (double));
+  if (block == NULL)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < n_points; i++)
+    {
+      for (size_t j = 0; j < N_CHANNELS; j++)
+	{
+	  block[i * N_CHANNELS + j] = example_value (start + i, j);
+	}
+    }
+  if (adftool_eeg_appender_push (appender, n_points, block) != 0)
+    {
+      abort ();
+    }
+  free (block);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  struct adftool_file *file = adftool_file_open_data (0, NULL);
+  if (file == NULL)
+    {
+      abort ();
+    }
+  static const double physical_min[N_CHANNELS] = { -10, -10, -5 };
+  static const double physical_max[N_CHANNELS] = { 10, 10, 5 };
+  struct adftool_eeg_appender *appender =
+    adftool_eeg_appender_alloc (file, N_CHANNELS, physical_min,
+				physical_max);
+  if (appender == NULL)
+    {
+      abort ();
+    }
+  /* The blocks are smaller and larger than the chunks. */
+  push_block (appender, 0, 1000);
+  push_block (appender, 1000, 1);
+  push_block (appender, 1001, 9000);
+  if (adftool_eeg_appender_finish (appender) != 0)
+    {
+      abort ();
+    }
+  adftool_eeg_appender_free (appender);
+  size_t n_points, n_channels;
+  if (adftool_eeg_get_data (file, 0, 0, &n_points, 0, 0, &n_channels, NULL)
+      != 0)
+    {
+      abort ();
+    }
+  assert (n_points == 10001);
+  assert (n_channels == N_CHANNELS);
+  double *data = malloc (n_points * n_channels * sizeof (double));
+  if (data == NULL)
+    {
+      abort ();
+    }
+  if (adftool_eeg_get_data
+      (file, 0, n_points, &n_points, 0, n_channels, &n_channels, data) != 0)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < n_points; i++)
+    {
+      for (size_t j = 0; j < N_CHANNELS; j++)
+	{
+	  double expected = example_value (i, j);
+	  /* The last channel is clipped. */
+	  if (expected < physical_min[j])
+	    {
+	      expected = physical_min[j];
+	    }
+	  if (expected > physical_max[j])
+	    {
+	      expected = physical_max[j];
+	    }
+	  double difference = expected - data[i * N_CHANNELS + j];
+	  if (difference < 0)
+	    {
+	      difference = -difference;
+	    }
+	  assert (difference < 1e-3);
+	}
+    }
+  free (data);
+  adftool_file_close (file);
+  return 0;
+}
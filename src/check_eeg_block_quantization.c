@@ -0,0 +1,143 @@
+#include <config.h>
+
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+#define BLOCK_LENGTH 1000
+#define N_POINTS (3 * BLOCK_LENGTH)
+#define N_CHANNELS 2
+
+static double
+example_value (size_t i, size_t j)
+{
+  /* A quiet signal, in µV steps… */
+  double value = ((double) ((i * (j + 1)) % 101) - 50) * 1e-6;
+  /* … with a huge artifact in the middle block. */
+  if (i == BLOCK_LENGTH + 500)
+    {
+      value = 1e4;
+    }
+  return value;
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  struct adftool_file *file = adftool_file_open_data (0, NULL);
+  if (file == NULL)
+    {
+      abort ();
+    }
+  double *data = malloc (N_POINTS * N_CHANNELS * sizeof (double));
+  if (data == NULL)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < N_POINTS; i++)
+    {
+      for (size_t j = 0; j < N_CHANNELS; j++)
+	{
+	  data[i * N_CHANNELS + j] = example_value (i, j);
+	}
+    }
+  if (adftool_eeg_set_data_chunked
+      (file, N_POINTS, N_CHANNELS, data, BLOCK_LENGTH, 0,
+       ADFTOOL_EEG_COMPRESSION_DEFLATE, -1) != 0)
+    {
+      abort ();
+    }
+  size_t time_max, channel_max;
+  if (adftool_eeg_get_data
+      (file, 0, N_POINTS, &time_max, 0, N_CHANNELS, &channel_max, data) != 0)
+    {
+      abort ();
+    }
+  assert (time_max == N_POINTS);
+  assert (channel_max == N_CHANNELS);
+  for (size_t i = 0; i < N_POINTS; i++)
+    {
+      /* The artifact only degrades the precision of its own
+         block. */
+      const int in_artifact_block =
+	(i >= BLOCK_LENGTH && i < 2 * BLOCK_LENGTH);
+      const double tolerance = (in_artifact_block ? 1 : 1e-8);
+      for (size_t j = 0; j < N_CHANNELS; j++)
+	{
+	  double difference = example_value (i, j) - data[i * N_CHANNELS + j];
+	  if (difference < 0)
+	    {
+	      difference = -difference;
+	    }
+	  assert (difference < tolerance);
+	}
+    }
+  /* A window that spans the three blocks, with the raw and float
+     variants. */
+  static const size_t window_start = 500;
+  static const size_t window_length = 2000;
+  size_t block_length;
+  uint16_t *codes =
+    malloc (window_length * N_CHANNELS * sizeof (uint16_t));
+  float *floats = malloc (window_length * N_CHANNELS * sizeof (float));
+  double scales[3 * N_CHANNELS];
+  double offsets[3 * N_CHANNELS];
+  if (codes == NULL || floats == NULL)
+    {
+      abort ();
+    }
+  if (adftool_eeg_get_data_raw
+      (file, 0, 0, &time_max, 0, 0, &channel_max, NULL, &block_length, NULL,
+       NULL) != 0)
+    {
+      abort ();
+    }
+  assert (block_length == BLOCK_LENGTH);
+  if (adftool_eeg_get_data_raw
+      (file, window_start, window_length, &time_max, 0, N_CHANNELS,
+       &channel_max, codes, &block_length, scales, offsets) != 0)
+    {
+      abort ();
+    }
+  if (adftool_eeg_get_data_float
+      (file, window_start, window_length, &time_max, 0, N_CHANNELS,
+       &channel_max, floats) != 0)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < window_length; i++)
+    {
+      const size_t block =
+	(window_start + i) / block_length - window_start / block_length;
+      assert (block < 3);
+      for (size_t j = 0; j < N_CHANNELS; j++)
+	{
+	  const double decoded =
+	    codes[i * N_CHANNELS + j] * scales[block * N_CHANNELS + j]
+	    + offsets[block * N_CHANNELS + j];
+	  const double expected = data[(window_start + i) * N_CHANNELS + j];
+	  assert (decoded == expected);
+	  assert (floats[i * N_CHANNELS + j] == (float) expected);
+	}
+    }
+  free (floats);
+  free (codes);
+  free (data);
+  adftool_file_close (file);
+  return 0;
+}
@@ -0,0 +1,138 @@
+#include <config.h>
+
+#include <attribute.h>
+#include <adftool.h>
+#include <hdf5.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+#define N_POINTS 10000
+#define N_CHANNELS 20
+
+static double
+example_value (size_t i, size_t j)
+{
+  return ((double) ((i * (j + 1)) % 97) - 48) / (j + 1);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  remove ("eeg_data_chunked.adf");
+  struct adftool_file *file = adftool_file_open ("eeg_data_chunked.adf", 1);
+  if (file == NULL)
+    {
+      abort ();
+    }
+  double *data = malloc (N_POINTS * N_CHANNELS * sizeof (double));
+  if (data == NULL)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < N_POINTS; i++)
+    {
+      for (size_t j = 0; j < N_CHANNELS; j++)
+	{
+	  data[i * N_CHANNELS + j] = example_value (i, j);
+	}
+    }
+  if (adftool_eeg_set_data_chunked
+      (file, N_POINTS, N_CHANNELS, data, 1000, 8,
+       ADFTOOL_EEG_COMPRESSION_DEFLATE, -1) != 0)
+    {
+      abort ();
+    }
+  free (data);
+  adftool_file_close (file);
+  /* Check the layout with HDF5 directly. */
+  hid_t hdf5_file = H5Fopen ("eeg_data_chunked.adf", H5F_ACC_RDONLY,
+			     H5P_DEFAULT);
+  assert (hdf5_file != H5I_INVALID_HID);
+  hid_t dataset = H5Dopen2 (hdf5_file, "/eeg-data", H5P_DEFAULT);
+  assert (dataset != H5I_INVALID_HID);
+  hid_t creation_properties = H5Dget_create_plist (dataset);
+  assert (creation_properties != H5I_INVALID_HID);
+  assert (H5Pget_layout (creation_properties) == H5D_CHUNKED);
+  hsize_t chunk[2];
+  assert (H5Pget_chunk (creation_properties, 2, chunk) == 2);
+  assert (chunk[0] == 1000);
+  assert (chunk[1] == 8);
+  H5Pclose (creation_properties);
+  H5Dclose (dataset);
+  H5Fclose (hdf5_file);
+  /* Read a window that spans several chunks in both directions. */
+  file = adftool_file_open ("eeg_data_chunked.adf", 0);
+  if (file == NULL)
+    {
+      abort ();
+    }
+  static const size_t time_start = 2500;
+  static const size_t time_length = 1000;
+  static const size_t channel_start = 5;
+  static const size_t channel_length = 8;
+  double *window = malloc (time_length * channel_length * sizeof (double));
+  if (window == NULL)
+    {
+      abort ();
+    }
+  size_t time_max, channel_max;
+  if (adftool_eeg_get_data
+      (file, time_start, time_length, &time_max, channel_start,
+       channel_length, &channel_max, window) != 0)
+    {
+      abort ();
+    }
+  assert (time_max == N_POINTS);
+  assert (channel_max == N_CHANNELS);
+  for (size_t i = 0; i < time_length; i++)
+    {
+      for (size_t j = 0; j < channel_length; j++)
+	{
+	  const double expected =
+	    example_value (time_start + i, channel_start + j);
+	  const double actual = window[i * channel_length + j];
+	  double difference = expected - actual;
+	  if (difference < 0)
+	    {
+	      difference = -difference;
+	    }
+	  assert (difference < 1e-2);
+	}
+    }
+  free (window);
+  adftool_file_close (file);
+  /* Data without any channel cannot be chunked, but it can still be
+     set. */
+  file = adftool_file_open ("eeg_data_chunked.adf", 1);
+  if (file == NULL)
+    {
+      abort ();
+    }
+  if (adftool_eeg_set_data (file, 42, 0, NULL) != 0)
+    {
+      abort ();
+    }
+  if (adftool_eeg_get_data
+      (file, 0, 0, &time_max, 0, 0, &channel_max, NULL) != 0)
+    {
+      abort ();
+    }
+  assert (time_max == 42);
+  assert (channel_max == 0);
+  adftool_file_close (file);
+  return 0;
+}
@@ -0,0 +1,165 @@
+#include <config.h>
+
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+#include <float.h>
+#include <unistd.h>
+
+/* The internal header defines _ and N_. */
+#include "libadftool/channel_decoder.h"
+
+#define N_POINTS 100003
+#define N_CHANNELS 3
+
+static double
+example_value (size_t i, size_t j)
+{
+  return ((double) ((i * (j + 5) + i / 1000) % 211) - 105) / (j + 1);
+}
+
+static double
+difference (double a, double b)
+{
+  if (a > b)
+    {
+      return a - b;
+    }
+  return b - a;
+}
+
+static void
+check_envelope (struct adftool_file *file, size_t time_start,
+		size_t time_length, size_t n_pixels,
+		size_t expected_bin_length, const double *scales,
+		const double *offsets)
+{
+  size_t first_bin, bin_length, n_bins;
+  double *min = malloc ((n_pixels + 1) * N_CHANNELS * sizeof (double));
+  double *max = malloc ((n_pixels + 1) * N_CHANNELS * sizeof (double));
+  double *mean = malloc ((n_pixels + 1) * N_CHANNELS * sizeof (double));
+  if (min == NULL || max == NULL || mean == NULL)
+    {
+      abort ();
+    }
+  if (adftool_eeg_get_envelope
+      (file, time_start, time_length, n_pixels, 0, N_CHANNELS, &first_bin,
+       &bin_length, &n_bins, min, max, mean) != 0)
+    {
+      abort ();
+    }
+  assert (bin_length == expected_bin_length);
+  assert (n_bins <= n_pixels + 1);
+  assert (first_bin * bin_length <= time_start);
+  assert ((first_bin + n_bins) * bin_length >= time_start + time_length);
+  for (size_t b = 0; b < n_bins; b++)
+    {
+      for (size_t j = 0; j < N_CHANNELS; j++)
+	{
+	  double expected_min = DBL_MAX;
+	  double expected_max = -DBL_MAX;
+	  double expected_sum = 0;
+	  size_t n = 0;
+	  for (size_t i = (first_bin + b) * bin_length;
+	       i < (first_bin + b + 1) * bin_length && i < N_POINTS; i++)
+	    {
+	      const double value =
+		example_value (i, j) * scales[j] + offsets[j];
+	      if (value < expected_min)
+		{
+		  expected_min = value;
+		}
+	      if (value > expected_max)
+		{
+		  expected_max = value;
+		}
+	      expected_sum += value;
+	      n++;
+	    }
+	  /* The envelope can be computed from the stored codes, with
+	     the quantization error. */
+	  const double tolerance = 1e-2 * (scales[j] < 0 ? -scales[j] : 1);
+	  assert (difference (min[b * N_CHANNELS + j], expected_min)
+		  < tolerance);
+	  assert (difference (max[b * N_CHANNELS + j], expected_max)
+		  < tolerance);
+	  assert (difference (mean[b * N_CHANNELS + j], expected_sum / n)
+		  < tolerance);
+	}
+    }
+  free (mean);
+  free (max);
+  free (min);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  struct adftool_file *file = adftool_file_open_data (0, NULL);
+  if (file == NULL)
+    {
+      abort ();
+    }
+  double *data = malloc (N_POINTS * N_CHANNELS * sizeof (double));
+  if (data == NULL)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < N_POINTS; i++)
+    {
+      for (size_t j = 0; j < N_CHANNELS; j++)
+	{
+	  data[i * N_CHANNELS + j] = example_value (i, j);
+	}
+    }
+  if (adftool_eeg_set_data (file, N_POINTS, N_CHANNELS, data) != 0)
+    {
+      abort ();
+    }
+  free (data);
+  double scales[N_CHANNELS] = { 1, 1, 1 };
+  double offsets[N_CHANNELS] = { 0, 0, 0 };
+  /* The whole recording, on a screen. */
+  check_envelope (file, 0, N_POINTS, 1000, 128, scales, offsets);
+  /* A window with unaligned bounds. */
+  check_envelope (file, 12345, 54321, 300, 256, scales, offsets);
+  /* Zoomed in: the bins are smaller than the finest level. */
+  check_envelope (file, 777, 333, 100, 4, scales, offsets);
+  /* A single pixel. */
+  check_envelope (file, 0, N_POINTS, 1, 131072, scales, offsets);
+  /* The last, incomplete bins. */
+  check_envelope (file, N_POINTS - 100, 100, 2, 64, scales, offsets);
+  /* A negative calibration swaps the min and the max. */
+  struct adftool_term *identifier = adftool_term_alloc ();
+  if (identifier == NULL)
+    {
+      abort ();
+    }
+  if (adftool_find_channel_identifier (file, 1, identifier) != 0)
+    {
+      abort ();
+    }
+  if (channel_decoder_set (file, identifier, -2, 7) != 0)
+    {
+      abort ();
+    }
+  adftool_term_free (identifier);
+  scales[1] = -2;
+  offsets[1] = 7;
+  check_envelope (file, 0, N_POINTS, 1000, 128, scales, offsets);
+  check_envelope (file, 777, 333, 100, 4, scales, offsets);
+  adftool_file_close (file);
+  return 0;
+}
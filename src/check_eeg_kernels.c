@@ -0,0 +1,153 @@
+#include <config.h>
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+#include "libadftool/eeg_kernels.h"
+
+/* Check that the vectorized kernels agree with the portable ones. */
+
+#define N_CHANNELS 256
+
+static double
+difference (double a, double b)
+{
+  if (a > b)
+    {
+      return a - b;
+    }
+  return b - a;
+}
+
+static void
+check_isa (enum eeg_kernels_isa isa, size_t n_rows, size_t n_columns)
+{
+  /* Odd sizes exercise the scalar tails. */
+  uint16_t *encoded = malloc (n_rows * n_columns * sizeof (uint16_t));
+  uint16_t *reencoded = malloc (n_rows * n_columns * sizeof (uint16_t));
+  uint16_t *expected_codes = malloc (n_rows * n_columns * sizeof (uint16_t));
+  double *scales = malloc (n_columns * sizeof (double));
+  double *offsets = malloc (n_columns * sizeof (double));
+  double *inverse_scales = malloc (n_columns * sizeof (double));
+  /* The output rows are wider than necessary. */
+  const size_t stride = n_columns + 3;
+  double *expected = malloc (n_rows * stride * sizeof (double));
+  double *actual = malloc (n_rows * stride * sizeof (double));
+  double *values = malloc (n_rows * n_columns * sizeof (double));
+  if (encoded == NULL || reencoded == NULL
+      || expected_codes == NULL || scales == NULL || offsets == NULL
+      || inverse_scales == NULL || expected == NULL || actual == NULL
+      || values == NULL)
+    {
+      abort ();
+    }
+  for (size_t j = 0; j < n_columns; j++)
+    {
+      scales[j] = (j + 1) * 1e-3;
+      offsets[j] = -((double) j);
+      inverse_scales[j] = 1 / scales[j];
+    }
+  /* A flat channel has a zero scale. */
+  scales[0] = 0;
+  inverse_scales[0] = 0;
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      for (size_t j = 0; j < n_columns; j++)
+	{
+	  const uint16_t code = (i * 7919 + j * 104729) % 65536;
+	  encoded[i * n_columns + j] = code;
+	  /* Some values are out of range. */
+	  values[i * n_columns + j] =
+	    ((double) code - 1000) * scales[j] + offsets[j];
+	}
+    }
+  eeg_kernels_decode (EEG_KERNELS_SCALAR, n_rows, n_columns, encoded,
+		      scales, offsets, stride, expected);
+  eeg_kernels_encode (EEG_KERNELS_SCALAR, n_rows, n_columns, values,
+		      offsets, inverse_scales, expected_codes);
+  for (size_t i = 0; i < n_rows * stride; i++)
+    {
+      actual[i] = -42;
+    }
+  eeg_kernels_decode (isa, n_rows, n_columns, encoded, scales, offsets,
+		      stride, actual);
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      for (size_t j = 0; j < n_columns; j++)
+	{
+	  assert (difference (actual[i * stride + j], expected[i * stride + j])
+		  < 1e-9);
+	}
+      for (size_t j = n_columns; j < stride; j++)
+	{
+	  assert (actual[i * stride + j] == -42);
+	}
+    }
+  eeg_kernels_encode (isa, n_rows, n_columns, values, offsets,
+		      inverse_scales, reencoded);
+  for (size_t i = 0; i < n_rows * n_columns; i++)
+    {
+      assert (reencoded[i] == expected_codes[i]);
+    }
+  /* The values below 1000 steps are clipped to 0, the others round
+     trip. */
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      for (size_t j = 1; j < n_columns; j++)
+	{
+	  const uint16_t code = encoded[i * n_columns + j];
+	  if (code >= 1000)
+	    {
+	      assert (reencoded[i * n_columns + j] == code - 1000);
+	    }
+	  else
+	    {
+	      assert (reencoded[i * n_columns + j] == 0);
+	    }
+	}
+      assert (reencoded[i * n_columns] == 0);
+    }
+  free (values);
+  free (actual);
+  free (expected);
+  free (inverse_scales);
+  free (offsets);
+  free (scales);
+  free (expected_codes);
+  free (reencoded);
+  free (encoded);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  static const enum eeg_kernels_isa isas[] =
+    { EEG_KERNELS_SCALAR, EEG_KERNELS_SSE2, EEG_KERNELS_AVX2 };
+  for (size_t k = 0; k < sizeof (isas) / sizeof (isas[0]); k++)
+    {
+      if (!eeg_kernels_isa_supported (isas[k]))
+	{
+	  continue;
+	}
+      check_isa (isas[k], 1, 1);
+      check_isa (isas[k], 3, 7);
+      check_isa (isas[k], 37, 21);
+      check_isa (isas[k], 64, N_CHANNELS);
+    }
+  return 0;
+}
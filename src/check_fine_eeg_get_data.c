@@ -196,6 +196,43 @@ check_empty (struct adftool_file *file)
     }
 }
 
+static void
+check_channel_overflow (struct adftool_file *file)
+{
+  /* Request channels 1 and 2: there is no channel 2, so the second
+     column must not be touched. */
+  double answer[4][2] = {
+    {42, 42},
+    {42, 42},
+    {42, 42},
+    {42, 42}
+  };
+  size_t n_points, n_channels;
+  int error =
+    adftool_eeg_get_data (file, 0, 4, &n_points, 1, 2, &n_channels,
+			  &(answer[0][0]));
+  if (error)
+    {
+      test_fail ();
+    }
+  if (n_points != 4 || n_channels != 2)
+    {
+      test_fail ();
+    }
+  if (float_neq (answer[0][0], 0.6326078)
+      || float_neq (answer[3][0], -1.0824288))
+    {
+      test_fail ();
+    }
+  for (size_t i = 0; i < 4; i++)
+    {
+      if (answer[i][1] != 42)
+	{
+	  test_fail ();
+	}
+    }
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -238,6 +275,7 @@ main (int argc, char *argv[])
   check_offset_just (file);
   check_offset (file);
   check_empty (file);
+  check_channel_overflow (file);
   adftool_file_close (file);
   free (row_wise);
   return 0;
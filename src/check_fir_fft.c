@@ -0,0 +1,144 @@
+#include <config.h>
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+/* Check that the FFT filtering of long filters agrees with the direct
+   convolution. */
+
+#define SFREQ 256
+
+static double
+difference (double a, double b)
+{
+  if (a > b)
+    {
+      return a - b;
+    }
+  return b - a;
+}
+
+static double
+example_signal (size_t i)
+{
+  return 10 * sin (i * 0.05) + 3 * cos (i * 1.3) + ((i * 7919) % 13) - 6;
+}
+
+/* The convolution, with zeros outside of the signal. */
+static void
+reference_apply (size_t order, const double *coefficients,
+		 size_t signal_length, const double *signal, double *filtered)
+{
+  const size_t half_m = order / 2;
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      double sum = 0;
+      for (size_t k = 0; k < order; k++)
+	{
+	  if (i + k >= half_m && i + k - half_m < signal_length)
+	    {
+	      sum += coefficients[k] * signal[i + k - half_m];
+	    }
+	}
+      filtered[i] = sum;
+    }
+}
+
+static void
+check_filter (double freq_low, double freq_high, size_t signal_length)
+{
+  double trans_low, trans_high;
+  adftool_fir_auto_bandwidth (SFREQ, freq_low, freq_high, &trans_low,
+			      &trans_high);
+  const double trans = (trans_low < trans_high ? trans_low : trans_high);
+  const size_t order = adftool_fir_auto_order (SFREQ, trans);
+  struct adftool_fir *filter = adftool_fir_alloc (order);
+  double *coefficients = malloc (order * sizeof (double));
+  double *signal = malloc (signal_length * sizeof (double));
+  double *expected = malloc (signal_length * sizeof (double));
+  double *actual = malloc (signal_length * sizeof (double));
+  if (filter == NULL || coefficients == NULL || signal == NULL
+      || expected == NULL || actual == NULL)
+    {
+      abort ();
+    }
+  adftool_fir_design_bandpass (filter, SFREQ, freq_low, freq_high,
+			       trans_low, trans_high);
+  adftool_fir_coefficients (filter, coefficients);
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      signal[i] = example_signal (i);
+    }
+  reference_apply (order, coefficients, signal_length, signal, expected);
+  adftool_fir_apply (filter, signal_length, signal, actual);
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      assert (difference (actual[i], expected[i]) < 1e-9);
+    }
+  /* The same signal, with a second channel at 2 times the signal,
+     interleaved or not. */
+  double *multi_signal = malloc (2 * signal_length * sizeof (double));
+  double *multi_filtered = malloc (2 * signal_length * sizeof (double));
+  if (multi_signal == NULL || multi_filtered == NULL)
+    {
+      abort ();
+    }
+  for (int channel_major = 0; channel_major < 2; channel_major++)
+    {
+      const size_t time_stride = (channel_major ? 1 : 2);
+      const size_t channel_stride = (channel_major ? signal_length : 1);
+      for (size_t i = 0; i < signal_length; i++)
+	{
+	  multi_signal[i * time_stride] = signal[i];
+	  multi_signal[i * time_stride + channel_stride] = 2 * signal[i];
+	}
+      adftool_fir_apply_multi (filter, signal_length, 2, channel_major,
+			       multi_signal, multi_filtered);
+      for (size_t i = 0; i < signal_length; i++)
+	{
+	  assert (difference (multi_filtered[i * time_stride], expected[i])
+		  < 1e-9);
+	  assert (difference
+		  (multi_filtered[i * time_stride + channel_stride],
+		   2 * expected[i]) < 1e-9);
+	}
+    }
+  free (multi_filtered);
+  free (multi_signal);
+  free (actual);
+  free (expected);
+  free (signal);
+  free (coefficients);
+  adftool_fir_free (filter);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  /* A short filter, under the threshold. */
+  check_filter (60, 100, 1000);
+  /* Long filters, on signals shorter or longer than the FFT
+     blocks. */
+  check_filter (1, 30, 1);
+  check_filter (1, 30, 100);
+  check_filter (1, 30, 4321);
+  check_filter (0.1, 30, 10000);
+  check_filter (0.5, 45, 65536);
+  return 0;
+}
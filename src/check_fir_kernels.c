@@ -0,0 +1,205 @@
+#include <config.h>
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+#include "libadftool/fir_kernels.h"
+
+/* Check that the vectorized direct-form FIR kernels agree with the
+   convolution, also when only one output in a few is computed. */
+
+static double
+difference (double a, double b)
+{
+  if (a > b)
+    {
+      return a - b;
+    }
+  return b - a;
+}
+
+static void
+example_filter (size_t half_m, double *coef_0, double *coefficients)
+{
+  *coef_0 = 0.5;
+  for (size_t j = 0; j < half_m; j++)
+    {
+      coefficients[j] = ((double) ((j * 37) % 11) - 5) / (10 * (j + 1));
+    }
+}
+
+static void
+example_signal (size_t signal_length, double *signal)
+{
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      signal[i] = ((double) ((i * 7919) % 101) - 50) / 7;
+    }
+}
+
+static void
+check_isa (enum eeg_kernels_isa isa, size_t half_m, size_t signal_length)
+{
+  double *coefficients = malloc ((half_m + 1) * sizeof (double));
+  double *signal = malloc ((signal_length + 1) * sizeof (double));
+  double *actual = malloc ((signal_length + 1) * sizeof (double));
+  if (coefficients == NULL || signal == NULL || actual == NULL)
+    {
+      abort ();
+    }
+  double coef_0;
+  example_filter (half_m, &coef_0, coefficients);
+  example_signal (signal_length, signal);
+  actual[signal_length] = -42;
+  fir_kernels_apply (isa, half_m, coef_0, coefficients, signal_length,
+		     signal, actual);
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      double expected = coef_0 * signal[i];
+      for (size_t j = 0; j < half_m; j++)
+	{
+	  if (i + j + 1 < signal_length)
+	    {
+	      expected += coefficients[j] * signal[i + j + 1];
+	    }
+	  if (i >= j + 1)
+	    {
+	      expected += coefficients[j] * signal[i - j - 1];
+	    }
+	}
+      assert (difference (actual[i], expected) < 1e-9);
+    }
+  assert (actual[signal_length] == -42);
+  free (actual);
+  free (signal);
+  free (coefficients);
+}
+
+static void
+check_interleaved (enum eeg_kernels_isa isa, size_t half_m,
+		   size_t signal_length, size_t n_channels)
+{
+  double *coefficients = malloc ((half_m + 1) * sizeof (double));
+  double *signal = malloc ((signal_length * n_channels + 1)
+			   * sizeof (double));
+  double *channel = malloc ((signal_length + 1) * sizeof (double));
+  double *expected = malloc ((signal_length + 1) * sizeof (double));
+  double *actual = malloc ((signal_length * n_channels + 1)
+			   * sizeof (double));
+  if (coefficients == NULL || signal == NULL || channel == NULL
+      || expected == NULL || actual == NULL)
+    {
+      abort ();
+    }
+  double coef_0;
+  example_filter (half_m, &coef_0, coefficients);
+  example_signal (signal_length * n_channels, signal);
+  fir_kernels_apply_interleaved (isa, half_m, coef_0, coefficients,
+				 signal_length, n_channels, signal, actual);
+  for (size_t c = 0; c < n_channels; c++)
+    {
+      for (size_t i = 0; i < signal_length; i++)
+	{
+	  channel[i] = signal[i * n_channels + c];
+	}
+      fir_kernels_apply (EEG_KERNELS_SCALAR, half_m, coef_0, coefficients,
+			 signal_length, channel, expected);
+      for (size_t i = 0; i < signal_length; i++)
+	{
+	  assert (difference (actual[i * n_channels + c], expected[i]) <
+		  1e-9);
+	}
+    }
+  free (actual);
+  free (expected);
+  free (channel);
+  free (signal);
+  free (coefficients);
+}
+
+static void
+check_decimated (enum eeg_kernels_isa isa, size_t half_m,
+		 size_t signal_length, size_t first, size_t decimation)
+{
+  double *coefficients = malloc ((half_m + 1) * sizeof (double));
+  double *signal = malloc ((signal_length + 1) * sizeof (double));
+  double *expected = malloc ((signal_length + 1) * sizeof (double));
+  double *actual = malloc ((signal_length + 2) * sizeof (double));
+  if (coefficients == NULL || signal == NULL || expected == NULL
+      || actual == NULL)
+    {
+      abort ();
+    }
+  double coef_0;
+  example_filter (half_m, &coef_0, coefficients);
+  example_signal (signal_length, signal);
+  fir_kernels_apply (EEG_KERNELS_SCALAR, half_m, coef_0, coefficients,
+		     signal_length, signal, expected);
+  size_t n_outputs = 0;
+  if (first < signal_length)
+    {
+      n_outputs = (signal_length - first + decimation - 1) / decimation;
+    }
+  actual[n_outputs] = -42;
+  fir_kernels_apply_decimated (isa, half_m, coef_0, coefficients,
+			       signal_length, signal, first, decimation,
+			       n_outputs, actual);
+  for (size_t k = 0; k < n_outputs; k++)
+    {
+      assert (difference (actual[k], expected[first + k * decimation]) <
+	      1e-9);
+    }
+  assert (actual[n_outputs] == -42);
+  free (actual);
+  free (expected);
+  free (signal);
+  free (coefficients);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  static const enum eeg_kernels_isa isas[] =
+    { EEG_KERNELS_SCALAR, EEG_KERNELS_SSE2, EEG_KERNELS_AVX2 };
+  for (size_t k = 0; k < sizeof (isas) / sizeof (isas[0]); k++)
+    {
+      if (!eeg_kernels_isa_supported (isas[k]))
+	{
+	  continue;
+	}
+      /* Signals shorter than the filter have no steady state. */
+      check_isa (isas[k], 0, 10);
+      check_isa (isas[k], 3, 1);
+      check_isa (isas[k], 3, 6);
+      check_isa (isas[k], 3, 7);
+      check_isa (isas[k], 10, 37);
+      check_isa (isas[k], 32, 1001);
+      check_isa (isas[k], 100, 150);
+      check_interleaved (isas[k], 0, 10, 3);
+      check_interleaved (isas[k], 3, 6, 9);
+      check_interleaved (isas[k], 10, 37, 19);
+      check_interleaved (isas[k], 32, 1001, 16);
+      check_decimated (isas[k], 0, 10, 0, 3);
+      check_decimated (isas[k], 3, 7, 1, 2);
+      check_decimated (isas[k], 5, 100, 0, 4);
+      check_decimated (isas[k], 10, 37, 2, 7);
+      check_decimated (isas[k], 32, 1001, 3, 8);
+      check_decimated (isas[k], 33, 1001, 0, 5);
+    }
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include <config.h>
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+/* Check that the shared filters are designed once for each set of
+   parameters. */
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  const struct adftool_fir *a = adftool_fir_acquire (256, 1, 30, 1, 7.5);
+  const struct adftool_fir *b = adftool_fir_acquire (256, 1, 30, 1, 7.5);
+  const struct adftool_fir *c = adftool_fir_acquire (256, 2, 30, 2, 7.5);
+  const struct adftool_fir *d = adftool_fir_acquire (512, 1, 30, 1, 7.5);
+  assert (a != NULL && c != NULL && d != NULL);
+  assert (a == b);
+  assert (a != c);
+  assert (a != d);
+  /* The shared filter is the same as a filter designed alone. */
+  const size_t order = adftool_fir_auto_order (256, 1);
+  assert (adftool_fir_order (a) == order);
+  struct adftool_fir *alone = adftool_fir_alloc (order);
+  double *expected = malloc (order * sizeof (double));
+  double *actual = malloc (order * sizeof (double));
+  if (alone == NULL || expected == NULL || actual == NULL)
+    {
+      abort ();
+    }
+  adftool_fir_design_bandpass (alone, 256, 1, 30, 1, 7.5);
+  adftool_fir_coefficients (alone, expected);
+  adftool_fir_coefficients (a, actual);
+  for (size_t i = 0; i < order; i++)
+    {
+      assert (actual[i] == expected[i]);
+    }
+  free (actual);
+  free (expected);
+  adftool_fir_free (alone);
+  /* The filter is still usable while one reference is held. */
+  adftool_fir_release (a);
+  double signal[3] = { 1, 2, 3 };
+  double filtered[3];
+  adftool_fir_apply (b, 3, signal, filtered);
+  adftool_fir_release (b);
+  adftool_fir_release (c);
+  adftool_fir_release (d);
+  /* The filter has been freed, but it can be designed again. */
+  const struct adftool_fir *e = adftool_fir_acquire (256, 1, 30, 1, 7.5);
+  assert (e != NULL);
+  assert (adftool_fir_order (e) == order);
+  adftool_fir_release (e);
+  return 0;
+}
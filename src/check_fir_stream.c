@@ -0,0 +1,218 @@
+#include <config.h>
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+/* Check that filtering a signal block by block with a stream gives
+   the same result as filtering it at once. */
+
+#define SFREQ 256
+#define SIGNAL_LENGTH 20000
+
+static double
+difference (double a, double b)
+{
+  if (a > b)
+    {
+      return a - b;
+    }
+  return b - a;
+}
+
+static void
+check_stream (double freq_low, double freq_high, size_t signal_length,
+	      size_t block_length)
+{
+  double trans_low, trans_high;
+  adftool_fir_auto_bandwidth (SFREQ, freq_low, freq_high, &trans_low,
+			      &trans_high);
+  const double trans = (trans_low < trans_high ? trans_low : trans_high);
+  struct adftool_fir *filter =
+    adftool_fir_alloc (adftool_fir_auto_order (SFREQ, trans));
+  if (filter == NULL)
+    {
+      abort ();
+    }
+  adftool_fir_design_bandpass (filter, SFREQ, freq_low, freq_high,
+			       trans_low, trans_high);
+  struct adftool_fir_stream *stream = adftool_fir_stream_alloc (filter);
+  double *signal = malloc (signal_length * sizeof (double));
+  double *expected = malloc (signal_length * sizeof (double));
+  double *actual = malloc ((signal_length + 1) * sizeof (double));
+  if (stream == NULL || signal == NULL || expected == NULL || actual == NULL)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      signal[i] = 20 * sin (i * 0.07) + ((i * 7919) % 17) - 8;
+    }
+  adftool_fir_apply (filter, signal_length, signal, expected);
+  /* Twice, to check that the stream is reset at the end. */
+  for (size_t repetition = 0; repetition < 2; repetition++)
+    {
+      size_t n_done = 0;
+      for (size_t start = 0; start < signal_length; start += block_length)
+	{
+	  size_t length = block_length;
+	  if (start + length > signal_length)
+	    {
+	      length = signal_length - start;
+	    }
+	  size_t n_filtered;
+	  if (adftool_fir_stream_push (stream, length, signal + start,
+				       &n_filtered, actual + n_done) != 0)
+	    {
+	      abort ();
+	    }
+	  assert (n_filtered <= length);
+	  n_done += n_filtered;
+	}
+      size_t n_filtered;
+      if (adftool_fir_stream_finish (stream, &n_filtered, actual + n_done)
+	  != 0)
+	{
+	  abort ();
+	}
+      n_done += n_filtered;
+      assert (n_done == signal_length);
+      for (size_t i = 0; i < signal_length; i++)
+	{
+	  assert (difference (actual[i], expected[i]) < 1e-9);
+	}
+    }
+  /* Start in the middle of the signal, with enough history. */
+  const size_t start = signal_length / 2;
+  const size_t half_order = adftool_fir_order (filter) / 2;
+  adftool_fir_stream_reset (stream, start, signal);
+  size_t n_filtered;
+  if (adftool_fir_stream_push (stream, signal_length - start, signal + start,
+			       &n_filtered, actual) != 0)
+    {
+      abort ();
+    }
+  if (signal_length - start >= half_order)
+    {
+      assert (n_filtered == signal_length - start - half_order);
+    }
+  for (size_t i = 0; i < n_filtered; i++)
+    {
+      assert (difference (actual[i], expected[start + i]) < 1e-9);
+    }
+  free (actual);
+  free (expected);
+  free (signal);
+  adftool_fir_stream_free (stream);
+  adftool_fir_free (filter);
+}
+
+static void
+check_decimated_stream (double freq_low, double freq_high,
+			size_t decimation, size_t block_length)
+{
+  /* The decimated stream keeps the outputs 0, decimation, … */
+  double trans_low, trans_high;
+  adftool_fir_auto_bandwidth (SFREQ, freq_low, freq_high, &trans_low,
+			      &trans_high);
+  const double trans = (trans_low < trans_high ? trans_low : trans_high);
+  struct adftool_fir *filter =
+    adftool_fir_alloc (adftool_fir_auto_order (SFREQ, trans));
+  if (filter == NULL)
+    {
+      abort ();
+    }
+  adftool_fir_design_bandpass (filter, SFREQ, freq_low, freq_high,
+			       trans_low, trans_high);
+  struct adftool_fir_stream *stream =
+    adftool_fir_stream_alloc_decimated (filter, decimation);
+  double *signal = malloc (SIGNAL_LENGTH * sizeof (double));
+  double *all = malloc (SIGNAL_LENGTH * sizeof (double));
+  double *expected = malloc (SIGNAL_LENGTH * sizeof (double));
+  double *actual = malloc ((SIGNAL_LENGTH + 1) * sizeof (double));
+  if (stream == NULL || signal == NULL || all == NULL || expected == NULL
+      || actual == NULL)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < SIGNAL_LENGTH; i++)
+    {
+      signal[i] = 20 * sin (i * 0.01) + ((i * 7919) % 17) - 8;
+    }
+  adftool_fir_apply (filter, SIGNAL_LENGTH, signal, all);
+  const size_t n_expected =
+    adftool_fir_apply_decimated (filter, SIGNAL_LENGTH, signal, decimation,
+				 expected);
+  assert (n_expected == (SIGNAL_LENGTH + decimation - 1) / decimation);
+  for (size_t k = 0; k < n_expected; k++)
+    {
+      assert (difference (expected[k], all[k * decimation]) < 1e-9);
+    }
+  size_t n_done = 0;
+  for (size_t start = 0; start < SIGNAL_LENGTH; start += block_length)
+    {
+      size_t length = block_length;
+      if (start + length > SIGNAL_LENGTH)
+	{
+	  length = SIGNAL_LENGTH - start;
+	}
+      size_t n_filtered;
+      if (adftool_fir_stream_push (stream, length, signal + start,
+				   &n_filtered, actual + n_done) != 0)
+	{
+	  abort ();
+	}
+      n_done += n_filtered;
+    }
+  size_t n_filtered;
+  if (adftool_fir_stream_finish (stream, &n_filtered, actual + n_done) != 0)
+    {
+      abort ();
+    }
+  n_done += n_filtered;
+  assert (n_done == n_expected);
+  for (size_t k = 0; k < n_expected; k++)
+    {
+      assert (difference (actual[k], expected[k]) < 1e-9);
+    }
+  free (actual);
+  free (expected);
+  free (all);
+  free (signal);
+  adftool_fir_stream_free (stream);
+  adftool_fir_free (filter);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  /* A short filter, applied directly. */
+  check_stream (60, 100, SIGNAL_LENGTH, 5120);
+  check_stream (60, 100, SIGNAL_LENGTH, 7);
+  /* A long filter, applied by FFT. */
+  check_stream (1, 30, SIGNAL_LENGTH, 5120);
+  check_stream (1, 30, SIGNAL_LENGTH, 333);
+  /* The signal is shorter than the filter. */
+  check_stream (1, 30, 100, 30);
+  /* Decimated, by the kernels or by the FFT. */
+  check_decimated_stream (1, 30, 4, 5120);
+  check_decimated_stream (1, 30, 3, 77);
+  check_decimated_stream (1, 10, 2, 1000);
+  check_decimated_stream (60, 100, 1, 333);
+  return 0;
+}
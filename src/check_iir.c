@@ -0,0 +1,145 @@
+#include <config.h>
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+/* Check the gain of the zero-phase Butterworth band-pass filter, and
+   that a window filtered with enough samples around it matches the
+   whole signal. */
+
+#define SFREQ 256
+#define SIGNAL_LENGTH 40000
+
+static double
+gain (const struct adftool_iir *filter, double freq)
+{
+  /* The ratio of the amplitudes of a sine wave, away from the
+     edges. Since the filter has no phase, the output is in phase with
+     the input. */
+  double *signal = malloc (SIGNAL_LENGTH * sizeof (double));
+  double *filtered = malloc (SIGNAL_LENGTH * sizeof (double));
+  if (signal == NULL || filtered == NULL)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < SIGNAL_LENGTH; i++)
+    {
+      signal[i] = sin (2 * M_PI * freq * i / SFREQ);
+    }
+  if (adftool_iir_apply_zero_phase (filter, SIGNAL_LENGTH, signal, filtered)
+      != 0)
+    {
+      abort ();
+    }
+  double dot = 0, norm = 0;
+  for (size_t i = SIGNAL_LENGTH / 4; i < 3 * SIGNAL_LENGTH / 4; i++)
+    {
+      dot += signal[i] * filtered[i];
+      norm += signal[i] * signal[i];
+    }
+  free (filtered);
+  free (signal);
+  return dot / norm;
+}
+
+static void
+check_window (const struct adftool_iir *filter)
+{
+  double *signal = malloc (SIGNAL_LENGTH * sizeof (double));
+  double *expected = malloc (SIGNAL_LENGTH * sizeof (double));
+  double *actual = malloc (SIGNAL_LENGTH * sizeof (double));
+  if (signal == NULL || expected == NULL || actual == NULL)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < SIGNAL_LENGTH; i++)
+    {
+      signal[i] = 20 * sin (i * 0.07) + ((i * 7919) % 17) - 8 + 50;
+    }
+  if (adftool_iir_apply_zero_phase (filter, SIGNAL_LENGTH, signal, expected)
+      != 0)
+    {
+      abort ();
+    }
+  double amplitude = 0;
+  for (size_t i = 0; i < SIGNAL_LENGTH; i++)
+    {
+      if (fabs (expected[i]) > amplitude)
+	{
+	  amplitude = fabs (expected[i]);
+	}
+    }
+  const size_t settle_length = adftool_iir_settle_length (filter);
+  const size_t start = SIGNAL_LENGTH / 2;
+  const size_t length = 5120;
+  assert (start >= settle_length);
+  assert (start + length + settle_length <= SIGNAL_LENGTH);
+  const size_t window_length = settle_length + length + settle_length;
+  if (adftool_iir_apply_zero_phase (filter, window_length,
+				    signal + start - settle_length,
+				    actual) != 0)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < length; i++)
+    {
+      assert (fabs (actual[settle_length + i] - expected[start + i])
+	      < 1e-3 * amplitude);
+    }
+  free (actual);
+  free (expected);
+  free (signal);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  struct adftool_iir *filter = adftool_iir_alloc (3);
+  if (filter == NULL)
+    {
+      abort ();
+    }
+  assert (adftool_iir_order (filter) == 4);
+  adftool_iir_design_bandpass (filter, SFREQ, 1, 30);
+  assert (adftool_iir_settle_length (filter) > 0);
+  /* Filtering forward and backward squares the gain: at the edges of
+     the band, it is 1/2. */
+  assert (fabs (gain (filter, 10) - 1) < 1e-3);
+  assert (fabs (gain (filter, 1) - 0.5) < 1e-2);
+  assert (fabs (gain (filter, 30) - 0.5) < 1e-2);
+  assert (fabs (gain (filter, 0.1)) < 1e-3);
+  assert (fabs (gain (filter, 100)) < 1e-3);
+  check_window (filter);
+  /* A very low cut-off. */
+  adftool_iir_design_bandpass (filter, SFREQ, 0.3, 0);
+  assert (fabs (gain (filter, 0.3) - 0.5) < 1e-2);
+  assert (fabs (gain (filter, 10) - 1) < 1e-3);
+  check_window (filter);
+  /* Without any edge, the filter does nothing. */
+  double signal[3] = { 1, 2, 3 };
+  double filtered[3];
+  adftool_iir_design_bandpass (filter, SFREQ, 0, 0);
+  adftool_iir_apply (filter, 3, signal, filtered);
+  for (size_t i = 0; i < 3; i++)
+    {
+      assert (filtered[i] == signal[i]);
+    }
+  adftool_iir_free (filter);
+  return 0;
+}
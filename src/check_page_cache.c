@@ -0,0 +1,233 @@
+#include <config.h>
+#include <attribute.h>
+#include <adftool.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gettext.h"
+#include "relocatable.h"
+#include "progname.h"
+#include <locale.h>
+#include <assert.h>
+
+#define _(String) gettext(String)
+#define N_(String) (String)
+
+#include "libadftool/page_cache.h"
+
+/* Check that the shared page cache stays within its budget, evicts
+   the pages that have not been read recently, whatever their owner,
+   finds the pages by hash, keeps more of the small pages, and
+   computes the share of each owner without overflow. */
+
+static int *
+make_page (int value)
+{
+  int *page = malloc (sizeof (int));
+  if (page == NULL)
+    {
+      abort ();
+    }
+  *page = value;
+  return page;
+}
+
+static void
+check_many_pages (void)
+{
+  /* Many owners and pages, so that the hash buckets are shared: every
+     page that is found has the right value. */
+  static const char owners[7] = { 0 };
+  struct page_cache *cache = page_cache_alloc (sizeof (int),
+					       1000 * sizeof (int));
+  if (cache == NULL)
+    {
+      abort ();
+    }
+  for (size_t k = 0; k < 7; k++)
+    {
+      page_cache_register (cache);
+    }
+  for (int i = 0; i < 5000; i++)
+    {
+      page_cache_insert (cache, &owners[i % 7], i / 7, make_page (i),
+			 sizeof (int));
+    }
+  assert (cache->n_pages == 1000);
+  size_t n_found = 0;
+  for (int i = 0; i < 5000; i++)
+    {
+      int value;
+      if (page_cache_read (cache, &owners[i % 7], i / 7, &value))
+	{
+	  assert (value == i);
+	  n_found++;
+	}
+    }
+  assert (n_found == 1000);
+  /* The last pages are still there. */
+  for (int i = 4900; i < 5000; i++)
+    {
+      assert (page_cache_has (cache, &owners[i % 7], i / 7));
+    }
+  page_cache_unregister (cache, &owners[3]);
+  n_found = 0;
+  for (int i = 0; i < 5000; i++)
+    {
+      int value;
+      if (page_cache_read (cache, &owners[i % 7], i / 7, &value))
+	{
+	  assert (i % 7 != 3);
+	  assert (value == i);
+	  n_found++;
+	}
+    }
+  assert (n_found == cache->n_pages);
+  for (size_t k = 0; k < 7; k++)
+    {
+      if (k != 3)
+	{
+	  page_cache_unregister (cache, &owners[k]);
+	}
+    }
+  assert (cache->n_pages == 0);
+  page_cache_free (cache);
+}
+
+static void
+check_small_pages (void)
+{
+  /* The pages of 1 int in a cache of pages of 4 ints: 4 times as many
+     fit in the budget, and a full page makes room for itself. */
+  static const char owner = 0;
+  struct page_cache *cache =
+    page_cache_alloc (4 * sizeof (int), 4 * 4 * sizeof (int));
+  if (cache == NULL)
+    {
+      abort ();
+    }
+  page_cache_register (cache);
+  assert (page_cache_share (cache) == 4);
+  for (int i = 0; i < 40; i++)
+    {
+      page_cache_insert (cache, &owner, i, make_page (i), sizeof (int));
+    }
+  assert (cache->n_pages == 16);
+  assert (page_cache_share (cache) == 16);
+  int values[4];
+  for (int i = 0; i < 40; i++)
+    {
+      assert (page_cache_read (cache, &owner, i, values) == (i >= 24));
+      assert (i < 24 || values[0] == i);
+    }
+  int *full_page = malloc (4 * sizeof (int));
+  if (full_page == NULL)
+    {
+      abort ();
+    }
+  for (int k = 0; k < 4; k++)
+    {
+      full_page[k] = 100 + k;
+    }
+  page_cache_insert (cache, &owner, 40, full_page, 4 * sizeof (int));
+  assert (cache->n_pages == 13);
+  assert (cache->used_bytes <= cache->budget);
+  assert (page_cache_read (cache, &owner, 40, values));
+  for (int k = 0; k < 4; k++)
+    {
+      assert (values[k] == 100 + k);
+    }
+  page_cache_unregister (cache, &owner);
+  assert (cache->n_pages == 0 && cache->used_bytes == 0);
+  page_cache_free (cache);
+}
+
+static void
+check_large_budget (void)
+{
+  /* 8 pages of 4 MiB in a budget of 1 GiB: the share is 256 pages,
+     even though the budget times the number of pages does not fit in
+     32 bits. */
+  static const char owner = 0;
+  const size_t page_bytes = 4 * 1024 * 1024;
+  struct page_cache *cache =
+    page_cache_alloc (4 * page_bytes, 1024 * 1024 * 1024);
+  if (cache == NULL)
+    {
+      abort ();
+    }
+  page_cache_register (cache);
+  for (size_t i = 0; i < 8; i++)
+    {
+      void *page = calloc (page_bytes, 1);
+      if (page == NULL)
+	{
+	  abort ();
+	}
+      page_cache_insert (cache, &owner, i, page, page_bytes);
+    }
+  assert (cache->n_pages == 8);
+  assert (page_cache_share (cache) == 256);
+  page_cache_unregister (cache, &owner);
+  page_cache_free (cache);
+}
+
+int
+main (int argc, char *argv[])
+{
+  (void) argc;
+  set_program_name (argv[0]);
+  setlocale (LC_ALL, "");
+  bindtextdomain (PACKAGE, relocate (LOCALEDIR));
+  textdomain (PACKAGE);
+  static const char owner_a = 'a', owner_b = 'b';
+  /* 3 pages, and a bit. */
+  struct page_cache *cache =
+    page_cache_alloc (sizeof (int), 3 * sizeof (int) + 1);
+  if (cache == NULL)
+    {
+      abort ();
+    }
+  page_cache_register (cache);
+  page_cache_register (cache);
+  assert (page_cache_share (cache) == 1);
+  page_cache_insert (cache, &owner_a, 0, make_page (10), sizeof (int));
+  page_cache_insert (cache, &owner_a, 1, make_page (11), sizeof (int));
+  page_cache_insert (cache, &owner_b, 0, make_page (20), sizeof (int));
+  assert (cache->n_pages == 3);
+  int value;
+  assert (page_cache_read (cache, &owner_a, 0, &value) && value == 10);
+  assert (page_cache_read (cache, &owner_b, 0, &value) && value == 20);
+  assert (!page_cache_read (cache, &owner_b, 1, &value));
+  /* Replacing a page does not evict anything. */
+  page_cache_insert (cache, &owner_a, 1, make_page (12), sizeof (int));
+  assert (cache->n_pages == 3);
+  assert (page_cache_read (cache, &owner_a, 1, &value) && value == 12);
+  /* All pages are referenced: the hand clears them all, and evicts
+     the first one. */
+  page_cache_insert (cache, &owner_b, 1, make_page (21), sizeof (int));
+  assert (cache->n_pages == 3);
+  assert (!page_cache_has (cache, &owner_a, 0));
+  assert (page_cache_has (cache, &owner_a, 1));
+  assert (page_cache_has (cache, &owner_b, 0));
+  assert (page_cache_has (cache, &owner_b, 1));
+  /* Reading (a, 1) protects it, so (b, 0) goes next. */
+  assert (page_cache_touch (cache, &owner_a, 1));
+  page_cache_insert (cache, &owner_a, 2, make_page (13), sizeof (int));
+  assert (!page_cache_has (cache, &owner_b, 0));
+  assert (page_cache_has (cache, &owner_a, 1));
+  assert (page_cache_has (cache, &owner_a, 2));
+  assert (page_cache_has (cache, &owner_b, 1));
+  /* When an owner leaves, its pages are dropped, and the others get a
+     bigger share. */
+  page_cache_unregister (cache, &owner_a);
+  assert (cache->n_pages == 1);
+  assert (page_cache_share (cache) == 3);
+  assert (page_cache_read (cache, &owner_b, 1, &value) && value == 21);
+  page_cache_unregister (cache, &owner_b);
+  page_cache_free (cache);
+  check_many_pages ();
+  check_small_pages ();
+  check_large_budget ();
+  return 0;
+}
@@ -108,6 +108,16 @@ const adftool_eeg_get_data = Adftool.cwrap (
     'number',
     ['*', 'number', 'number', '*', 'number', 'number', '*', '*']);
 
+const adftool_eeg_get_data_float = Adftool.cwrap (
+    'adftool_eeg_get_data_float',
+    'number',
+    ['*', 'number', 'number', '*', 'number', 'number', '*', '*']);
+
+const adftool_eeg_get_data_raw = Adftool.cwrap (
+    'adftool_eeg_get_data_raw',
+    'number',
+    ['*', 'number', 'number', '*', 'number', 'number', '*', '*', '*', '*', '*']);
+
 const adftool_eeg_get_time = Adftool.cwrap (
     'adftool_eeg_get_time',
     'number',
@@ -394,6 +404,84 @@ export class File {
 	    }
 	});
     }
+    eeg_get_data_float (channel, first_observation, n_observations, f) {
+	return with_size_t_array (2, (dimensions) => {
+	    const output_pointer = Adftool._malloc (n_observations * 4);
+	    try {
+		const error = adftool_eeg_get_data_float (this._ptr, first_observation, n_observations, dimensions.address (0), channel, 1, dimensions.address (1), output_pointer);
+		if (error != 0) {
+		    throw 'Cannot get the data!';
+		}
+		const n_points = dimensions.get (0);
+		const n_channels = dimensions.get (1);
+		const flt_offset = output_pointer / 4;
+		let true_n_observations = n_observations;
+		if (first_observation >= n_points) {
+		    true_n_observations = 0;
+		} else if (first_observation + n_observations > n_points) {
+		    /* We requested more than is available. */
+		    true_n_observations = n_points - first_observation;
+		}
+		const view =
+		      Adftool.HEAPF32.subarray (
+			  flt_offset, flt_offset + true_n_observations);
+		return f (n_points, n_channels, view);
+	    } finally {
+		Adftool._free (output_pointer);
+	    }
+	});
+    }
+    eeg_get_data_raw (channel, first_observation, n_observations, f) {
+	/* Observation first_observation + i is decoded as
+	 * codes[i] * scales[b] + offsets[b], with b =
+	 * floor ((first_observation + i) / block_length) -
+	 * floor (first_observation / block_length). */
+	return with_size_t_array (3, (dimensions) => {
+	    let error = adftool_eeg_get_data_raw (this._ptr, 0, 0, dimensions.address (0), 0, 0, dimensions.address (1), 0, dimensions.address (2), 0, 0);
+	    if (error != 0) {
+		throw 'Cannot get the data!';
+	    }
+	    const block_length = dimensions.get (2);
+	    let n_blocks = 0;
+	    if (n_observations != 0) {
+		n_blocks =
+		    Math.floor ((first_observation + n_observations - 1) / block_length)
+		    - Math.floor (first_observation / block_length) + 1;
+	    }
+	    const output_pointer = Adftool._malloc (n_observations * 2);
+	    const decoders_pointer = Adftool._malloc (n_blocks * 2 * 8);
+	    try {
+		error = adftool_eeg_get_data_raw (this._ptr, first_observation, n_observations, dimensions.address (0), channel, 1, dimensions.address (1), output_pointer, dimensions.address (2), decoders_pointer, decoders_pointer + n_blocks * 8);
+		if (error != 0) {
+		    throw 'Cannot get the data!';
+		}
+		const n_points = dimensions.get (0);
+		const n_channels = dimensions.get (1);
+		const code_offset = output_pointer / 2;
+		const decoders_offset = decoders_pointer / 8;
+		let true_n_observations = n_observations;
+		if (first_observation >= n_points) {
+		    true_n_observations = 0;
+		} else if (first_observation + n_observations > n_points) {
+		    /* We requested more than is available. */
+		    true_n_observations = n_points - first_observation;
+		}
+		const codes =
+		      Adftool.HEAPU16.subarray (
+			  code_offset, code_offset + true_n_observations);
+		const scales =
+		      Adftool.HEAPF64.subarray (
+			  decoders_offset, decoders_offset + n_blocks);
+		const offsets =
+		      Adftool.HEAPF64.subarray (
+			  decoders_offset + n_blocks, decoders_offset + 2 * n_blocks);
+		return f (n_points, n_channels, codes, block_length, scales, offsets);
+	    } finally {
+		Adftool._free (decoders_pointer);
+		Adftool._free (output_pointer);
+	    }
+	});
+    }
     eeg_get_time (observation, f) {
 	return with_timespec ((ts) => {
 	    return with_double_array (1, (sfreq) => {
@@ -268,6 +268,22 @@ AdftoolFactory ().then (Adftool => {
 	    assert (n_channels == 2);
 	    assert (data.length == 0);
 	});
+	f.eeg_get_data_float (1, 2, 5, (n_points, n_channels, data) => {
+	    assert (n_points == 4);
+	    assert (n_channels == 2);
+	    assert (data.length == 2);
+	    assert (float_eq (data[0], -0.1521410));
+	    assert (float_eq (data[1], -1.0824288));
+	});
+	f.eeg_get_data_raw (1, 2, 5, (n_points, n_channels, codes, block_length, scales, offsets) => {
+	    assert (n_points == 4);
+	    assert (n_channels == 2);
+	    assert (codes.length == 2);
+	    assert (block_length > 0);
+	    assert (scales.length == 1);
+	    assert (float_eq (codes[0] * scales[0] + offsets[0], -0.1521410));
+	    assert (float_eq (codes[1] * scales[0] + offsets[0], -1.0824288));
+	});
     });
 
     Adftool.with_file(new Uint8Array (0), (f) => {
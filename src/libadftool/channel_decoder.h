@@ -33,6 +33,12 @@ static inline int channel_decoder_set (struct adftool_file *file,
 				       const struct adftool_term *identifier,
 				       double scale, double offset);
 
+MAYBE_UNUSED static int channel_decoder_table_get (struct adftool_file *file,
+						   size_t channel_start,
+						   size_t channel_length,
+						   double *scales,
+						   double *offsets);
+
 static int
 channel_decoder_find (struct adftool_file *file,
 		      const struct adftool_term *identifier,
@@ -154,4 +160,99 @@ wrapup:
   return error;
 }
 
+static int
+channel_decoder_table_fill (struct adftool_file *file)
+{
+  /* Resolve the identifier and decoder of every column once, so that
+     reading data does not need to look up the quads indices
+     anymore. */
+  int error = 0;
+  struct adftool_file_eeg_decoders *decoders = &(file->eeg_decoders);
+  adftool_file_eeg_decoders_invalidate (file);
+  hid_t eeg_dataset = adftool_file_eeg_dataset (file);
+  if (eeg_dataset == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  hid_t dataspace = H5Dget_space (eeg_dataset);
+  if (dataspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  hsize_t dimensions[2];
+  if (H5Sget_simple_extent_ndims (dataspace) != 2
+      || H5Sget_simple_extent_dims (dataspace, dimensions, NULL) != 2)
+    {
+      error = 1;
+      goto clean_dataspace;
+    }
+  const size_t n_channels = dimensions[1];
+  decoders->identifiers = calloc (n_channels, sizeof (struct adftool_term *));
+  decoders->scales = calloc (n_channels, sizeof (double));
+  decoders->offsets = calloc (n_channels, sizeof (double));
+  decoders->n_channels = n_channels;
+  if (decoders->identifiers == NULL || decoders->scales == NULL
+      || decoders->offsets == NULL)
+    {
+      error = 1;
+      goto clean_dataspace;
+    }
+  for (size_t j = 0; j < n_channels; j++)
+    {
+      struct adftool_term *identifier = term_alloc ();
+      if (identifier == NULL)
+	{
+	  error = 1;
+	  goto clean_dataspace;
+	}
+      if (adftool_find_channel_identifier (file, j, identifier) != 0
+	  || channel_decoder_get (file, identifier, &(decoders->scales[j]),
+				  &(decoders->offsets[j])) != 0)
+	{
+	  /* This column cannot be decoded. It is only an error if it
+	     is requested. */
+	  term_free (identifier);
+	  identifier = NULL;
+	}
+      decoders->identifiers[j] = identifier;
+    }
+  decoders->valid = true;
+clean_dataspace:
+  H5Sclose (dataspace);
+wrapup:
+  if (error)
+    {
+      adftool_file_eeg_decoders_invalidate (file);
+    }
+  return error;
+}
+
+static int
+channel_decoder_table_get (struct adftool_file *file, size_t channel_start,
+			   size_t channel_length, double *scales,
+			   double *offsets)
+{
+  const struct adftool_file_eeg_decoders *decoders = &(file->eeg_decoders);
+  if (!decoders->valid && channel_decoder_table_fill (file) != 0)
+    {
+      return 1;
+    }
+  if (channel_start + channel_length > decoders->n_channels)
+    {
+      return 1;
+    }
+  for (size_t j = 0; j < channel_length; j++)
+    {
+      if (decoders->identifiers[channel_start + j] == NULL)
+	{
+	  return 1;
+	}
+      scales[j] = decoders->scales[channel_start + j];
+      offsets[j] = decoders->offsets[channel_start + j];
+    }
+  return 0;
+}
+
 #endif /* not H_ADFTOOL_CHANNEL_DECODER_INCLUDED */
@@ -12,9 +12,12 @@
 # include <string.h>
 # include <locale.h>
 # include <stdbool.h>
+# include <stdint.h>
 # include <pthread.h>
 # include <math.h>
 # include "safe-alloc.h"
+# include "page_cache.h"
+# include "fft.h"
 
 # include "gettext.h"
 
@@ -46,6 +49,27 @@ ensure_init (void)
 # define DEALLOC_CHANNEL_PROCESSOR \
   ATTRIBUTE_DEALLOC (channel_processor_free, 1)
 
+/* The number of poles of each edge of the IIR band-pass filter. */
+# define CHANNEL_PROCESSOR_IIR_ORDER 4
+
+/* The number of filtered samples in a page, unless the group is told
+   otherwise. */
+# define CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH 5120
+
+/* The number of pages of a processor that does not share a cache. */
+# define CHANNEL_PROCESSOR_DEFAULT_PAGES 256
+
+/* The filter family of the processors that compute spectrograms
+   instead of filtering. */
+# define CHANNEL_PROCESSOR_SPECTROGRAM 2
+
+/* The power below which a spectrogram shows -300 dB, instead of
+   minus infinity. */
+# define CHANNEL_PROCESSOR_POWER_FLOOR 1e-30
+
+/* The number of values that share a bit width in a packed page. */
+# define CHANNEL_PROCESSOR_PACK_BLOCK 64
+
 struct adftool_channel_processor;
 
 MAYBE_UNUSED static void
@@ -55,16 +79,47 @@ MAYBE_UNUSED DEALLOC_CHANNEL_PROCESSOR
   static struct adftool_channel_processor
   *channel_processor_alloc (struct adftool_file *file,
 			    pthread_mutex_t * file_synchronizer,
+			    struct page_cache *page_cache,
+			    size_t page_length,
 			    const struct adftool_term *channel_type,
-			    double filter_low, double filter_high);
+			    int filter_family, double filter_low,
+			    double filter_high, size_t decimation);
+
+MAYBE_UNUSED DEALLOC_CHANNEL_PROCESSOR
+  static struct adftool_channel_processor
+  *channel_processor_alloc_derived (struct adftool_file *file,
+				    pthread_mutex_t * file_synchronizer,
+				    struct page_cache *page_cache,
+				    size_t page_length, size_t n_terms,
+				    const struct adftool_term *const
+				    *channel_types, const double *weights,
+				    int filter_family, double filter_low,
+				    double filter_high, size_t decimation,
+				    size_t spectrogram_window);
+
+MAYBE_UNUSED
+  static bool channel_processor_can_serve_derived (const struct
+						   adftool_channel_processor
+						   *processor,
+						   size_t n_terms,
+						   const struct adftool_term
+						   *const *channel_types,
+						   const double *weights,
+						   int filter_family,
+						   double filter_low,
+						   double filter_high,
+						   size_t decimation,
+						   size_t spectrogram_window);
 
 MAYBE_UNUSED
   static bool channel_processor_can_serve (const struct
 					   adftool_channel_processor
 					   *processor,
 					   const struct adftool_term
-					   *channel_type, double filter_low,
-					   double filter_high);
+					   *channel_type, int filter_family,
+					   double filter_low,
+					   double filter_high,
+					   size_t decimation);
 
 MAYBE_UNUSED
   static int channel_processor_get (struct adftool_channel_processor
@@ -81,205 +136,819 @@ struct adftool_channel_processor_page
 {
   size_t index;
   double scale;
-  int16_t data[5120];
+  /* If packed_length is 0, data holds page_length values, or
+     page_length frames of n_bins values for a spectrogram. Otherwise,
+     data holds packed_length bytes that pack them. */
+  size_t packed_length;
+  int16_t data[];
 };
 
+static inline size_t
+channel_processor_page_bytes (size_t page_length)
+{
+  return (sizeof (struct adftool_channel_processor_page)
+	  + page_length * sizeof (int16_t));
+}
+
+static inline struct adftool_channel_processor_page *
+channel_processor_page_alloc (const struct page_cache *page_cache)
+{
+  /* Room for the biggest page of the cache, even if the processor
+     does not fill it, or packs it. */
+  return malloc (page_cache->page_bytes);
+}
+
 struct adftool_channel_processor
 {
   struct adftool_file *file;
-  struct adftool_term *channel_type;
-  size_t channel_index;
-  struct adftool_fir *filter;
+  /* The signal is the sum of the columns channel_indices, where the
+     channels of type channel_types are stored, each multiplied by its
+     weight. It is computed before filtering. A stored channel has
+     one term, with weight 1. */
+  size_t n_terms;
+  struct adftool_term **channel_types;
+  size_t *channel_indices;
+  double *weights;
+  /* ADFTOOL_FILTER_FIR or ADFTOOL_FILTER_IIR. With the FIR filter,
+     iir is NULL. With the IIR filter, filter and stream are NULL, and
+     each page is filtered forward and backward, with enough samples
+     around it for the filter to settle. */
+  int filter_family;
+  struct adftool_iir *iir;
+  /* Shared with the other processors for the same band. */
+  const struct adftool_fir *filter;
+  /* When the pages are computed in order, the filter continues from
+     the previous page. */
+  struct adftool_fir_stream *stream;
+  size_t stream_next_page;
   double filter_low;
   double filter_high;
+  /* Keep one filtered sample every decimation. The pages, the window
+     and the requests count decimated samples; time_max counts the
+     samples of the recording. */
+  size_t decimation;
+  /* With the CHANNEL_PROCESSOR_SPECTROGRAM family, each index of the
+     pages and of the window is a frame: the power spectral density,
+     in decibels, of spectrogram_window samples starting at index *
+     decimation, tapered, for the n_bins frequencies from first_bin *
+     sfreq / fft_size. filter_low and filter_high delimit the
+     band. Otherwise, n_bins is 1 and spectrogram_window is 0. */
+  size_t spectrogram_window;
+  size_t n_bins;
+  size_t first_bin;
+  size_t fft_size;
+  double *taper;
+  double *twiddles;
+  double power_scale;
   pthread_mutex_t *file_synchronizer;
+  /* Protects the fields of the processor, and serializes the
+     filtering. The pages are in page_cache, which has its own
+     lock. It is shared with the other processors of the group, or
+     owned by this one. */
   pthread_mutex_t cache_synchronizer;
-  struct adftool_channel_processor_page *cache[256];
+  struct page_cache *page_cache;
+  bool owns_page_cache;
+  size_t page_length;
   size_t start_index;
   size_t window_length;
+  /* Whether the window last moved toward the start of the recording,
+     so that the pages before it are prefetched instead of the pages
+     after it. */
+  bool scrolls_backward;
   size_t time_max;
+  /* Managed by the group, under its channel list lock: the number of
+     threads working with the processor, and whether the group has
+     dropped it, in which case the last of them frees it. */
+  size_t n_users;
+  bool dropped;
 };
 
 static inline bool
-channel_processor_page_is_relevant (const struct adftool_channel_processor
-				    *processor,
-				    const struct
-				    adftool_channel_processor_page *page)
+channel_processor_has_page (const struct adftool_channel_processor
+			    *processor, size_t page_index)
 {
-  const size_t page_start =
-    page->index * (sizeof (page->data) / sizeof (page->data[0]));
-  const size_t page_length = sizeof (page->data) / sizeof (page->data[0]);
-  const size_t page_stop = page_start + page_length;
-  const size_t request_start = processor->start_index;
-  const size_t request_length = processor->window_length;
-  const size_t request_stop = request_start + request_length;
-  const bool page_is_too_early = page_stop <= request_start;
-  const bool page_is_too_late = page_start >= request_stop;
-  const bool page_is_irrelevant = page_is_too_early || page_is_too_late;
-  return !page_is_irrelevant;
+  return page_cache_has (processor->page_cache, processor, page_index);
+}
+
+static inline size_t
+channel_processor_n_pages_to_load (const struct adftool_channel_processor
+				   *processor)
+{
+  /* The number of pages of the window, from its start, that the
+     processor fills, so that it does not evict the pages of the other
+     processors that share the cache. */
+  return page_cache_share (processor->page_cache);
 }
 
 static inline void
-channel_processor_swap_pages (struct adftool_channel_processor *processor,
-			      size_t i, size_t j)
+channel_processor_wanted_pages (const struct adftool_channel_processor
+				*processor, size_t *first_visible,
+				size_t *n_visible, size_t *n_prefetch)
 {
-  struct adftool_channel_processor_page *hold = processor->cache[i];
-  processor->cache[i] = processor->cache[j];
-  processor->cache[j] = hold;
+  /* The processor wants the pages of its window, then as many pages
+     past the window, in the direction of the last move, so that the
+     next screen is ready. They must all fit in its share of the
+     cache. */
+  const size_t page_size = processor->page_length;
+  const size_t share = channel_processor_n_pages_to_load (processor);
+  const size_t window_stop = processor->start_index + processor->window_length;
+  *first_visible = processor->start_index / page_size;
+  *n_visible = (window_stop + page_size - 1) / page_size - *first_visible;
+  if (*n_visible > share)
+    {
+      *n_visible = share;
+    }
+  *n_prefetch = *n_visible;
+  if (*n_prefetch > share - *n_visible)
+    {
+      *n_prefetch = share - *n_visible;
+    }
+  size_t n_available = 0;
+  if (processor->scrolls_backward)
+    {
+      n_available = *first_visible;
+    }
+  else if (processor->time_max != 0)
+    {
+      /* Before the first page is filtered, the end of the recording is
+         not known, so nothing is prefetched. */
+      const size_t time_max =
+	(processor->time_max + processor->decimation - 1)
+	/ processor->decimation;
+      const size_t n_pages = (time_max + page_size - 1) / page_size;
+      const size_t prefetch_start = *first_visible + *n_visible;
+      if (n_pages > prefetch_start)
+	{
+	  n_available = n_pages - prefetch_start;
+	}
+    }
+  if (*n_prefetch > n_available)
+    {
+      *n_prefetch = n_available;
+    }
 }
 
 static inline size_t
-channel_processor_reorder (struct adftool_channel_processor *processor)
+channel_processor_wanted_page (const struct adftool_channel_processor
+			       *processor, size_t first_visible,
+			       size_t n_visible, size_t rank)
 {
-  /* Put the relevant cache pages on top of the cache. Return the
-     number of relevant cache pages. If it is 256, then there is
-     nothing to optimize. */
-  size_t n_relevant = 0;
-  size_t n_checked = 0;
-  while (n_checked < sizeof (processor->cache) / sizeof (processor->cache[0]))
-    {
-      /* Loop invariant: for each i < n_relevant, page i is relevant. */
-      /* Loop invariant: for each n_relevant <= i < n_checked, page i
-         is irrelevant. */
-      assert (n_relevant <= n_checked);
-      if (processor->cache[n_checked] != NULL
-	  && channel_processor_page_is_relevant (processor,
-						 processor->cache[n_checked]))
-	{
-	  channel_processor_swap_pages (processor, n_checked, n_relevant);
-	  n_relevant++;
-	}
-      n_checked++;
-    }
-  return n_relevant;
+  /* The visible pages come first, then the prefetched pages, nearest
+     to the window first. */
+  if (rank < n_visible || !processor->scrolls_backward)
+    {
+      return first_visible + rank;
+    }
+  return first_visible - 1 - (rank - n_visible);
+}
+
+static inline bool
+channel_processor_wants_page (const struct adftool_channel_processor
+			      *processor, size_t page_index)
+{
+  size_t first_visible, n_visible, n_prefetch;
+  channel_processor_wanted_pages (processor, &first_visible, &n_visible,
+				  &n_prefetch);
+  size_t first_wanted = first_visible;
+  if (processor->scrolls_backward)
+    {
+      first_wanted -= n_prefetch;
+    }
+  return (page_index >= first_wanted
+	  && page_index - first_wanted < n_visible + n_prefetch);
 }
 
 static inline int
-channel_processor_get_data_page (struct adftool_channel_processor *processor,
-				 size_t page_index,
-				 size_t *restrict margin_before,
-				 size_t *restrict margin_after,
-				 size_t *restrict length,
-				 size_t *restrict time_max, double **data)
+channel_processor_read (struct adftool_file *file,
+			pthread_mutex_t * file_synchronizer,
+			size_t time_start, size_t time_length,
+			size_t *time_max, size_t n_channels,
+			const size_t *channel_indices, double *columns)
 {
+  /* Read time_length samples of each channel into consecutive
+     columns. The samples after the end of the recording are 0. HDF5
+     does not read concurrently, so the file is only locked to read
+     the 16-bit codes of all the channels at once, in one selection
+     that spans them. The codes are decoded after the lock is
+     released, so that the other threads can read meanwhile. */
   int error = 0;
-  const size_t page_size =
-    sizeof (processor->cache[0]->data) /
-    sizeof (processor->cache[0]->data[0]);
-  const size_t start_index = page_index * page_size;
-  if (pthread_mutex_lock (processor->file_synchronizer) != 0)
+  size_t first_channel = SIZE_MAX, last_channel = 0;
+  for (size_t k = 0; k < n_channels; k++)
     {
-      error = -2;
-      goto cleanup;
+      if (channel_indices[k] < first_channel)
+	{
+	  first_channel = channel_indices[k];
+	}
+      if (channel_indices[k] > last_channel)
+	{
+	  last_channel = channel_indices[k];
+	}
     }
-  const size_t normal_margin = adftool_fir_order (processor->filter);
-  *margin_after = normal_margin;
-  if (normal_margin >= start_index)
+  for (size_t i = 0; i < n_channels * time_length; i++)
     {
-      /* Subtracting normal_margin to the start index would be a negative number. */
-      *margin_before = start_index;
+      columns[i] = 0;
     }
-  else
+  if (n_channels == 0 || time_length == 0)
     {
-      *margin_before = normal_margin;
+      goto cleanup;
     }
-  assert (*margin_before <= normal_margin);
-  assert (start_index >= *margin_before);
-  /* i.e. start_index - *margin_before >= 0 */
-  *length = page_size;
-  const size_t total_length = *margin_before + *length + *margin_after;
-  if (ALLOC_N (*data, total_length) < 0)
+  const size_t n_columns = last_channel - first_channel + 1;
+  uint16_t *codes = NULL;
+  double *scales = NULL;
+  double *offsets = NULL;
+  size_t channel_max, block_length;
+  if (ALLOC_N (codes, time_length * n_columns) < 0)
     {
       error = -2;
-      goto unlock;
+      goto cleanup;
+    }
+  if (pthread_mutex_lock (file_synchronizer) != 0)
+    {
+      error = -2;
+      goto cleanup_codes;
     }
-  size_t channel_max;
+  /* The first call only tells the block length, so that the decoders
+     can be allocated. */
   error =
-    adftool_eeg_get_data (processor->file, start_index - *margin_before,
-			  *margin_before + *length + *margin_after, time_max,
-			  processor->channel_index, 1, &channel_max, *data);
-unlock:
-  if (pthread_mutex_unlock (processor->file_synchronizer) != 0)
+    adftool_eeg_get_data_raw (file, time_start, 0, time_max, first_channel,
+			      n_columns, &channel_max, NULL, &block_length,
+			      NULL, NULL);
+  if (error == 0)
+    {
+      /* block_length is only set if there is data. */
+      const size_t n_blocks =
+	(time_start + time_length - 1) / block_length
+	- time_start / block_length + 1;
+      if (ALLOC_N (scales, n_blocks * n_columns) < 0
+	  || ALLOC_N (offsets, n_blocks * n_columns) < 0)
+	{
+	  error = -2;
+	}
+    }
+  if (error == 0)
+    {
+      error =
+	adftool_eeg_get_data_raw (file, time_start, time_length, time_max,
+				  first_channel, n_columns, &channel_max,
+				  codes, &block_length, scales, offsets);
+    }
+  if (pthread_mutex_unlock (file_synchronizer) != 0)
     {
       abort ();
     }
+  if (error != 0)
+    {
+      goto cleanup_decoders;
+    }
+  size_t n_valid = 0;
+  if (time_start < *time_max)
+    {
+      n_valid = *time_max - time_start;
+    }
+  if (n_valid > time_length)
+    {
+      n_valid = time_length;
+    }
+  for (size_t k = 0; k < n_channels; k++)
+    {
+      const size_t j = channel_indices[k] - first_channel;
+      double *column = columns + k * time_length;
+      for (size_t i = 0; i < n_valid; i++)
+	{
+	  const size_t b =
+	    (time_start + i) / block_length - time_start / block_length;
+	  column[i] =
+	    codes[i * n_columns + j] * scales[b * n_columns + j]
+	    + offsets[b * n_columns + j];
+	}
+    }
+cleanup_decoders:
+  FREE (offsets);
+  FREE (scales);
+cleanup_codes:
+  FREE (codes);
 cleanup:
   return error;
 }
 
 static inline int
-channel_processor_push_page (struct adftool_channel_processor *processor,
-			     size_t page_index, bool *work_done)
+channel_processor_read_signals (size_t n_processors,
+				struct adftool_channel_processor *const
+				*processors, size_t time_start,
+				size_t time_length, size_t *time_max,
+				double *columns)
 {
+  /* Read the signal of each processor into consecutive columns. The
+     columns of all the terms are read at once, then combined. */
   int error = 0;
-  struct adftool_channel_processor_page *page = NULL;
-  for (size_t i = 0;
-       i < sizeof (processor->cache) / sizeof (processor->cache[0]); i++)
+  size_t n_columns = 0;
+  bool is_stored = true;
+  for (size_t k = 0; k < n_processors; k++)
+    {
+      n_columns += processors[k]->n_terms;
+      is_stored = (is_stored && processors[k]->n_terms == 1
+		   && processors[k]->weights[0] == 1);
+    }
+  size_t *channel_indices = NULL;
+  double *terms = NULL;
+  if (ALLOC_N (channel_indices, n_columns) < 0)
+    {
+      error = -2;
+      goto cleanup;
+    }
+  for (size_t k = 0, c = 0; k < n_processors; k++)
     {
-      if (processor->cache[i] != NULL
-	  && processor->cache[i]->index == page_index)
+      for (size_t t = 0; t < processors[k]->n_terms; t++)
 	{
-	  page = processor->cache[i];
-	  processor->cache[i] = NULL;
-	  break;
+	  channel_indices[c++] = processors[k]->channel_indices[t];
 	}
     }
-  if (page == NULL)
+  if (is_stored)
+    {
+      /* Nothing to combine. */
+      error =
+	channel_processor_read (processors[0]->file,
+				processors[0]->file_synchronizer, time_start,
+				time_length, time_max, n_columns,
+				channel_indices, columns);
+      goto cleanup;
+    }
+  if (ALLOC_N (terms, n_columns * time_length) < 0)
+    {
+      error = -2;
+      goto cleanup;
+    }
+  error =
+    channel_processor_read (processors[0]->file,
+			    processors[0]->file_synchronizer, time_start,
+			    time_length, time_max, n_columns,
+			    channel_indices, terms);
+  if (error != 0)
     {
-      if (ALLOC (page) < 0)
+      goto cleanup;
+    }
+  for (size_t k = 0, c = 0; k < n_processors; k++)
+    {
+      double *column = columns + k * time_length;
+      for (size_t i = 0; i < time_length; i++)
 	{
-	  error = -2;
-	  goto cleanup;
+	  column[i] = 0;
 	}
-      size_t margin_before, margin_after;
-      size_t page_size;
-      double *data_to_filter;
-      error =
-	channel_processor_get_data_page (processor, page_index,
-					 &margin_before, &margin_after,
-					 &page_size, &(processor->time_max),
-					 &data_to_filter);
-      if (error < 0)
+      for (size_t t = 0; t < processors[k]->n_terms; t++, c++)
 	{
-	  goto cleanup_page;
+	  const double weight = processors[k]->weights[t];
+	  const double *term = terms + c * time_length;
+	  for (size_t i = 0; i < time_length; i++)
+	    {
+	      column[i] += weight * term[i];
+	    }
 	}
-      double *filtered;
-      if (ALLOC_N (filtered, margin_before + page_size + margin_after) < 0)
+    }
+cleanup:
+  FREE (terms);
+  FREE (channel_indices);
+  return error;
+}
+
+static inline int
+channel_processor_filter_page_iir (struct adftool_channel_processor
+				   *processor, size_t page_index,
+				   size_t *restrict time_max,
+				   double *restrict filtered)
+{
+  /* The forward pass needs the samples before the page to settle, and
+     the backward pass the samples after it. */
+  int error = 0;
+  const size_t page_size = processor->page_length;
+  const size_t page_span = page_size * processor->decimation;
+  const size_t start_index = page_index * page_span;
+  const size_t settle_length = adftool_iir_settle_length (processor->iir);
+  const size_t history_length =
+    (settle_length < start_index ? settle_length : start_index);
+  const size_t n_samples = history_length + page_span + settle_length;
+  double *data;
+  if (ALLOC_N (data, n_samples) < 0)
+    {
+      error = -2;
+      goto cleanup;
+    }
+  error =
+    channel_processor_read_signals (1, &processor,
+				    start_index - history_length, n_samples,
+				    time_max, data);
+  if (error != 0)
+    {
+      goto cleanup_data;
+    }
+  if (adftool_iir_apply_zero_phase (processor->iir, n_samples, data, data)
+      != 0)
+    {
+      error = -2;
+      goto cleanup_data;
+    }
+  for (size_t i = 0; i < page_size; i++)
+    {
+      filtered[i] = data[history_length + i * processor->decimation];
+    }
+cleanup_data:
+  FREE (data);
+cleanup:
+  return error;
+}
+
+static inline size_t
+channel_processor_spectrogram_bins (double sfreq, size_t window_length,
+				    double freq_low, double freq_high,
+				    size_t *fft_size, size_t *first_bin)
+{
+  /* Return the number of frequencies of the band in the spectrum of
+     a window zero-padded up to a power of 2. An edge at 0 or past the
+     Nyquist frequency is left open. */
+  *fft_size = fft_size_at_least (window_length);
+  const double bin_width = sfreq / *fft_size;
+  size_t last_bin = *fft_size / 2;
+  *first_bin = 0;
+  if (freq_low > 0)
+    {
+      *first_bin = ceil (freq_low / bin_width);
+    }
+  if (freq_high > 0 && freq_high < sfreq / 2)
+    {
+      last_bin = floor (freq_high / bin_width);
+    }
+  if (last_bin < *first_bin)
+    {
+      return 0;
+    }
+  return last_bin - *first_bin + 1;
+}
+
+static inline int
+channel_processor_spectrogram_page (struct adftool_channel_processor
+				    *processor, size_t page_index,
+				    size_t *restrict time_max,
+				    double *restrict power)
+{
+  /* The frames of a page overlap if the hop is shorter than the
+     window, so the samples are read once for all of them. */
+  int error = 0;
+  const size_t n_frames = processor->page_length;
+  const size_t hop = processor->decimation;
+  const size_t window_length = processor->spectrogram_window;
+  const size_t fft_size = processor->fft_size;
+  const size_t n_samples = (n_frames - 1) * hop + window_length;
+  double *data = NULL;
+  double *spectrum = NULL;
+  if (ALLOC_N (data, n_samples) < 0 || ALLOC_N (spectrum, 2 * fft_size) < 0)
+    {
+      error = -2;
+      goto cleanup;
+    }
+  error =
+    channel_processor_read_signals (1, &processor,
+				    page_index * n_frames * hop, n_samples,
+				    time_max, data);
+  if (error != 0)
+    {
+      goto cleanup;
+    }
+  for (size_t f = 0; f < n_frames; f++)
+    {
+      const double *frame = data + f * hop;
+      for (size_t i = 0; i < fft_size; i++)
 	{
-	  goto cleanup_data_to_filter;
+	  spectrum[2 * i] = 0;
+	  spectrum[2 * i + 1] = 0;
+	  if (i < window_length)
+	    {
+	      spectrum[2 * i] = frame[i] * processor->taper[i];
+	    }
 	}
-      adftool_fir_apply (processor->filter,
-			 margin_before + page_size + margin_after,
-			 data_to_filter, filtered);
-      double amplitude_max = 0;
-      for (size_t i = 0; i < page_size; i++)
+      fft_transform (fft_size, processor->twiddles, false, spectrum);
+      for (size_t b = 0; b < processor->n_bins; b++)
 	{
-	  double ampl = filtered[i + margin_before];
-	  if (ampl < 0)
+	  const size_t k = processor->first_bin + b;
+	  double density =
+	    (spectrum[2 * k] * spectrum[2 * k]
+	     + spectrum[2 * k + 1] * spectrum[2 * k + 1])
+	    * processor->power_scale;
+	  if (k != 0 && 2 * k != fft_size)
+	    {
+	      /* The negative frequencies have the same power. */
+	      density *= 2;
+	    }
+	  if (density < CHANNEL_PROCESSOR_POWER_FLOOR)
 	    {
-	      ampl = -ampl;
+	      density = CHANNEL_PROCESSOR_POWER_FLOOR;
 	    }
-	  if (ampl > amplitude_max)
+	  power[f * processor->n_bins + b] = 10 * log10 (density);
+	}
+    }
+cleanup:
+  FREE (spectrum);
+  FREE (data);
+  return error;
+}
+
+static inline int
+channel_processor_filter_page_fir (size_t n_processors,
+				   struct adftool_channel_processor *const
+				   *processors, size_t page_index,
+				   size_t *restrict time_max,
+				   double *restrict filtered)
+{
+  /* Filter the same page for processors that share the FIR filter,
+     into consecutive pages of filtered. The signals are read at
+     once. If the previous page has been filtered, a filter stream
+     only needs the samples that follow what it already has: the page
+     shifted by half the filter order. Otherwise, it needs half the
+     order of history before the page, too. */
+  int error = 0;
+  const size_t page_size = processors[0]->page_length;
+  const size_t page_span = page_size * processors[0]->decimation;
+  const size_t start_index = page_index * page_span;
+  const size_t half_order = adftool_fir_order (processors[0]->filter) / 2;
+  bool is_continued = true;
+  for (size_t k = 0; k < n_processors; k++)
+    {
+      is_continued = (is_continued
+		      && processors[k]->stream_next_page == page_index);
+    }
+  /* If one of the streams starts over, the block covers its history,
+     and the new samples of the others are at its end. */
+  size_t history_length = 0;
+  size_t n_rows = page_span;
+  if (!is_continued)
+    {
+      history_length = half_order;
+      if (history_length > start_index)
+	{
+	  history_length = start_index;
+	}
+      n_rows = history_length + page_span + half_order;
+    }
+  const size_t read_start =
+    (is_continued ? start_index + half_order : start_index - history_length);
+  double *columns;
+  if (ALLOC_N (columns, n_processors * n_rows) < 0)
+    {
+      error = -2;
+      goto cleanup;
+    }
+  error =
+    channel_processor_read_signals (n_processors, processors, read_start,
+				    n_rows, time_max, columns);
+  for (size_t k = 0; k < n_processors && error == 0; k++)
+    {
+      struct adftool_channel_processor *processor = processors[k];
+      const double *column = columns + k * n_rows;
+      size_t n_samples = page_span;
+      if (processor->stream_next_page == page_index)
+	{
+	  column += n_rows - page_span;
+	}
+      else
+	{
+	  adftool_fir_stream_reset (processor->stream, history_length,
+				    column);
+	  column += history_length;
+	  n_samples += half_order;
+	}
+      /* The stream becomes unusable if there is an error. */
+      processor->stream_next_page = SIZE_MAX;
+      size_t n_filtered;
+      if (adftool_fir_stream_push
+	  (processor->stream, n_samples, column, &n_filtered,
+	   filtered + k * page_size) != 0)
+	{
+	  error = -2;
+	  break;
+	}
+      assert (n_filtered == page_size);
+      processor->stream_next_page = page_index + 1;
+    }
+  FREE (columns);
+cleanup:
+  return error;
+}
+
+static inline int
+channel_processor_filter_page (struct adftool_channel_processor *processor,
+			       size_t page_index, size_t *restrict time_max,
+			       double *restrict filtered)
+{
+  if (processor->spectrogram_window != 0)
+    {
+      return channel_processor_spectrogram_page (processor, page_index,
+						 time_max, filtered);
+    }
+  if (processor->iir != NULL)
+    {
+      return channel_processor_filter_page_iir (processor, page_index,
+						time_max, filtered);
+    }
+  return channel_processor_filter_page_fir (1, &processor, page_index,
+					    time_max, filtered);
+}
+
+static inline void
+channel_processor_quantize_page (struct adftool_channel_processor_page *page,
+				 size_t page_size, size_t page_index,
+				 size_t stride, const double *filtered)
+{
+  /* The filtered values are filtered[0], filtered[stride], … */
+  double amplitude_max = 0;
+  for (size_t i = 0; i < page_size; i++)
+    {
+      double ampl = filtered[i * stride];
+      if (ampl < 0)
+	{
+	  ampl = -ampl;
+	}
+      if (ampl > amplitude_max)
+	{
+	  amplitude_max = ampl;
+	}
+    }
+  page->index = page_index;
+  page->scale = amplitude_max / 32767.0;
+  page->packed_length = 0;
+  for (size_t i = 0; i < page_size; i++)
+    {
+      double v = 0;
+      if (amplitude_max != 0)
+	{
+	  v = round (filtered[i * stride] / page->scale);
+	}
+      assert (v >= -32767);
+      assert (v <= 32767);
+      page->data[i] = v;
+    }
+}
+
+static inline size_t
+channel_processor_pack (size_t n_values, const int16_t *values,
+			size_t max_length, uint8_t *packed)
+{
+  /* Lossless: for each block, a byte for the bit width, then the
+     differences with the previous values, zigzag-encoded so that the
+     small negative differences are small too, least significant bit
+     first. Return the number of bytes, or 0 if they do not fit in
+     max_length. */
+  size_t length = 0;
+  int32_t previous = 0;
+  for (size_t start = 0; start < n_values;
+       start += CHANNEL_PROCESSOR_PACK_BLOCK)
+    {
+      uint32_t codes[CHANNEL_PROCESSOR_PACK_BLOCK];
+      size_t n = n_values - start;
+      if (n > CHANNEL_PROCESSOR_PACK_BLOCK)
+	{
+	  n = CHANNEL_PROCESSOR_PACK_BLOCK;
+	}
+      uint32_t all_bits = 0;
+      for (size_t i = 0; i < n; i++)
+	{
+	  const int32_t delta = values[start + i] - previous;
+	  previous = values[start + i];
+	  codes[i] = ((uint32_t) delta << 1) ^ (delta < 0 ? UINT32_MAX : 0);
+	  all_bits |= codes[i];
+	}
+      unsigned int width = 0;
+      while ((all_bits >> width) != 0)
+	{
+	  width++;
+	}
+      if (length + 1 + (n * width + 7) / 8 > max_length)
+	{
+	  return 0;
+	}
+      packed[length++] = width;
+      uint64_t buffer = 0;
+      unsigned int n_buffered = 0;
+      for (size_t i = 0; i < n; i++)
+	{
+	  buffer |= (uint64_t) codes[i] << n_buffered;
+	  n_buffered += width;
+	  while (n_buffered >= 8)
 	    {
-	      amplitude_max = ampl;
+	      packed[length++] = buffer & 0xFF;
+	      buffer >>= 8;
+	      n_buffered -= 8;
 	    }
 	}
-      page->index = page_index;
-      page->scale = amplitude_max / 32767.0;
-      for (size_t i = 0; i < page_size; i++)
+      if (n_buffered != 0)
+	{
+	  packed[length++] = buffer;
+	}
+    }
+  return length;
+}
+
+static inline void
+channel_processor_unpack (size_t n_values, const uint8_t *packed,
+			  int16_t *values)
+{
+  int32_t previous = 0;
+  size_t position = 0;
+  for (size_t start = 0; start < n_values;
+       start += CHANNEL_PROCESSOR_PACK_BLOCK)
+    {
+      size_t n = n_values - start;
+      if (n > CHANNEL_PROCESSOR_PACK_BLOCK)
+	{
+	  n = CHANNEL_PROCESSOR_PACK_BLOCK;
+	}
+      const unsigned int width = packed[position++];
+      const uint32_t mask = (UINT32_C (1) << width) - 1;
+      uint64_t buffer = 0;
+      unsigned int n_buffered = 0;
+      for (size_t i = 0; i < n; i++)
 	{
-	  double v = 0;
-	  if (amplitude_max != 0)
+	  while (n_buffered < width)
 	    {
-	      v = round (filtered[i + margin_before] / page->scale);
+	      buffer |= (uint64_t) packed[position++] << n_buffered;
+	      n_buffered += 8;
 	    }
-	  assert (v >= -32767);
-	  assert (v <= 32767);
-	  page->data[i] = v;
+	  const uint32_t code = buffer & mask;
+	  buffer >>= width;
+	  n_buffered -= width;
+	  const int32_t delta =
+	    (int32_t) (code >> 1) ^ -(int32_t) (code & 1);
+	  previous += delta;
+	  values[start + i] = previous;
+	}
+    }
+}
+
+static inline void
+channel_processor_insert_page (struct adftool_channel_processor *processor,
+			       struct adftool_channel_processor_page *page,
+			       size_t page_size, bool pack)
+{
+  /* The cache takes the page, and may evict another one, maybe of
+     another processor. If pack, the page is stored packed, unless it
+     does not get smaller, so that more pages fit in the cache. */
+  size_t page_bytes = channel_processor_page_bytes (page_size);
+  struct adftool_channel_processor_page *packed =
+    (pack ? channel_processor_page_alloc (processor->page_cache) : NULL);
+  if (packed != NULL)
+    {
+      packed->index = page->index;
+      packed->scale = page->scale;
+      packed->packed_length =
+	channel_processor_pack (page_size, page->data,
+				page_size * sizeof (int16_t) - 1,
+				(uint8_t *) packed->data);
+      if (packed->packed_length == 0)
+	{
+	  FREE (packed);
+	}
+      else
+	{
+	  page_bytes =
+	    (sizeof (struct adftool_channel_processor_page)
+	     + packed->packed_length);
+	  struct adftool_channel_processor_page *shrunk =
+	    realloc (packed, page_bytes);
+	  FREE (page);
+	  page = (shrunk == NULL ? packed : shrunk);
+	}
+    }
+  page_cache_insert (processor->page_cache, processor, page->index, page,
+		     page_bytes);
+}
+
+static inline int
+channel_processor_push_page (struct adftool_channel_processor *processor,
+			     size_t page_index, bool pack, bool *work_done)
+{
+  int error = 0;
+  struct adftool_channel_processor_page *page = NULL;
+  if (!page_cache_touch (processor->page_cache, processor, page_index))
+    {
+      const size_t page_size = processor->page_length * processor->n_bins;
+      page = channel_processor_page_alloc (processor->page_cache);
+      if (page == NULL)
+	{
+	  error = -2;
+	  goto cleanup;
+	}
+      double *filtered;
+      if (ALLOC_N (filtered, page_size) < 0)
+	{
+	  error = -2;
+	  goto cleanup_page;
+	}
+      error =
+	channel_processor_filter_page (processor, page_index,
+				       &(processor->time_max), filtered);
+      if (error == 0)
+	{
+	  channel_processor_quantize_page (page, page_size, page_index, 1,
+					   filtered);
 	}
       FREE (filtered);
-    cleanup_data_to_filter:
-      FREE (data_to_filter);
       if (error)
 	{
 	cleanup_page:
@@ -287,17 +956,67 @@ channel_processor_push_page (struct adftool_channel_processor *processor,
 	  goto cleanup;
 	}
       *work_done = true;
+      channel_processor_insert_page (processor, page, page_size, pack);
     }
-  for (size_t i = 0;
-       i < sizeof (processor->cache) / sizeof (processor->cache[0])
-       && page != NULL; i++)
+cleanup:
+  return error;
+}
+
+static inline int
+channel_processor_push_pages (size_t n_processors,
+			      struct adftool_channel_processor **processors,
+			      size_t page_index, bool pack, bool *work_done)
+{
+  /* Filter the same page for all processors at once. They must share
+     the filter, not have that page yet, and their cache must be
+     locked. */
+  int error = 0;
+  const size_t page_size = processors[0]->page_length;
+  double *filtered = NULL;
+  struct adftool_channel_processor_page **pages = NULL;
+  if (ALLOC_N (filtered, n_processors * page_size) < 0
+      || ALLOC_N (pages, n_processors) < 0)
     {
-      struct adftool_channel_processor_page *current = processor->cache[i];
-      processor->cache[i] = page;
-      page = current;
+      error = -2;
+      goto cleanup;
     }
-  FREE (page);
+  for (size_t k = 0; k < n_processors; k++)
+    {
+      pages[k] = channel_processor_page_alloc (processors[k]->page_cache);
+      if (pages[k] == NULL)
+	{
+	  error = -2;
+	  goto cleanup;
+	}
+    }
+  size_t time_max;
+  error =
+    channel_processor_filter_page_fir (n_processors, processors, page_index,
+				       &time_max, filtered);
+  if (error != 0)
+    {
+      goto cleanup;
+    }
+  for (size_t k = 0; k < n_processors; k++)
+    {
+      struct adftool_channel_processor *processor = processors[k];
+      processor->time_max = time_max;
+      channel_processor_quantize_page (pages[k], page_size, page_index, 1,
+				       filtered + k * page_size);
+      channel_processor_insert_page (processor, pages[k], page_size, pack);
+      pages[k] = NULL;
+    }
+  *work_done = true;
 cleanup:
+  if (pages != NULL)
+    {
+      for (size_t k = 0; k < n_processors; k++)
+	{
+	  FREE (pages[k]);
+	}
+    }
+  FREE (pages);
+  FREE (filtered);
   return error;
 }
 
@@ -306,25 +1025,21 @@ channel_processor_populate_cache (struct adftool_channel_processor *processor,
 				  bool *work_done)
 {
   int error = 0;
-  const size_t page_size =
-    sizeof (processor->cache[0]->data) /
-    sizeof (processor->cache[0]->data[0]);
+  const size_t page_size = processor->page_length;
   *work_done = false;
   if (pthread_mutex_lock (&(processor->cache_synchronizer)) != 0)
     {
       error = -2;
       goto cleanup;
     }
-  size_t n_relevant = channel_processor_reorder (processor);
-  size_t n_total = sizeof (processor->cache) / sizeof (processor->cache[0]);
-  size_t n_irrelevant = n_total - n_relevant;
+  const size_t n_to_load = channel_processor_n_pages_to_load (processor);
   const size_t first_page_to_load = processor->start_index / page_size;
   const size_t index_stop = processor->start_index + processor->window_length;
   for (size_t i = first_page_to_load;
-       i * page_size < index_stop && (i - first_page_to_load) < n_irrelevant;
+       i * page_size < index_stop && (i - first_page_to_load) < n_to_load;
        i++)
     {
-      error = channel_processor_push_page (processor, i, work_done);
+      error = channel_processor_push_page (processor, i, false, work_done);
       if (error != 0)
 	{
 	  goto unlock;
@@ -344,12 +1059,22 @@ channel_processor_free (struct adftool_channel_processor *processor)
 {
   if (processor != NULL)
     {
-      adftool_term_free (processor->channel_type);
-      adftool_fir_free (processor->filter);
-      for (size_t i = 0;
-	   i < sizeof (processor->cache) / sizeof (processor->cache[0]); i++)
+      for (size_t t = 0; t < processor->n_terms; t++)
+	{
+	  term_free (processor->channel_types[t]);
+	}
+      FREE (processor->channel_types);
+      FREE (processor->channel_indices);
+      FREE (processor->weights);
+      FREE (processor->taper);
+      FREE (processor->twiddles);
+      adftool_fir_stream_free (processor->stream);
+      adftool_fir_release (processor->filter);
+      adftool_iir_free (processor->iir);
+      page_cache_unregister (processor->page_cache, processor);
+      if (processor->owns_page_cache)
 	{
-	  FREE (processor->cache[i]);
+	  page_cache_free (processor->page_cache);
 	}
       if (pthread_mutex_destroy (&(processor->cache_synchronizer)) != 0)
 	{
@@ -360,90 +1085,243 @@ channel_processor_free (struct adftool_channel_processor *processor)
 }
 
 static struct adftool_channel_processor *
-channel_processor_alloc (struct adftool_file *file,
-			 pthread_mutex_t * file_synchronizer,
-			 const struct adftool_term *channel_type,
-			 double filter_low, double filter_high)
+channel_processor_alloc_derived (struct adftool_file *file,
+				 pthread_mutex_t * file_synchronizer,
+				 struct page_cache *page_cache,
+				 size_t page_length, size_t n_terms,
+				 const struct adftool_term *const
+				 *channel_types, const double *weights,
+				 int filter_family, double filter_low,
+				 double filter_high, size_t decimation,
+				 size_t spectrogram_window)
 {
+  /* If spectrogram_window is not 0, the processor computes a
+     spectrogram with a hop of decimation samples, in the band from
+     filter_low to filter_high, instead of filtering. The pages hold
+     as many frames as fit. */
+  const size_t page_values = page_length;
   struct adftool_channel_processor *ret;
   struct adftool_term *channel = term_alloc ();
   if (channel == NULL)
     {
       return NULL;
     }
+  if (n_terms == 0
+      || (spectrogram_window == 0 && filter_family != ADFTOOL_FILTER_FIR
+	  && filter_family != ADFTOOL_FILTER_IIR))
+    {
+      term_free (channel);
+      return NULL;
+    }
   if (ALLOC (ret) == 0)
     {
       ret->file = file;
-      ret->channel_type = term_alloc ();
-      if (ret->channel_type == NULL)
+      ret->n_terms = 0;
+      if (ALLOC_N (ret->channel_types, n_terms) < 0
+	  || ALLOC_N (ret->channel_indices, n_terms) < 0
+	  || ALLOC_N (ret->weights, n_terms) < 0)
 	{
-	  goto cleanup;
+	  goto cleanup_channel_type;
 	}
-      term_copy (ret->channel_type, channel_type);
-      size_t n_candidates =
-	adftool_find_channels_by_type (file, channel_type, 0, 1, &channel);
-      if (n_candidates != 1)
+      int error = 0;
+      /* The worker threads of the group may be reading the file. */
+      if (pthread_mutex_lock (file_synchronizer) != 0)
 	{
 	  goto cleanup_channel_type;
 	}
-      int error = adftool_get_channel_column (file, channel,
-					      &(ret->channel_index));
-      if (error != 0)
+      for (ret->n_terms = 0; ret->n_terms < n_terms; ret->n_terms++)
 	{
-	  goto cleanup_channel_type;
+	  const size_t t = ret->n_terms;
+	  size_t n_candidates =
+	    adftool_find_channels_by_type (file, channel_types[t], 0, 1,
+					   &channel);
+	  if (n_candidates != 1)
+	    {
+	      error = -1;
+	      break;
+	    }
+	  error = adftool_get_channel_column (file, channel,
+					      &(ret->channel_indices[t]));
+	  if (error != 0)
+	    {
+	      break;
+	    }
+	  ret->channel_types[t] = term_alloc ();
+	  if (ret->channel_types[t] == NULL)
+	    {
+	      error = -2;
+	      break;
+	    }
+	  term_copy (ret->channel_types[t], channel_types[t]);
+	  ret->weights[t] = weights[t];
 	}
       struct timespec start_time;
-      double sfreq;
-      error = adftool_eeg_get_time (file, 0, &start_time, &sfreq);
+      double sfreq = 0;
+      if (error == 0)
+	{
+	  error = adftool_eeg_get_time (file, 0, &start_time, &sfreq);
+	}
+      if (pthread_mutex_unlock (file_synchronizer) != 0)
+	{
+	  abort ();
+	}
       if (error != 0)
 	{
 	  goto cleanup_channel_type;
 	}
-      double trans_low, trans_high, smallest_trans;
-      adftool_fir_auto_bandwidth (sfreq, filter_low, filter_high, &trans_low,
-				  &trans_high);
-      smallest_trans = trans_low;
-      if (trans_high < trans_low)
+      if (decimation == 0)
 	{
-	  smallest_trans = trans_high;
+	  decimation = 1;
 	}
-      size_t order = adftool_fir_auto_order (sfreq, smallest_trans);
-      ret->filter = adftool_fir_alloc (order);
-      if (ret->filter == NULL)
+      /* The decimated signal must not alias: the pass band stops
+         before its Nyquist frequency, with room for the transition
+         band. */
+      double design_high = filter_high;
+      if (design_high > 0.4 * sfreq / decimation)
 	{
-	  goto cleanup_channel_type;
+	  design_high = 0.4 * sfreq / decimation;
+	}
+      ret->filter_family = filter_family;
+      ret->iir = NULL;
+      ret->filter = NULL;
+      ret->stream = NULL;
+      ret->spectrogram_window = spectrogram_window;
+      ret->n_bins = 1;
+      ret->first_bin = 0;
+      ret->fft_size = 0;
+      ret->taper = NULL;
+      ret->twiddles = NULL;
+      ret->power_scale = 0;
+      if (spectrogram_window != 0)
+	{
+	  ret->filter_family = CHANNEL_PROCESSOR_SPECTROGRAM;
+	  ret->n_bins =
+	    channel_processor_spectrogram_bins (sfreq, spectrogram_window,
+						filter_low, filter_high,
+						&(ret->fft_size),
+						&(ret->first_bin));
+	  if (ret->n_bins == 0 || ret->n_bins > page_length
+	      || ALLOC_N (ret->taper, spectrogram_window) < 0
+	      || ALLOC_N (ret->twiddles, ret->fft_size) < 0)
+	    {
+	      goto cleanup_channel_type;
+	    }
+	  page_length /= ret->n_bins;
+	  /* A periodic Hann window. */
+	  double taper_power = 0;
+	  for (size_t i = 0; i < spectrogram_window; i++)
+	    {
+	      ret->taper[i] =
+		0.5 - 0.5 * cos (2 * M_PI * i / spectrogram_window);
+	      taper_power += ret->taper[i] * ret->taper[i];
+	    }
+	  ret->power_scale = 1 / (sfreq * taper_power);
+	  fft_twiddles (ret->fft_size, ret->twiddles);
+	}
+      else if (filter_family == ADFTOOL_FILTER_IIR)
+	{
+	  ret->iir = adftool_iir_alloc (CHANNEL_PROCESSOR_IIR_ORDER);
+	  if (ret->iir == NULL)
+	    {
+	      goto cleanup_channel_type;
+	    }
+	  adftool_iir_design_bandpass (ret->iir, sfreq, filter_low,
+				       design_high);
 	}
-      adftool_fir_design_bandpass (ret->filter, sfreq, filter_low,
-				   filter_high, trans_low, trans_high);
+      else
+	{
+	  double trans_low, trans_high;
+	  adftool_fir_auto_bandwidth (sfreq, filter_low, design_high,
+				      &trans_low, &trans_high);
+	  ret->filter =
+	    adftool_fir_acquire (sfreq, filter_low, design_high, trans_low,
+				 trans_high);
+	  if (ret->filter == NULL)
+	    {
+	      goto cleanup_channel_type;
+	    }
+	  ret->stream =
+	    adftool_fir_stream_alloc_decimated (ret->filter, decimation);
+	  if (ret->stream == NULL)
+	    {
+	      goto cleanup_filter;
+	    }
+	}
+      ret->stream_next_page = SIZE_MAX;
       ret->filter_low = filter_low;
       ret->filter_high = filter_high;
+      ret->decimation = decimation;
       ret->file_synchronizer = file_synchronizer;
-      for (size_t i = 0; i < sizeof (ret->cache) / sizeof (ret->cache[0]);
-	   i++)
+      ret->page_cache = page_cache;
+      ret->owns_page_cache = (page_cache == NULL);
+      ret->page_length = page_length;
+      if (ret->owns_page_cache)
 	{
-	  ret->cache[i] = NULL;
+	  const size_t page_bytes = channel_processor_page_bytes (page_values);
+	  ret->page_cache =
+	    page_cache_alloc (page_bytes,
+			      CHANNEL_PROCESSOR_DEFAULT_PAGES * page_bytes);
+	  if (ret->page_cache == NULL)
+	    {
+	      goto cleanup_stream;
+	    }
 	}
       ret->start_index = 0;
-      ret->window_length = 5120;
+      ret->window_length = page_length;
+      ret->scrolls_backward = false;
       ret->time_max = 0;
+      ret->n_users = 0;
+      ret->dropped = false;
       error = pthread_mutex_init (&(ret->cache_synchronizer), NULL);
       if (error != 0)
 	{
-	  goto cleanup_filter;
+	  goto cleanup_page_cache;
 	}
+      page_cache_register (ret->page_cache);
     }
   term_free (channel);
   return ret;
+cleanup_page_cache:
+  if (ret->owns_page_cache)
+    {
+      page_cache_free (ret->page_cache);
+    }
+cleanup_stream:
+  adftool_fir_stream_free (ret->stream);
 cleanup_filter:
-  adftool_fir_free (ret->filter);
+  adftool_fir_release (ret->filter);
+  adftool_iir_free (ret->iir);
 cleanup_channel_type:
-  term_free (ret->channel_type);
-cleanup:
+  FREE (ret->twiddles);
+  FREE (ret->taper);
+  for (size_t t = 0; t < ret->n_terms; t++)
+    {
+      term_free (ret->channel_types[t]);
+    }
+  FREE (ret->channel_types);
+  FREE (ret->channel_indices);
+  FREE (ret->weights);
   FREE (ret);
   term_free (channel);
   return NULL;
 }
 
+static struct adftool_channel_processor *
+channel_processor_alloc (struct adftool_file *file,
+			 pthread_mutex_t * file_synchronizer,
+			 struct page_cache *page_cache, size_t page_length,
+			 const struct adftool_term *channel_type,
+			 int filter_family, double filter_low,
+			 double filter_high, size_t decimation)
+{
+  static const double weight = 1;
+  return channel_processor_alloc_derived (file, file_synchronizer,
+					  page_cache, page_length, 1,
+					  &channel_type, &weight,
+					  filter_family, filter_low,
+					  filter_high, decimation, 0);
+}
+
 static int
 channel_processor_get (struct adftool_channel_processor *processor,
 		       size_t start_index,
@@ -452,7 +1330,7 @@ channel_processor_get (struct adftool_channel_processor *processor,
 		       size_t *nearest_length, double *data)
 {
   int error = 0;
-  for (size_t i = 0; i < length; i++)
+  for (size_t i = 0; i < length * processor->n_bins; i++)
     {
       data[i] = NAN;
     }
@@ -462,16 +1340,19 @@ channel_processor_get (struct adftool_channel_processor *processor,
       error = -2;
       goto cleanup;
     }
-  if (processor->time_max == 0)
+  const size_t time_max =
+    (processor->time_max + processor->decimation - 1)
+    / processor->decimation;
+  if (time_max == 0)
     {
       /* Assume we do not know the maximum time index yet. */
     }
   else
     {
       size_t stop_index = start_index + length;
-      if (stop_index > processor->time_max)
+      if (stop_index > time_max)
 	{
-	  size_t back = stop_index - processor->time_max;
+	  size_t back = stop_index - time_max;
 	  if (start_index >= back)
 	    {
 	      start_index -= back;
@@ -483,26 +1364,44 @@ channel_processor_get (struct adftool_channel_processor *processor,
 	      back -= start_index;
 	      start_index = 0;
 	      /* Then, shrink the window. */
-	      length = processor->time_max;
+	      length = time_max;
 	    }
 	  stop_index = start_index + length;
 	}
-      assert (stop_index <= processor->time_max);
+      assert (stop_index <= time_max);
     }
   *nearest_start = start_index;
   *nearest_length = length;
+  if (start_index != processor->start_index)
+    {
+      processor->scrolls_backward = (start_index < processor->start_index);
+    }
   processor->start_index = start_index;
   processor->window_length = length;
-  const size_t n_pages =
-    sizeof (processor->cache) / sizeof (processor->cache[0]);
-  for (size_t i = 0; i < n_pages; i++)
+  const size_t page_size = processor->page_length;
+  const size_t n_bins = processor->n_bins;
+  struct adftool_channel_processor_page *page =
+    channel_processor_page_alloc (processor->page_cache);
+  int16_t *unpacked = NULL;
+  if (page == NULL || ALLOC_N (unpacked, page_size * n_bins) < 0)
+    {
+      FREE (page);
+      error = -2;
+      goto unlock;
+    }
+  for (size_t index = start_index / page_size;
+       index * page_size < start_index + length; index++)
     {
-      const struct adftool_channel_processor_page *page = processor->cache[i];
-      if (page != NULL
-	  && channel_processor_page_is_relevant (processor, page))
+      if (page_cache_read (processor->page_cache, processor, index, page))
 	{
-	  const size_t page_size =
-	    sizeof (page->data) / sizeof (page->data[0]);
+	  const int16_t *values = page->data;
+	  if (page->packed_length != 0)
+	    {
+	      channel_processor_unpack (page_size * n_bins,
+					(const uint8_t *) page->data,
+					unpacked);
+	      values = unpacked;
+	    }
 	  const size_t page_start = page->index * page_size;
 	  for (size_t i = 0; i < page_size; i++)
 	    {
@@ -510,13 +1409,19 @@ channel_processor_get (struct adftool_channel_processor *processor,
 	      if (index_abs >= start_index
 		  && index_abs - start_index < length)
 		{
-		  data[index_abs - start_index] = page->data[i] * page->scale;
+		  for (size_t b = 0; b < n_bins; b++)
+		    {
+		      data[(index_abs - start_index) * n_bins + b] =
+			values[i * n_bins + b] * page->scale;
+		    }
 		}
 	    }
 	}
     }
-  error = pthread_mutex_unlock (&(processor->cache_synchronizer));
-  if (error != 0)
+  FREE (unpacked);
+  FREE (page);
+unlock:
+  if (pthread_mutex_unlock (&(processor->cache_synchronizer)) != 0)
     {
       abort ();
     }
@@ -524,15 +1429,55 @@ cleanup:
   return error;
 }
 
+static inline bool
+channel_processor_shares_filter (const struct adftool_channel_processor *a,
+				 const struct adftool_channel_processor *b)
+{
+  return (a->filter != NULL && a->filter == b->filter
+	  && a->decimation == b->decimation);
+}
+
 static bool
 channel_processor_can_serve (const struct adftool_channel_processor
 			     *processor,
 			     const struct adftool_term *channel_type,
-			     double filter_low, double filter_high)
+			     int filter_family, double filter_low,
+			     double filter_high, size_t decimation)
+{
+  static const double weight = 1;
+  return channel_processor_can_serve_derived (processor, 1, &channel_type,
+					      &weight, filter_family,
+					      filter_low, filter_high,
+					      decimation, 0);
+}
+
+static bool
+channel_processor_can_serve_derived (const struct adftool_channel_processor
+				     *processor, size_t n_terms,
+				     const struct adftool_term *const
+				     *channel_types, const double *weights,
+				     int filter_family, double filter_low,
+				     double filter_high, size_t decimation,
+				     size_t spectrogram_window)
 {
-  return (filter_low == processor->filter_low
-	  && filter_high == processor->filter_high
-	  && term_compare (processor->channel_type, channel_type) == 0);
+  if (filter_family != processor->filter_family
+      || filter_low != processor->filter_low
+      || filter_high != processor->filter_high
+      || decimation != processor->decimation
+      || spectrogram_window != processor->spectrogram_window
+      || n_terms != processor->n_terms)
+    {
+      return false;
+    }
+  for (size_t t = 0; t < n_terms; t++)
+    {
+      if (weights[t] != processor->weights[t]
+	  || term_compare (processor->channel_types[t], channel_types[t]) != 0)
+	{
+	  return false;
+	}
+    }
+  return true;
 }
 
 #endif /* not H_ADFTOOL_CHANNEL_PROCESSOR_INCLUDED */
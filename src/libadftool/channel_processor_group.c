@@ -3,6 +3,7 @@
 #include <adftool.h>
 #include <time.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "channel_processor_group.h"
 
 void
@@ -18,7 +19,20 @@ adftool_channel_processor_group_alloc (struct adftool_file *file,
 				       size_t max_active_channels)
 {
   return channel_processor_group_alloc (file, file_synchronizer,
-					max_active_channels);
+					max_active_channels, 0, 0);
+}
+
+struct adftool_channel_processor_group *
+adftool_channel_processor_group_alloc_with_cache (struct adftool_file *file,
+						  pthread_mutex_t *
+						  file_synchronizer,
+						  size_t max_active_channels,
+						  size_t page_length,
+						  size_t cache_budget)
+{
+  return channel_processor_group_alloc (file, file_synchronizer,
+					max_active_channels, page_length,
+					cache_budget);
 }
 
 int
@@ -30,11 +44,135 @@ adftool_channel_processor_group_get (struct adftool_channel_processor_group
 				     size_t *nearest_start,
 				     size_t *nearest_length, double *data)
 {
-  return channel_processor_group_get (group, channel_type, filter_low,
-				      filter_high, start_index, length,
+  return channel_processor_group_get (group, channel_type,
+				      ADFTOOL_FILTER_FIR, filter_low,
+				      filter_high, 1, start_index, length,
 				      nearest_start, nearest_length, data);
 }
 
+void
+adftool_channel_processor_group_set_notification (struct
+						  adftool_channel_processor_group
+						  *group,
+						  void (*notify) (void *),
+						  void *context)
+{
+  channel_processor_group_set_notification (group, notify, context);
+}
+
+void
+adftool_channel_processor_group_set_page_compression (struct
+						      adftool_channel_processor_group
+						      *group, int compress)
+{
+  channel_processor_group_set_page_packing (group, compress != 0);
+}
+
+int
+adftool_channel_processor_group_start_workers (struct
+					       adftool_channel_processor_group
+					       *group, size_t n_workers)
+{
+  if (n_workers == 0)
+    {
+      const long n_cores = sysconf (_SC_NPROCESSORS_ONLN);
+      n_workers = (n_cores > 0 ? n_cores : 1);
+    }
+  return channel_processor_group_start_workers (group, n_workers);
+}
+
+int
+adftool_channel_processor_group_get_derived (struct
+					     adftool_channel_processor_group
+					     *group, size_t n_terms,
+					     const struct adftool_term *const
+					     *channel_types,
+					     const double *weights,
+					     int filter_family,
+					     double filter_low,
+					     double filter_high,
+					     size_t decimation,
+					     size_t start_index, size_t length,
+					     size_t *nearest_start,
+					     size_t *nearest_length,
+					     double *data)
+{
+  return channel_processor_group_get_derived (group, n_terms, channel_types,
+					      weights, filter_family,
+					      filter_low, filter_high,
+					      decimation, start_index, length,
+					      nearest_start, nearest_length,
+					      data);
+}
+
+size_t
+adftool_channel_processor_group_spectrogram_bins (struct
+						  adftool_channel_processor_group
+						  *group,
+						  size_t window_length,
+						  double freq_low,
+						  double freq_high,
+						  double *first_frequency,
+						  double *bin_width)
+{
+  /* The first bin is at first_frequency, and the next ones every
+     bin_width. */
+  struct timespec start_time;
+  double sfreq;
+  *first_frequency = 0;
+  *bin_width = 0;
+  if (window_length == 0)
+    {
+      return 0;
+    }
+  if (pthread_mutex_lock (group->file_synchronizer) != 0)
+    {
+      abort ();
+    }
+  const int error =
+    adftool_eeg_get_time (group->file, 0, &start_time, &sfreq);
+  if (pthread_mutex_unlock (group->file_synchronizer) != 0)
+    {
+      abort ();
+    }
+  if (error != 0)
+    {
+      return 0;
+    }
+  size_t fft_size, first_bin;
+  const size_t n_bins =
+    channel_processor_spectrogram_bins (sfreq, window_length, freq_low,
+					freq_high, &fft_size, &first_bin);
+  *bin_width = sfreq / fft_size;
+  *first_frequency = first_bin * *bin_width;
+  return n_bins;
+}
+
+int
+adftool_channel_processor_group_get_spectrogram (struct
+						 adftool_channel_processor_group
+						 *group, size_t n_terms,
+						 const struct adftool_term
+						 *const *channel_types,
+						 const double *weights,
+						 size_t window_length,
+						 size_t hop, double freq_low,
+						 double freq_high,
+						 size_t start_frame,
+						 size_t n_frames,
+						 size_t *nearest_start,
+						 size_t *nearest_length,
+						 double *power)
+{
+  return channel_processor_group_get_spectrogram (group, n_terms,
+						  channel_types, weights,
+						  window_length, hop,
+						  freq_low, freq_high,
+						  start_frame, n_frames,
+						  nearest_start,
+						  nearest_length, power);
+}
+
 int
 adftool_channel_processor_group_populate_cache (struct
 						adftool_channel_processor_group
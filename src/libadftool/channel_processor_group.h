@@ -40,25 +40,73 @@ MAYBE_UNUSED DEALLOC_CHANNEL_PROCESSOR_GROUP
   static struct adftool_channel_processor_group
   *channel_processor_group_alloc (struct adftool_file *file,
 				  pthread_mutex_t * file_synchronizer,
-				  size_t max_active_channels);
+				  size_t max_active_channels,
+				  size_t page_length, size_t cache_budget);
 
 MAYBE_UNUSED
   static int channel_processor_group_get (struct
 					  adftool_channel_processor_group
 					  *group,
 					  const struct adftool_term
-					  *channel_type, double filter_low,
+					  *channel_type, int filter_family,
+					  double filter_low,
 					  double filter_high,
+					  size_t decimation,
 					  size_t start_index, size_t length,
 					  size_t *nearest_start,
 					  size_t *nearest_length,
 					  double *data);
 
+MAYBE_UNUSED
+  static int
+channel_processor_group_get_derived (struct adftool_channel_processor_group
+				     *group, size_t n_terms,
+				     const struct adftool_term *const
+				     *channel_types, const double *weights,
+				     int filter_family, double filter_low,
+				     double filter_high, size_t decimation,
+				     size_t start_index, size_t length,
+				     size_t *nearest_start,
+				     size_t *nearest_length, double *data);
+
+MAYBE_UNUSED
+  static int
+channel_processor_group_get_spectrogram (struct
+					 adftool_channel_processor_group
+					 *group, size_t n_terms,
+					 const struct adftool_term *const
+					 *channel_types,
+					 const double *weights,
+					 size_t window_length, size_t hop,
+					 double freq_low, double freq_high,
+					 size_t start_frame, size_t n_frames,
+					 size_t *nearest_start,
+					 size_t *nearest_length,
+					 double *power);
+
 MAYBE_UNUSED
   static int
 channel_processor_group_populate_cache (struct adftool_channel_processor_group
 					*group, bool *work_done);
 
+MAYBE_UNUSED
+  static void
+channel_processor_group_set_notification (struct
+					  adftool_channel_processor_group
+					  *group, void (*notify) (void *),
+					  void *context);
+
+MAYBE_UNUSED
+  static int
+channel_processor_group_start_workers (struct adftool_channel_processor_group
+				       *group, size_t n_workers);
+
+MAYBE_UNUSED
+  static void
+channel_processor_group_set_page_packing (struct
+					  adftool_channel_processor_group
+					  *group, bool pack_pages);
+
 # include "channel_processor.h"
 
 struct adftool_channel_processor_group
@@ -69,14 +117,63 @@ struct adftool_channel_processor_group
   size_t n_active_channels;
   size_t max_active_channels;
   struct adftool_channel_processor **active_channels;
-  size_t next_to_populate;
+  /* The number of samples in each page, the same for all the
+     processors. */
+  size_t page_length;
+  /* The pages of all the processors. If pack_pages, the new pages
+     are packed in the cache, and unpacked when they are read. */
+  struct page_cache *page_cache;
+  bool pack_pages;
+  /* The workers wait on work_available, with the channel list lock,
+     until the generation changes, that is, until a window moves. */
+  pthread_cond_t work_available;
+  size_t generation;
+  bool stopping;
+  size_t n_workers;
+  pthread_t *workers;
+  /* Called, without any lock, when a visible page has been filled. It
+     is protected by the channel list lock. */
+  void (*notify) (void *);
+  void *notify_context;
 };
 
 static struct adftool_channel_processor_group *
 channel_processor_group_alloc (struct adftool_file *file,
 			       pthread_mutex_t * file_synchronizer,
-			       size_t max_active_channels)
+			       size_t max_active_channels,
+			       size_t page_length, size_t cache_budget)
 {
+  /* If cache_budget is 0, each channel can keep the default number
+     of pages. The sizes are checked before anything is allocated. */
+  if (page_length == 0)
+    {
+      page_length = CHANNEL_PROCESSOR_DEFAULT_PAGE_LENGTH;
+    }
+  if (page_length > (SIZE_MAX - sizeof (struct adftool_channel_processor_page))
+      / sizeof (int16_t))
+    {
+      return NULL;
+    }
+  const size_t page_bytes = channel_processor_page_bytes (page_length);
+  if (max_active_channels > SIZE_MAX / page_bytes)
+    {
+      return NULL;
+    }
+  const size_t min_budget = max_active_channels * page_bytes;
+  if (cache_budget == 0)
+    {
+      if (min_budget > SIZE_MAX / CHANNEL_PROCESSOR_DEFAULT_PAGES)
+	{
+	  return NULL;
+	}
+      cache_budget = CHANNEL_PROCESSOR_DEFAULT_PAGES * min_budget;
+    }
+  /* Each processor must be able to keep at least one page, otherwise
+     they would evict each other forever. */
+  if (cache_budget < min_budget)
+    {
+      cache_budget = min_budget;
+    }
   int error = 0;
   struct adftool_channel_processor_group *ret = NULL;
   ensure_init ();
@@ -93,6 +190,19 @@ channel_processor_group_alloc (struct adftool_file *file,
       error = -2;
       goto cleanup;
     }
+  error = pthread_cond_init (&(ret->work_available), NULL);
+  if (error != 0)
+    {
+      error = -2;
+      goto cleanup;
+    }
+  ret->generation = 0;
+  ret->stopping = false;
+  ret->n_workers = 0;
+  ret->workers = NULL;
+  ret->notify = NULL;
+  ret->notify_context = NULL;
+  ret->pack_pages = false;
   ret->n_active_channels = 0;
   ret->max_active_channels = max_active_channels;
   if (ALLOC_N (ret->active_channels, max_active_channels) < 0)
@@ -100,7 +210,13 @@ channel_processor_group_alloc (struct adftool_file *file,
       error = -2;
       goto cleanup;
     }
-  ret->next_to_populate = 0;
+  ret->page_length = page_length;
+  ret->page_cache = page_cache_alloc (page_bytes, cache_budget);
+  if (ret->page_cache == NULL)
+    {
+      error = -2;
+      goto cleanup;
+    }
 cleanup:
   if (error != 0)
     {
@@ -110,154 +226,648 @@ cleanup:
   return ret;
 }
 
+static void
+channel_processor_group_stop_workers (struct adftool_channel_processor_group
+				      *group);
+
 static void
 channel_processor_group_free (struct adftool_channel_processor_group *group)
 {
+  if (group->workers != NULL)
+    {
+      channel_processor_group_stop_workers (group);
+    }
   for (size_t i = 0; i < group->n_active_channels; i++)
     {
       channel_processor_free (group->active_channels[i]);
       group->active_channels[i] = NULL;
     }
   FREE (group->active_channels);
-  if (pthread_mutex_destroy (&(group->channel_list_synchronizer)) != 0)
+  page_cache_free (group->page_cache);
+  if (pthread_mutex_destroy (&(group->channel_list_synchronizer)) != 0
+      || pthread_cond_destroy (&(group->work_available)) != 0)
     {
       abort ();
     }
   FREE (group);
 }
 
+static inline void
+channel_processor_group_wake (struct adftool_channel_processor_group *group)
+{
+  /* The channel list must be locked. */
+  group->generation += 1;
+  if (pthread_cond_broadcast (&(group->work_available)) != 0)
+    {
+      abort ();
+    }
+}
+
+static inline void
+channel_processor_group_drop (struct adftool_channel_processor *processor)
+{
+  /* The channel list must be locked, and the processor removed from
+     it. */
+  if (processor->n_users == 0)
+    {
+      channel_processor_free (processor);
+    }
+  else
+    {
+      processor->dropped = true;
+    }
+}
+
+static void
+channel_processor_group_release (struct adftool_channel_processor_group
+				 *group,
+				 struct adftool_channel_processor *processor)
+{
+  /* The processor has been obtained with find_task, find_batch or
+     populate_cache, and is not used by this thread anymore. */
+  if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+  assert (processor->n_users > 0);
+  processor->n_users -= 1;
+  if (processor->dropped && processor->n_users == 0)
+    {
+      channel_processor_free (processor);
+    }
+  if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+}
+
 static int
 channel_processor_group_find_task (struct adftool_channel_processor_group
-				   *group,
-				   const struct adftool_term *channel_type,
-				   double filter_low, double filter_high,
+				   *group, size_t n_terms,
+				   const struct adftool_term *const
+				   *channel_types, const double *weights,
+				   int filter_family, double filter_low,
+				   double filter_high, size_t decimation,
+				   size_t spectrogram_window,
 				   struct adftool_channel_processor **task)
 {
   /* Find the task in the queue and bring it to front, or allocate one
      and push it at the front if no task has been allocated for that
-     triple (channel_type, filter_low, filter_high). */
+     tuple (channel_types, weights, filter_family, filter_low,
+     filter_high, decimation, spectrogram_window). The task must be
+     released. The new task reads the file and designs its filter
+     without holding the channel list, so that the workers can go
+     on. */
   int error = 0;
+  struct adftool_channel_processor *new_task = NULL;
   if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
     {
       error = -1;
       goto cleanup;
     }
   size_t i = 0;
-  for (i = 0;
-       (i < group->n_active_channels)
-       && (!channel_processor_can_serve (group->active_channels[i],
-					 channel_type, filter_low,
-					 filter_high)); i++)
-    ;
-  if (i == group->n_active_channels)
+  while (true)
     {
-      struct adftool_channel_processor *new_task =
-	channel_processor_alloc (group->file, group->file_synchronizer,
-				 channel_type, filter_low, filter_high);
+      for (i = 0;
+	   (i < group->n_active_channels)
+	   && (!channel_processor_can_serve_derived (group->active_channels
+						     [i], n_terms,
+						     channel_types, weights,
+						     filter_family,
+						     filter_low, filter_high,
+						     decimation,
+						     spectrogram_window));
+	   i++)
+	;
+      if (i < group->n_active_channels || new_task != NULL)
+	{
+	  break;
+	}
+      if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+	{
+	  error = -1;
+	  goto cleanup;
+	}
+      new_task =
+	channel_processor_alloc_derived (group->file,
+					 group->file_synchronizer,
+					 group->page_cache,
+					 group->page_length, n_terms,
+					 channel_types, weights,
+					 filter_family, filter_low,
+					 filter_high, decimation,
+					 spectrogram_window);
       if (new_task == NULL)
 	{
 	  error = -2;
-	  goto unlock;
+	  goto cleanup;
+	}
+      /* Another thread may have allocated the same task in the
+         meantime. */
+      if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+	{
+	  error = -1;
+	  goto cleanup;
 	}
+    }
+  if (i == group->n_active_channels)
+    {
       if (i >= group->max_active_channels)
 	{
 	  /* Drop the last one. */
 	  assert (group->max_active_channels != 0);
-	  channel_processor_free (group->active_channels
-				  [group->max_active_channels - 1]);
+	  channel_processor_group_drop (group->active_channels
+					[group->max_active_channels - 1]);
 	  group->n_active_channels -= 1;
 	  i = group->n_active_channels;
 	}
       assert (i < group->max_active_channels);
       group->n_active_channels += 1;
       group->active_channels[i] = new_task;
+      new_task = NULL;
+      /* The new task has its first window to fill. */
+      channel_processor_group_wake (group);
     }
   *task = group->active_channels[i];
+  (*task)->n_users += 1;
   for (size_t j = i; j-- > 0;)
     {
       group->active_channels[j + 1] = group->active_channels[j];
     }
   group->active_channels[0] = *task;
-unlock:
   if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
     {
       error = -1;
       goto cleanup;
     }
 cleanup:
+  if (new_task != NULL)
+    {
+      /* Nobody else knows about it. */
+      channel_processor_free (new_task);
+    }
   return error;
 }
 
 static int
 channel_processor_group_get (struct adftool_channel_processor_group *group,
 			     const struct adftool_term *channel_type,
+			     int filter_family,
 			     double filter_low,
 			     double filter_high,
+			     size_t decimation,
 			     size_t start_index,
 			     size_t length,
 			     size_t *nearest_start,
 			     size_t *nearest_length, double *data)
+{
+  static const double weight = 1;
+  return channel_processor_group_get_derived (group, 1, &channel_type,
+					      &weight, filter_family,
+					      filter_low, filter_high,
+					      decimation, start_index, length,
+					      nearest_start, nearest_length,
+					      data);
+}
+
+static int
+channel_processor_group_get_processed (struct adftool_channel_processor_group
+				       *group, size_t n_terms,
+				       const struct adftool_term *const
+				       *channel_types, const double *weights,
+				       int filter_family, double filter_low,
+				       double filter_high, size_t decimation,
+				       size_t spectrogram_window,
+				       size_t start_index, size_t length,
+				       size_t *nearest_start,
+				       size_t *nearest_length, double *data)
 {
   struct adftool_channel_processor *task = NULL;
   int error =
-    channel_processor_group_find_task (group, channel_type, filter_low,
-				       filter_high, &task);
+    channel_processor_group_find_task (group, n_terms, channel_types,
+				       weights, filter_family, filter_low,
+				       filter_high, decimation,
+				       spectrogram_window, &task);
   if (error != 0)
     {
       return error;
     }
-  return channel_processor_get (task, start_index, length, nearest_start,
-				nearest_length, data);
+  if (pthread_mutex_lock (&(task->cache_synchronizer)) != 0)
+    {
+      abort ();
+    }
+  const size_t previous_start = task->start_index;
+  const size_t previous_length = task->window_length;
+  if (pthread_mutex_unlock (&(task->cache_synchronizer)) != 0)
+    {
+      abort ();
+    }
+  error =
+    channel_processor_get (task, start_index, length, nearest_start,
+			   nearest_length, data);
+  if (error == 0
+      && (*nearest_start != previous_start
+	  || *nearest_length != previous_length))
+    {
+      if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+	{
+	  abort ();
+	}
+      channel_processor_group_wake (group);
+      if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+	{
+	  abort ();
+	}
+    }
+  channel_processor_group_release (group, task);
+  return error;
 }
 
 static int
-channel_processor_group_populate_cache (struct adftool_channel_processor_group
-					*group, bool *work_done)
+channel_processor_group_get_derived (struct adftool_channel_processor_group
+				     *group, size_t n_terms,
+				     const struct adftool_term *const
+				     *channel_types, const double *weights,
+				     int filter_family, double filter_low,
+				     double filter_high, size_t decimation,
+				     size_t start_index, size_t length,
+				     size_t *nearest_start,
+				     size_t *nearest_length, double *data)
+{
+  if (filter_family != ADFTOOL_FILTER_FIR
+      && filter_family != ADFTOOL_FILTER_IIR)
+    {
+      return -1;
+    }
+  /* The processors store a decimation of 0 as 1, so it must be
+     normalized before looking for one. */
+  if (decimation == 0)
+    {
+      decimation = 1;
+    }
+  return channel_processor_group_get_processed (group, n_terms,
+						channel_types, weights,
+						filter_family, filter_low,
+						filter_high, decimation, 0,
+						start_index, length,
+						nearest_start, nearest_length,
+						data);
+}
+
+static int
+channel_processor_group_get_spectrogram (struct
+					 adftool_channel_processor_group
+					 *group, size_t n_terms,
+					 const struct adftool_term *const
+					 *channel_types,
+					 const double *weights,
+					 size_t window_length, size_t hop,
+					 double freq_low, double freq_high,
+					 size_t start_frame, size_t n_frames,
+					 size_t *nearest_start,
+					 size_t *nearest_length,
+					 double *power)
+{
+  /* Without a hop, the frames do not overlap. */
+  if (window_length == 0)
+    {
+      return -1;
+    }
+  if (hop == 0)
+    {
+      hop = window_length;
+    }
+  return channel_processor_group_get_processed (group, n_terms,
+						channel_types, weights,
+						CHANNEL_PROCESSOR_SPECTROGRAM,
+						freq_low, freq_high, hop,
+						window_length, start_frame,
+						n_frames, nearest_start,
+						nearest_length, power);
+}
+
+/* The maximum number of channels filtered at once. */
+# define CHANNEL_PROCESSOR_GROUP_MAX_BATCH 64
+
+static int
+channel_processor_group_find_batch (struct adftool_channel_processor_group
+				    *group, size_t page_index,
+				    size_t *n_batch,
+				    struct adftool_channel_processor **batch)
+{
+  /* batch[0] is locked. Add the other processors that share its
+     filter and want the page, if their cache is not busy, and lock
+     them. They must be unlocked and released. */
+  int error = 0;
+  if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+    {
+      error = -2;
+      goto cleanup;
+    }
+  for (size_t i = 0;
+       i < group->n_active_channels
+       && *n_batch < CHANNEL_PROCESSOR_GROUP_MAX_BATCH; i++)
+    {
+      struct adftool_channel_processor *candidate = group->active_channels[i];
+      if (candidate == batch[0]
+	  || !channel_processor_shares_filter (candidate, batch[0])
+	  || pthread_mutex_trylock (&(candidate->cache_synchronizer)) != 0)
+	{
+	  continue;
+	}
+      if (channel_processor_wants_page (candidate, page_index)
+	  && !channel_processor_has_page (candidate, page_index))
+	{
+	  candidate->n_users += 1;
+	  batch[(*n_batch)++] = candidate;
+	}
+      else if (pthread_mutex_unlock (&(candidate->cache_synchronizer)) != 0)
+	{
+	  abort ();
+	}
+    }
+  if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+cleanup:
+  return error;
+}
+
+static int
+channel_processor_group_populate (struct adftool_channel_processor_group
+				  *group,
+				  struct adftool_channel_processor *processor,
+				  bool prefetch, bool pack, bool *work_done)
 {
-  /* Try and populate each element in the queue, until one has done
-     work. */
+  /* processor is locked. Filter the first visible page that it
+     misses, or the first page to prefetch, along with the other
+     channels that want it. */
   int error = 0;
-  size_t n_tried = 0, n_max = 42;
+  struct adftool_channel_processor *batch[CHANNEL_PROCESSOR_GROUP_MAX_BATCH];
   *work_done = false;
-  do
+  size_t first_visible, n_visible, n_prefetch;
+  channel_processor_wanted_pages (processor, &first_visible, &n_visible,
+				  &n_prefetch);
+  const size_t rank_start = (prefetch ? n_visible : 0);
+  const size_t rank_stop = (prefetch ? n_visible + n_prefetch : n_visible);
+  for (size_t rank = rank_start; rank < rank_stop && !(*work_done); rank++)
     {
-      if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+      const size_t i =
+	channel_processor_wanted_page (processor, first_visible, n_visible,
+				       rank);
+      if (channel_processor_has_page (processor, i))
 	{
-	  error = -2;
-	  goto cleanup;
+	  continue;
 	}
-      n_max = group->n_active_channels;
-      struct adftool_channel_processor *next = NULL;
-      if (group->n_active_channels != 0)
+      size_t n_batch = 1;
+      batch[0] = processor;
+      error = channel_processor_group_find_batch (group, i, &n_batch, batch);
+      if (error == 0 && n_batch > 1)
 	{
-	  if (group->next_to_populate >= group->n_active_channels)
+	  error =
+	    channel_processor_push_pages (n_batch, batch, i, pack,
+					  work_done);
+	}
+      for (size_t k = 1; k < n_batch; k++)
+	{
+	  if (pthread_mutex_unlock (&(batch[k]->cache_synchronizer)) != 0)
 	    {
-	      group->next_to_populate = 0;
+	      abort ();
 	    }
-	  next = group->active_channels[group->next_to_populate];
-	  group->next_to_populate += 1;
+	  channel_processor_group_release (group, batch[k]);
 	}
-      if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+      if (error == 0)
 	{
-	  error = -2;
-	  goto cleanup;
+	  /* If the page has been filtered in a batch, this does
+	     nothing. */
+	  error =
+	    channel_processor_push_page (processor, i, pack, work_done);
 	}
-      if (n_max != 0)
+      if (error != 0)
 	{
-	  assert (next != NULL);
-	  error = channel_processor_populate_cache (next, work_done);
+	  break;
+	}
+    }
+  return error;
+}
+
+static int
+channel_processor_group_populate_cache (struct adftool_channel_processor_group
+					*group, bool *work_done)
+{
+  /* Filter one page: the visible pages of all the processors come
+     first, most recently requested first, then the pages to
+     prefetch. Since the windows are checked again for each page, the
+     windows that have been left are not filled anymore. The processors
+     that are busy are skipped. */
+  int error = 0;
+  bool filled_visible = false;
+  *work_done = false;
+  for (int prefetch = 0; prefetch <= 1 && !(*work_done); prefetch++)
+    {
+      for (size_t i = 0; !(*work_done); i++)
+	{
+	  if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+	    {
+	      error = -2;
+	      goto cleanup;
+	    }
+	  struct adftool_channel_processor *next = NULL;
+	  const bool pack = group->pack_pages;
+	  if (i < group->n_active_channels)
+	    {
+	      next = group->active_channels[i];
+	      next->n_users += 1;
+	    }
+	  if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+	    {
+	      abort ();
+	    }
+	  if (next == NULL)
+	    {
+	      break;
+	    }
+	  if (pthread_mutex_trylock (&(next->cache_synchronizer)) == 0)
+	    {
+	      error =
+		channel_processor_group_populate (group, next, prefetch, pack,
+						  work_done);
+	      filled_visible = (*work_done && !prefetch);
+	      if (pthread_mutex_unlock (&(next->cache_synchronizer)) != 0)
+		{
+		  abort ();
+		}
+	    }
+	  channel_processor_group_release (group, next);
 	  if (error != 0)
 	    {
 	      goto cleanup;
 	    }
-	  n_tried++;
 	}
-      else
+    }
+  if (filled_visible)
+    {
+      if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+	{
+	  abort ();
+	}
+      void (*notify) (void *) = group->notify;
+      void *notify_context = group->notify_context;
+      if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+	{
+	  abort ();
+	}
+      if (notify != NULL)
+	{
+	  notify (notify_context);
+	}
+    }
+cleanup:
+  return error;
+}
+
+static void
+channel_processor_group_set_notification (struct
+					  adftool_channel_processor_group
+					  *group, void (*notify) (void *),
+					  void *context)
+{
+  if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+  group->notify = notify;
+  group->notify_context = context;
+  if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+}
+
+static void
+channel_processor_group_set_page_packing (struct
+					  adftool_channel_processor_group
+					  *group, bool pack_pages)
+{
+  if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+  group->pack_pages = pack_pages;
+  if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+}
+
+static void *
+channel_processor_group_worker (void *ctx)
+{
+  /* Populate the caches while there is work to do, then sleep until
+     a window moves. */
+  struct adftool_channel_processor_group *group = ctx;
+  if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+  while (!group->stopping)
+    {
+      const size_t generation = group->generation;
+      if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+	{
+	  abort ();
+	}
+      bool work_done = false;
+      const int error =
+	channel_processor_group_populate_cache (group, &work_done);
+      if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+	{
+	  abort ();
+	}
+      if (work_done)
+	{
+	  /* The other workers may have skipped the pages that this one
+	     was filtering: let them look again. */
+	  channel_processor_group_wake (group);
+	}
+      /* On error, try again when the windows change. */
+      while ((error != 0 || !work_done)
+	     && !group->stopping && group->generation == generation)
+	{
+	  if (pthread_cond_wait (&(group->work_available),
+				 &(group->channel_list_synchronizer)) != 0)
+	    {
+	      abort ();
+	    }
+	}
+    }
+  if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+  return NULL;
+}
+
+static void
+channel_processor_group_stop_workers (struct adftool_channel_processor_group
+				      *group)
+{
+  if (pthread_mutex_lock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+  group->stopping = true;
+  if (pthread_cond_broadcast (&(group->work_available)) != 0)
+    {
+      abort ();
+    }
+  if (pthread_mutex_unlock (&(group->channel_list_synchronizer)) != 0)
+    {
+      abort ();
+    }
+  for (size_t i = 0; i < group->n_workers; i++)
+    {
+      if (pthread_join (group->workers[i], NULL) != 0)
+	{
+	  abort ();
+	}
+    }
+  FREE (group->workers);
+  group->n_workers = 0;
+  group->stopping = false;
+}
+
+static int
+channel_processor_group_start_workers (struct adftool_channel_processor_group
+				       *group, size_t n_workers)
+{
+  int error = 0;
+  if (group->workers != NULL)
+    {
+      error = -1;
+      goto cleanup;
+    }
+  if (n_workers == 0)
+    {
+      goto cleanup;
+    }
+  if (ALLOC_N (group->workers, n_workers) < 0)
+    {
+      error = -2;
+      goto cleanup;
+    }
+  for (group->n_workers = 0; group->n_workers < n_workers;
+       group->n_workers++)
+    {
+      if (pthread_create (&(group->workers[group->n_workers]), NULL,
+			  channel_processor_group_worker, group) != 0)
 	{
-	  /* Exit do…while immediately. */
+	  error = -2;
+	  channel_processor_group_stop_workers (group);
+	  goto cleanup;
 	}
     }
-  while (n_tried < n_max && !(*work_done));
 cleanup:
   return error;
 }
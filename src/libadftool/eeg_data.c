@@ -8,14 +8,14 @@
 
 #include "file.h"
 #include "channel_decoder.h"
+#include "eeg_kernels.h"
 
 #include <float.h>
 
 #include <hdf5.h>
 
-static void compute_encoding (size_t n, size_t p, size_t i,
-			      const double *data, double *offset,
-			      double *scale);
+static void compute_encoding (size_t n, size_t p, const double *data,
+			      double *offsets, double *scales);
 
 static struct adftool_statement *new_channel_statement (size_t i);
 
@@ -23,132 +23,1033 @@ static int set_channel_identifier (struct adftool_file *file,
 				   size_t channel_index,
 				   const struct adftool_term *identifier);
 
+/* Default layout of /eeg-data: a chunk covers 16 seconds at 256 Hz
+   for a group of 16 channels, so that a viewport query only
+   decompresses the few chunks it touches. */
+#define EEG_DATA_DEFAULT_CHUNK_POINTS 4096
+#define EEG_DATA_DEFAULT_CHUNK_CHANNELS 16
+#define EEG_DATA_DEFAULT_COMPRESSION_LEVEL 4
+
+/* The LZ4 filter is not built in HDF5, it is only usable if the
+   plugin is installed. */
+#define EEG_DATA_FILTER_LZ4 32004
+
+static hid_t
+eeg_data_creation_properties (size_t n_channels, size_t chunk_points,
+			      size_t chunk_channels, int compression,
+			      int compression_level)
+{
+  /* The dataset is always extendible along time, so chunking is
+     mandatory. */
+  hid_t properties = H5Pcreate (H5P_DATASET_CREATE);
+  if (properties == H5I_INVALID_HID)
+    {
+      goto wrapup;
+    }
+  assert (chunk_points != 0);
+  if (chunk_channels == 0)
+    {
+      chunk_channels = EEG_DATA_DEFAULT_CHUNK_CHANNELS;
+    }
+  if (chunk_channels > n_channels)
+    {
+      chunk_channels = n_channels;
+    }
+  const hsize_t chunk[2] = { chunk_points, chunk_channels };
+  if (H5Pset_chunk (properties, 2, chunk) < 0)
+    {
+      goto failure;
+    }
+  if (compression == ADFTOOL_EEG_COMPRESSION_LZ4
+      && H5Zfilter_avail (EEG_DATA_FILTER_LZ4) <= 0)
+    {
+      /* Fall back to the built-in filter. */
+      compression = ADFTOOL_EEG_COMPRESSION_DEFLATE;
+    }
+  if (compression == ADFTOOL_EEG_COMPRESSION_DEFLATE
+      && H5Zfilter_avail (H5Z_FILTER_DEFLATE) <= 0)
+    {
+      /* HDF5 may be built without zlib, for instance with
+         emscripten. */
+      compression = ADFTOOL_EEG_COMPRESSION_NONE;
+    }
+  if (compression != ADFTOOL_EEG_COMPRESSION_NONE)
+    {
+      /* Grouping the high bytes and the low bytes of the samples
+         together greatly helps the compression of 16-bit data. */
+      if (H5Pset_shuffle (properties) < 0)
+	{
+	  goto failure;
+	}
+    }
+  if (compression == ADFTOOL_EEG_COMPRESSION_DEFLATE)
+    {
+      if (compression_level < 0 || compression_level > 9)
+	{
+	  compression_level = EEG_DATA_DEFAULT_COMPRESSION_LEVEL;
+	}
+      if (H5Pset_deflate (properties, compression_level) < 0)
+	{
+	  goto failure;
+	}
+    }
+  else if (compression == ADFTOOL_EEG_COMPRESSION_LZ4)
+    {
+      if (H5Pset_filter (properties, EEG_DATA_FILTER_LZ4, H5Z_FLAG_MANDATORY,
+			 0, NULL) < 0)
+	{
+	  goto failure;
+	}
+    }
+wrapup:
+  return properties;
+failure:
+  H5Pclose (properties);
+  return H5I_INVALID_HID;
+}
+
+static int
+eeg_data_extend (hid_t dataset, int rank, const hsize_t * dimensions,
+		 const hsize_t * start, const hsize_t * count,
+		 hid_t memory_type, const void *data)
+{
+  /* Grow dataset to dimensions, and write data to the hyperslab. */
+  int error = 0;
+  if (H5Dset_extent (dataset, dimensions) < 0)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  hid_t dataspace = H5Dget_space (dataset);
+  if (dataspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  if (H5Sselect_hyperslab (dataspace, H5S_SELECT_SET, start, NULL, count,
+			   NULL) < 0)
+    {
+      error = 1;
+      goto clean_dataspace;
+    }
+  hid_t memspace = H5Screate_simple (rank, count, count);
+  if (memspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_dataspace;
+    }
+  if (H5Dwrite (dataset, memory_type, memspace, dataspace, H5P_DEFAULT,
+		data) < 0)
+    {
+      error = 1;
+    }
+  H5Sclose (memspace);
+clean_dataspace:
+  H5Sclose (dataspace);
+wrapup:
+  return error;
+}
+
+/* The envelope pyramid summarizes the recording for zoomed-out
+   display. Level k is the dataset /eeg-envelope/k, with one row per
+   bin of (EEG_ENVELOPE_BASE_BIN << k) observations, and for each
+   channel, the minimum, maximum and mean value in the bin. The last
+   bin of each level may be incomplete. The values are not
+   calibrated by the channel decoder. */
+#define EEG_ENVELOPE_N_LEVELS 16
+#define EEG_ENVELOPE_BASE_BIN 16
+#define EEG_ENVELOPE_PENDING_BINS 64
+
+struct eeg_envelope_level
+{
+  /* The bin being filled: for each channel, min, max and sum. */
+  size_t n_rows;
+  double *current;
+  /* The finished bins, not yet written: for each channel, min, max
+     and mean. */
+  size_t n_pending;
+  double *pending;
+  size_t n_written;
+};
+
+struct eeg_envelope
+{
+  struct adftool_file *file;
+  size_t n_channels;
+  struct eeg_envelope_level levels[EEG_ENVELOPE_N_LEVELS];
+};
+
+static void
+eeg_envelope_level_reset (struct eeg_envelope_level *level,
+			  size_t n_channels)
+{
+  level->n_rows = 0;
+  for (size_t j = 0; j < n_channels; j++)
+    {
+      level->current[3 * j] = DBL_MAX;
+      level->current[3 * j + 1] = -DBL_MAX;
+      level->current[3 * j + 2] = 0;
+    }
+}
+
+static void
+eeg_envelope_free (struct eeg_envelope *envelope)
+{
+  if (envelope != NULL)
+    {
+      for (size_t k = 0; k < EEG_ENVELOPE_N_LEVELS; k++)
+	{
+	  free (envelope->levels[k].pending);
+	  free (envelope->levels[k].current);
+	}
+    }
+  free (envelope);
+}
+
+static int
+eeg_envelope_create_level (struct adftool_file *file, size_t n_channels,
+			   size_t k)
+{
+  int error = 0;
+  char name[64];
+  sprintf (name, "/eeg-envelope/%zu", k);
+  hsize_t dimensions[3] = { 0, 0, 3 };
+  hsize_t max_dimensions[3] = { H5S_UNLIMITED, 0, 3 };
+  hsize_t chunk[3] = { EEG_ENVELOPE_PENDING_BINS, 0, 3 };
+  dimensions[1] = n_channels;
+  max_dimensions[1] = n_channels;
+  chunk[1] = n_channels;
+  hid_t fspace = H5Screate_simple (3, dimensions, max_dimensions);
+  if (fspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  hid_t creation_properties = H5Pcreate (H5P_DATASET_CREATE);
+  if (creation_properties == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_fspace;
+    }
+  if (H5Pset_chunk (creation_properties, 3, chunk) < 0)
+    {
+      error = 1;
+      goto clean_properties;
+    }
+  hid_t dataset =
+    H5Dcreate2 (file->hdf5_handle, name, H5T_NATIVE_DOUBLE, fspace,
+		H5P_DEFAULT, creation_properties, H5P_DEFAULT);
+  if (dataset == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_properties;
+    }
+  hid_t scalar = H5Screate (H5S_SCALAR);
+  if (scalar == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_dataset;
+    }
+  hid_t attribute =
+    H5Acreate2 (dataset, "bin-length", H5T_STD_U64LE, scalar, H5P_DEFAULT,
+		H5P_DEFAULT);
+  if (attribute == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_scalar;
+    }
+  const uint64_t bin_length = ((uint64_t) EEG_ENVELOPE_BASE_BIN) << k;
+  if (H5Awrite (attribute, H5T_NATIVE_UINT64, &bin_length) < 0)
+    {
+      error = 1;
+    }
+  H5Aclose (attribute);
+clean_scalar:
+  H5Sclose (scalar);
+clean_dataset:
+  H5Dclose (dataset);
+clean_properties:
+  H5Pclose (creation_properties);
+clean_fspace:
+  H5Sclose (fspace);
+wrapup:
+  return error;
+}
+
+static struct eeg_envelope *
+eeg_envelope_alloc (struct adftool_file *file, size_t n_channels)
+{
+  /* Discard the envelope in file, and prepare a new one. */
+  struct eeg_envelope *ret = calloc (1, sizeof (struct eeg_envelope));
+  if (ret == NULL)
+    {
+      return NULL;
+    }
+  ret->file = file;
+  ret->n_channels = n_channels;
+  for (size_t k = 0; k < EEG_ENVELOPE_N_LEVELS; k++)
+    {
+      struct eeg_envelope_level *level = &(ret->levels[k]);
+      level->current = malloc (n_channels * 3 * sizeof (double));
+      level->pending =
+	malloc (EEG_ENVELOPE_PENDING_BINS * n_channels * 3 * sizeof (double));
+      if (level->current == NULL || level->pending == NULL)
+	{
+	  goto failure;
+	}
+      eeg_envelope_level_reset (level, n_channels);
+    }
+  H5Ldelete (file->hdf5_handle, "/eeg-envelope", H5P_DEFAULT);
+  hid_t group =
+    H5Gcreate2 (file->hdf5_handle, "/eeg-envelope", H5P_DEFAULT,
+		H5P_DEFAULT, H5P_DEFAULT);
+  if (group == H5I_INVALID_HID)
+    {
+      goto failure;
+    }
+  H5Gclose (group);
+  for (size_t k = 0; k < EEG_ENVELOPE_N_LEVELS; k++)
+    {
+      if (eeg_envelope_create_level (file, n_channels, k) != 0)
+	{
+	  goto failure;
+	}
+    }
+  return ret;
+failure:
+  eeg_envelope_free (ret);
+  return NULL;
+}
+
+static int
+eeg_envelope_write_pending (struct eeg_envelope *envelope, size_t k)
+{
+  struct eeg_envelope_level *level = &(envelope->levels[k]);
+  int error = 0;
+  if (level->n_pending == 0)
+    {
+      goto wrapup;
+    }
+  char name[64];
+  sprintf (name, "/eeg-envelope/%zu", k);
+  hid_t dataset = H5Dopen2 (envelope->file->hdf5_handle, name, H5P_DEFAULT);
+  if (dataset == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  const hsize_t dimensions[3] =
+    { level->n_written + level->n_pending, envelope->n_channels, 3 };
+  const hsize_t start[3] = { level->n_written, 0, 0 };
+  const hsize_t count[3] = { level->n_pending, envelope->n_channels, 3 };
+  if (eeg_data_extend (dataset, 3, dimensions, start, count,
+		       H5T_NATIVE_DOUBLE, level->pending) != 0)
+    {
+      error = 1;
+      goto clean_dataset;
+    }
+  level->n_written += level->n_pending;
+  level->n_pending = 0;
+clean_dataset:
+  H5Dclose (dataset);
+wrapup:
+  return error;
+}
+
+static void
+eeg_envelope_merge (size_t n_channels, double *current,
+		    const double *summary)
+{
+  /* Add a summary (min, max, sum) to the current bin. */
+  for (size_t j = 0; j < n_channels; j++)
+    {
+      if (summary[3 * j] < current[3 * j])
+	{
+	  current[3 * j] = summary[3 * j];
+	}
+      if (summary[3 * j + 1] > current[3 * j + 1])
+	{
+	  current[3 * j + 1] = summary[3 * j + 1];
+	}
+      current[3 * j + 2] += summary[3 * j + 2];
+    }
+}
+
+static int
+eeg_envelope_finish_bin (struct eeg_envelope *envelope, size_t k,
+			 bool propagate)
+{
+  /* Move the current bin of level k to the pending bins, and to the
+     current bin of the next level. If propagate, and the next bin is
+     complete, finish it too. */
+  const size_t n_channels = envelope->n_channels;
+  struct eeg_envelope_level *level = &(envelope->levels[k]);
+  if (level->n_pending == EEG_ENVELOPE_PENDING_BINS
+      && eeg_envelope_write_pending (envelope, k) != 0)
+    {
+      return 1;
+    }
+  double *finished = level->pending + level->n_pending * n_channels * 3;
+  for (size_t j = 0; j < n_channels; j++)
+    {
+      finished[3 * j] = level->current[3 * j];
+      finished[3 * j + 1] = level->current[3 * j + 1];
+      finished[3 * j + 2] = level->current[3 * j + 2] / level->n_rows;
+    }
+  level->n_pending++;
+  if (k + 1 < EEG_ENVELOPE_N_LEVELS)
+    {
+      struct eeg_envelope_level *next = &(envelope->levels[k + 1]);
+      eeg_envelope_merge (n_channels, next->current, level->current);
+      next->n_rows += level->n_rows;
+      if (propagate
+	  && next->n_rows == ((size_t) EEG_ENVELOPE_BASE_BIN << (k + 1)))
+	{
+	  if (eeg_envelope_finish_bin (envelope, k + 1, true) != 0)
+	    {
+	      return 1;
+	    }
+	}
+    }
+  eeg_envelope_level_reset (level, n_channels);
+  return 0;
+}
+
+static int
+eeg_envelope_push (struct eeg_envelope *envelope, size_t n_rows,
+		   const double *rows)
+{
+  const size_t n_channels = envelope->n_channels;
+  struct eeg_envelope_level *finest = &(envelope->levels[0]);
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      const double *row = rows + i * n_channels;
+      for (size_t j = 0; j < n_channels; j++)
+	{
+	  if (row[j] < finest->current[3 * j])
+	    {
+	      finest->current[3 * j] = row[j];
+	    }
+	  if (row[j] > finest->current[3 * j + 1])
+	    {
+	      finest->current[3 * j + 1] = row[j];
+	    }
+	  finest->current[3 * j + 2] += row[j];
+	}
+      finest->n_rows++;
+      if (finest->n_rows == EEG_ENVELOPE_BASE_BIN
+	  && eeg_envelope_finish_bin (envelope, 0, true) != 0)
+	{
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+static int
+eeg_envelope_flush (struct eeg_envelope *envelope)
+{
+  /* Write the incomplete bins. An incomplete bin of level k never
+     completes the bin of level k + 1, so no more observations can be
+     pushed after that. */
+  for (size_t k = 0; k < EEG_ENVELOPE_N_LEVELS; k++)
+    {
+      if (envelope->levels[k].n_rows != 0
+	  && eeg_envelope_finish_bin (envelope, k, false) != 0)
+	{
+	  return 1;
+	}
+      if (eeg_envelope_write_pending (envelope, k) != 0)
+	{
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+struct adftool_eeg_appender
+{
+  struct adftool_file *file;
+  size_t n_channels;
+  size_t n_points;
+  /* The data is quantized by blocks of block_length rows, each with
+     its own scale and offset per channel. A block is only encoded
+     and written once it is complete, so the appender buffers at most
+     one block. */
+  size_t block_length;
+  size_t n_buffered;
+  double *block;
+  /* NULL if the values must not be clipped. */
+  double *physical_min;
+  double *physical_max;
+  double *scales;
+  double *offsets;
+  double *inverse_scales;
+  uint16_t *encoded;
+  struct eeg_envelope *envelope;
+};
+
+static void eeg_appender_free (struct adftool_eeg_appender *appender);
+
+static int
+eeg_appender_create_block_decoders (struct adftool_file *file,
+				    size_t n_channels, size_t block_length)
+{
+  int error = 0;
+  H5Ldelete (file->hdf5_handle, "/eeg-block-decoders", H5P_DEFAULT);
+  /* For each block, for each channel, a (scale, offset) pair. */
+  hsize_t dimensions[3] = { 0, 0, 2 };
+  hsize_t max_dimensions[3] = { H5S_UNLIMITED, 0, 2 };
+  hsize_t chunk[3] = { 64, 0, 2 };
+  dimensions[1] = n_channels;
+  max_dimensions[1] = n_channels;
+  chunk[1] = n_channels;
+  hid_t fspace = H5Screate_simple (3, dimensions, max_dimensions);
+  if (fspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  hid_t creation_properties = H5Pcreate (H5P_DATASET_CREATE);
+  if (creation_properties == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_fspace;
+    }
+  if (H5Pset_chunk (creation_properties, 3, chunk) < 0)
+    {
+      error = 1;
+      goto clean_properties;
+    }
+  hid_t decoders =
+    H5Dcreate2 (file->hdf5_handle, "/eeg-block-decoders", H5T_NATIVE_DOUBLE,
+		fspace, H5P_DEFAULT, creation_properties, H5P_DEFAULT);
+  if (decoders == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_properties;
+    }
+  hid_t scalar = H5Screate (H5S_SCALAR);
+  if (scalar == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_decoders;
+    }
+  hid_t attribute =
+    H5Acreate2 (decoders, "block-length", H5T_STD_U64LE, scalar,
+		H5P_DEFAULT, H5P_DEFAULT);
+  if (attribute == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_scalar;
+    }
+  const uint64_t length = block_length;
+  if (H5Awrite (attribute, H5T_NATIVE_UINT64, &length) < 0)
+    {
+      error = 1;
+    }
+  H5Aclose (attribute);
+clean_scalar:
+  H5Sclose (scalar);
+clean_decoders:
+  H5Dclose (decoders);
+clean_properties:
+  H5Pclose (creation_properties);
+clean_fspace:
+  H5Sclose (fspace);
+wrapup:
+  return error;
+}
+
+static struct adftool_eeg_appender *
+eeg_appender_alloc (struct adftool_file *file, size_t n_channels,
+		    const double *physical_min, const double *physical_max,
+		    size_t chunk_points, size_t chunk_channels,
+		    int compression, int compression_level)
+{
+  int error = 0;
+  struct adftool_eeg_appender *ret = NULL;
+  if (n_channels == 0)
+    {
+      /* HDF5 cannot chunk a dataset with no columns. */
+      goto wrapup;
+    }
+  ret = calloc (1, sizeof (struct adftool_eeg_appender));
+  if (ret == NULL)
+    {
+      goto wrapup;
+    }
+  if (chunk_points == 0)
+    {
+      chunk_points = EEG_DATA_DEFAULT_CHUNK_POINTS;
+    }
+  ret->file = file;
+  ret->n_channels = n_channels;
+  ret->n_points = 0;
+  /* A quantization block is a row of chunks. */
+  ret->block_length = chunk_points;
+  ret->n_buffered = 0;
+  ret->block = malloc (chunk_points * n_channels * sizeof (double));
+  ret->scales = malloc (n_channels * sizeof (double));
+  ret->offsets = malloc (n_channels * sizeof (double));
+  ret->inverse_scales = malloc (n_channels * sizeof (double));
+  ret->encoded = malloc (chunk_points * n_channels * sizeof (uint16_t));
+  if (ret->block == NULL || ret->scales == NULL || ret->offsets == NULL
+      || ret->inverse_scales == NULL || ret->encoded == NULL)
+    {
+      error = 1;
+      goto cleanup;
+    }
+  if (physical_min != NULL && physical_max != NULL)
+    {
+      ret->physical_min = malloc (n_channels * sizeof (double));
+      ret->physical_max = malloc (n_channels * sizeof (double));
+      if (ret->physical_min == NULL || ret->physical_max == NULL)
+	{
+	  error = 1;
+	  goto cleanup;
+	}
+      memcpy (ret->physical_min, physical_min, n_channels * sizeof (double));
+      memcpy (ret->physical_max, physical_max, n_channels * sizeof (double));
+    }
+  adftool_file_eeg_decoders_invalidate (file);
+  adftool_file_eeg_dataset_close (file);
+  H5Ldelete (file->hdf5_handle, "/eeg-data", H5P_DEFAULT);
+  hsize_t dimensions[2] = { 0, 0 };
+  hsize_t max_dimensions[2] = { H5S_UNLIMITED, 0 };
+  dimensions[1] = n_channels;
+  max_dimensions[1] = n_channels;
+  hid_t fspace = H5Screate_simple (2, dimensions, max_dimensions);
+  if (fspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto cleanup;
+    }
+  hid_t creation_properties =
+    eeg_data_creation_properties (n_channels, chunk_points, chunk_channels,
+				  compression, compression_level);
+  if (creation_properties == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_fspace;
+    }
+  hid_t eeg_dataset =
+    H5Dcreate2 (file->hdf5_handle, "/eeg-data", H5T_NATIVE_B16, fspace,
+		H5P_DEFAULT, creation_properties, H5P_DEFAULT);
+  H5Pclose (creation_properties);
+  if (eeg_dataset == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_fspace;
+    }
+  /* The file will reopen it with its chunk cache. */
+  H5Dclose (eeg_dataset);
+  if (eeg_appender_create_block_decoders (file, n_channels, chunk_points)
+      != 0)
+    {
+      error = 1;
+      goto clean_fspace;
+    }
+  ret->envelope = eeg_envelope_alloc (file, n_channels);
+  if (ret->envelope == NULL)
+    {
+      error = 1;
+      goto clean_fspace;
+    }
+  for (size_t i = 0; i < n_channels; i++)
+    {
+      struct adftool_statement *new_channel = new_channel_statement (i);
+      if (new_channel == NULL)
+	{
+	  abort ();
+	}
+      if (adftool_file_insert (file, new_channel) != 0)
+	{
+	  error = 1;
+	  goto clean_new_channel;
+	}
+      const struct adftool_term *identifier;
+      statement_get (new_channel, NULL, NULL,
+		     (struct adftool_term **) &identifier, NULL, NULL);
+      assert (identifier != NULL);
+      if (set_channel_identifier (file, i, identifier) != 0)
+	{
+	  error = 1;
+	  goto clean_new_channel;
+	}
+      /* The quantization is handled by the block decoders. The
+         channel decoder is a calibration on top of it. */
+      if (channel_decoder_set (file, identifier, 1, 0) != 0)
+	{
+	  error = 1;
+	  goto clean_new_channel;
+	}
+    clean_new_channel:
+      statement_free (new_channel);
+      if (error)
+	{
+	  goto clean_fspace;
+	}
+    }
+clean_fspace:
+  H5Sclose (fspace);
+cleanup:
+  if (error)
+    {
+      eeg_appender_free (ret);
+      ret = NULL;
+    }
+wrapup:
+  return ret;
+}
+
+static int
+eeg_appender_write_block (struct adftool_eeg_appender *appender)
+{
+  /* Encode and write the buffered rows, as one quantization
+     block. */
+  int error = 0;
+  const size_t n_channels = appender->n_channels;
+  const size_t n_rows = appender->n_buffered;
+  if (n_rows == 0)
+    {
+      goto wrapup;
+    }
+  if (eeg_envelope_push (appender->envelope, n_rows, appender->block) != 0)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  compute_encoding (n_rows, n_channels, appender->block, appender->offsets,
+		    appender->scales);
+  for (size_t j = 0; j < n_channels; j++)
+    {
+      appender->inverse_scales[j] = 0;
+      if (appender->scales[j] != 0)
+	{
+	  appender->inverse_scales[j] = 1 / appender->scales[j];
+	}
+    }
+  eeg_kernels_encode (eeg_kernels_best_isa (), n_rows, n_channels,
+		      appender->block, appender->offsets,
+		      appender->inverse_scales, appender->encoded);
+  hid_t eeg_dataset = adftool_file_eeg_dataset (appender->file);
+  hid_t decoders;
+  size_t block_length;
+  if (eeg_dataset == H5I_INVALID_HID
+      || adftool_file_eeg_block_decoders (appender->file, &decoders,
+					  &block_length) != 0
+      || decoders == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  assert (block_length == appender->block_length);
+  assert (appender->n_points % block_length == 0);
+  const size_t block_index = appender->n_points / block_length;
+  double *block_decoders = malloc (n_channels * 2 * sizeof (double));
+  if (block_decoders == NULL)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  for (size_t j = 0; j < n_channels; j++)
+    {
+      block_decoders[2 * j] = appender->scales[j];
+      block_decoders[2 * j + 1] = appender->offsets[j];
+    }
+  const hsize_t decoders_dimensions[3] = { block_index + 1, n_channels, 2 };
+  const hsize_t decoders_start[3] = { block_index, 0, 0 };
+  const hsize_t decoders_count[3] = { 1, n_channels, 2 };
+  const hsize_t data_dimensions[2] =
+    { appender->n_points + n_rows, n_channels };
+  const hsize_t data_start[2] = { appender->n_points, 0 };
+  const hsize_t data_count[2] = { n_rows, n_channels };
+  if (eeg_data_extend (decoders, 3, decoders_dimensions, decoders_start,
+		       decoders_count, H5T_NATIVE_DOUBLE, block_decoders) != 0
+      || eeg_data_extend (eeg_dataset, 2, data_dimensions, data_start,
+			  data_count, H5T_NATIVE_B16, appender->encoded) != 0)
+    {
+      error = 1;
+      goto clean_block_decoders;
+    }
+  appender->n_points += n_rows;
+  appender->n_buffered = 0;
+clean_block_decoders:
+  free (block_decoders);
+wrapup:
+  return error;
+}
+
+static int
+eeg_appender_push (struct adftool_eeg_appender *appender, size_t n_points,
+		   const double *data)
+{
+  const size_t n_channels = appender->n_channels;
+  for (size_t i = 0; i < n_points; i++)
+    {
+      if (appender->n_buffered == appender->block_length)
+	{
+	  if (eeg_appender_write_block (appender) != 0)
+	    {
+	      return 1;
+	    }
+	}
+      const double *row = data + i * n_channels;
+      double *buffered = appender->block + appender->n_buffered * n_channels;
+      memcpy (buffered, row, n_channels * sizeof (double));
+      if (appender->physical_min != NULL)
+	{
+	  for (size_t j = 0; j < n_channels; j++)
+	    {
+	      /* Clip the values that do not fit in the declared range,
+	         including NaN. */
+	      if (!(buffered[j] >= appender->physical_min[j]))
+		{
+		  buffered[j] = appender->physical_min[j];
+		}
+	      if (buffered[j] > appender->physical_max[j])
+		{
+		  buffered[j] = appender->physical_max[j];
+		}
+	    }
+	}
+      appender->n_buffered++;
+    }
+  return 0;
+}
+
+static int
+eeg_appender_flush (struct adftool_eeg_appender *appender)
+{
+  /* The last block may be incomplete. */
+  if (eeg_appender_write_block (appender) != 0
+      || eeg_envelope_flush (appender->envelope) != 0)
+    {
+      return 1;
+    }
+  if (H5Fflush (appender->file->hdf5_handle, H5F_SCOPE_LOCAL) < 0)
+    {
+      return 1;
+    }
+  return 0;
+}
+
+static void
+eeg_appender_free (struct adftool_eeg_appender *appender)
+{
+  if (appender != NULL)
+    {
+      eeg_envelope_free (appender->envelope);
+      free (appender->encoded);
+      free (appender->inverse_scales);
+      free (appender->offsets);
+      free (appender->scales);
+      free (appender->physical_max);
+      free (appender->physical_min);
+      free (appender->block);
+    }
+  free (appender);
+}
+
+struct adftool_eeg_appender *
+adftool_eeg_appender_alloc (struct adftool_file *file, size_t n_channels,
+			    const double *physical_min,
+			    const double *physical_max)
+{
+  return eeg_appender_alloc (file, n_channels, physical_min, physical_max,
+			     0, 0, ADFTOOL_EEG_COMPRESSION_DEFLATE,
+			     EEG_DATA_DEFAULT_COMPRESSION_LEVEL);
+}
+
+int
+adftool_eeg_appender_push (struct adftool_eeg_appender *appender,
+			   size_t n_points, const double *data)
+{
+  return eeg_appender_push (appender, n_points, data);
+}
+
+int
+adftool_eeg_appender_finish (struct adftool_eeg_appender *appender)
+{
+  return eeg_appender_flush (appender);
+}
+
+void
+adftool_eeg_appender_free (struct adftool_eeg_appender *appender)
+{
+  eeg_appender_free (appender);
+}
+
+static int
+eeg_data_set_empty (struct adftool_file *file, size_t n_points)
+{
+  /* HDF5 cannot chunk a dataset with no columns, so it is written
+     as a fixed, contiguous dataset, with no block decoders and no
+     envelope. */
+  int error = 0;
+  adftool_file_eeg_decoders_invalidate (file);
+  adftool_file_eeg_dataset_close (file);
+  H5Ldelete (file->hdf5_handle, "/eeg-data", H5P_DEFAULT);
+  H5Ldelete (file->hdf5_handle, "/eeg-block-decoders", H5P_DEFAULT);
+  H5Ldelete (file->hdf5_handle, "/eeg-envelope", H5P_DEFAULT);
+  hsize_t dimensions[2] = { 0, 0 };
+  dimensions[0] = n_points;
+  hid_t fspace = H5Screate_simple (2, dimensions, dimensions);
+  if (fspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  hid_t eeg_dataset =
+    H5Dcreate2 (file->hdf5_handle, "/eeg-data", H5T_NATIVE_B16, fspace,
+		H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+  if (eeg_dataset == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_fspace;
+    }
+  H5Dclose (eeg_dataset);
+clean_fspace:
+  H5Sclose (fspace);
+wrapup:
+  return error;
+}
+
 int
 adftool_eeg_set_data (struct adftool_file *file, size_t n_points,
 		      size_t n_channels, const double *data)
+{
+  return adftool_eeg_set_data_chunked (file, n_points, n_channels, data, 0,
+				       0, ADFTOOL_EEG_COMPRESSION_DEFLATE,
+				       EEG_DATA_DEFAULT_COMPRESSION_LEVEL);
+}
+
+int
+adftool_eeg_set_data_chunked (struct adftool_file *file, size_t n_points,
+			      size_t n_channels, const double *data,
+			      size_t chunk_points, size_t chunk_channels,
+			      int compression, int compression_level)
 {
   int error = 0;
-  hid_t eeg_dataset = H5I_INVALID_HID;
-  H5Ldelete (file->hdf5_handle, "/eeg-data", H5P_DEFAULT);
-  hsize_t dimensions[2];
-  dimensions[0] = n_points;
-  dimensions[1] = n_channels;
-  hid_t fspace = H5Screate_simple (2, dimensions, dimensions);
-  if (fspace == H5I_INVALID_HID)
+  if (n_channels == 0)
+    {
+      return eeg_data_set_empty (file, n_points);
+    }
+  struct adftool_eeg_appender *appender =
+    eeg_appender_alloc (file, n_channels, NULL, NULL, chunk_points,
+			chunk_channels, compression, compression_level);
+  if (appender == NULL)
+    {
+      return 1;
+    }
+  if (eeg_appender_push (appender, n_points, data) != 0
+      || eeg_appender_flush (appender) != 0)
     {
       error = 1;
-      goto wrapup;
     }
-  eeg_dataset =
-    H5Dcreate2 (file->hdf5_handle, "/eeg-data", H5T_NATIVE_B16, fspace,
-		H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
-  if (eeg_dataset == H5I_INVALID_HID)
+  eeg_appender_free (appender);
+  return error;
+}
+
+static int
+eeg_data_get_block_decoders (struct adftool_file *file, size_t time_start,
+			     size_t time_length, size_t channel_start,
+			     size_t channel_length, size_t *first_block,
+			     size_t *block_length, size_t *n_blocks,
+			     double **block_decoders)
+{
+  /* Read the (scale, offset) pairs of the blocks that cover the
+     window. If the file has no block decoders, pretend that there is
+     one huge block with an identity decoder. */
+  int error = 0;
+  hid_t decoders;
+  *block_decoders = NULL;
+  if (adftool_file_eeg_block_decoders (file, &decoders, block_length) != 0)
     {
       error = 1;
-      goto clean_fspace;
+      goto wrapup;
     }
-  for (size_t i = 0; i < n_channels; i++)
+  if (decoders == H5I_INVALID_HID)
     {
-      double offset;
-      double scale;
-      compute_encoding (n_points, n_channels, i, data, &offset, &scale);
-      struct adftool_statement *new_channel = new_channel_statement (i);
-      if (new_channel == NULL)
-	{
-	  abort ();
-	}
-      if (adftool_file_insert (file, new_channel) != 0)
-	{
-	  error = 1;
-	  goto clean_new_channel;
-	}
-      const struct adftool_term *identifier;
-      statement_get (new_channel, NULL, NULL,
-		     (struct adftool_term **) &identifier, NULL, NULL);
-      assert (identifier != NULL);
-      if (set_channel_identifier (file, i, identifier) != 0)
-	{
-	  error = 1;
-	  goto clean_new_channel;
-	}
-      if (channel_decoder_set (file, identifier, scale, offset) != 0)
-	{
-	  error = 1;
-	  goto clean_new_channel;
-	}
-      hid_t selection_space = H5Screate_simple (2, dimensions, NULL);
-      if (selection_space == H5I_INVALID_HID)
-	{
-	  error = 1;
-	  goto clean_fspace;
-	}
-      hsize_t start[] = { 0, 0 };
-      hsize_t count[] = { 0, 1 };
-      start[1] = i;
-      count[0] = n_points;
-      herr_t selection_error =
-	H5Sselect_hyperslab (selection_space, H5S_SELECT_AND, start, NULL,
-			     count, NULL);
-      if (selection_error)
-	{
-	  error = 1;
-	  goto clean_selection_space;
-	}
-      hsize_t mem_length = n_points;
-      hid_t memspace = H5Screate_simple (1, &mem_length, &mem_length);
-      if (memspace == H5I_INVALID_HID)
-	{
-	  error = 1;
-	  goto clean_selection_space;
-	}
-      uint16_t *encoded = malloc (n_points * sizeof (uint16_t));
-      if (encoded == NULL)
+      *first_block = 0;
+      *block_length = time_start + time_length;
+      *n_blocks = 1;
+      *block_decoders = malloc (channel_length * 2 * sizeof (double));
+      if (*block_decoders == NULL)
 	{
 	  error = 1;
-	  goto clean_memory_space;
+	  goto wrapup;
 	}
-      for (size_t j = 0; j < n_points; j++)
-	{
-	  const double raw = data[j * n_channels + i];
-	  const double encoded_point = (raw - offset) / scale;
-	  const uint16_t rounded = (uint16_t) (encoded_point + 0.5);
-	  encoded[j] = rounded;
-	}
-      herr_t write_error = H5Dwrite (eeg_dataset, H5T_NATIVE_B16, memspace,
-				     selection_space, H5P_DEFAULT, encoded);
-      if (write_error < 0)
-	{
-	  error = 1;
-	  goto clean_encoded;
-	}
-    clean_encoded:
-      free (encoded);
-    clean_memory_space:
-      H5Sclose (memspace);
-    clean_selection_space:
-      H5Sclose (selection_space);
-    clean_new_channel:
-      statement_free (new_channel);
-      if (error)
+      for (size_t j = 0; j < channel_length; j++)
 	{
-	  goto clean_fspace;
+	  (*block_decoders)[2 * j] = 1;
+	  (*block_decoders)[2 * j + 1] = 0;
 	}
+      goto wrapup;
     }
-clean_fspace:
-  H5Sclose (fspace);
+  *first_block = time_start / *block_length;
+  const size_t last_block = (time_start + time_length - 1) / *block_length;
+  *n_blocks = last_block - *first_block + 1;
+  hid_t dataspace = H5Dget_space (decoders);
+  if (dataspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  const hsize_t start[3] = { *first_block, channel_start, 0 };
+  const hsize_t count[3] = { *n_blocks, channel_length, 2 };
+  if (H5Sselect_hyperslab (dataspace, H5S_SELECT_SET, start, NULL, count,
+			   NULL) < 0)
+    {
+      error = 1;
+      goto clean_dataspace;
+    }
+  hid_t memspace = H5Screate_simple (3, count, count);
+  if (memspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_dataspace;
+    }
+  *block_decoders = malloc (*n_blocks * channel_length * 2 * sizeof (double));
+  if (*block_decoders == NULL)
+    {
+      error = 1;
+      goto clean_memspace;
+    }
+  if (H5Dread (decoders, H5T_NATIVE_DOUBLE, memspace, dataspace,
+	       H5P_DEFAULT, *block_decoders) < 0)
+    {
+      error = 1;
+      free (*block_decoders);
+      *block_decoders = NULL;
+    }
+clean_memspace:
+  H5Sclose (memspace);
+clean_dataspace:
+  H5Sclose (dataspace);
 wrapup:
-  H5Dclose (eeg_dataset);
   return error;
 }
 
-int
-adftool_eeg_get_data (struct adftool_file *file, size_t time_start,
-		      size_t time_length, size_t *time_max,
-		      size_t channel_start, size_t channel_length,
-		      size_t *channel_max, double *data)
+enum eeg_data_output
+{
+  EEG_DATA_OUTPUT_DOUBLE,
+  EEG_DATA_OUTPUT_FLOAT,
+  EEG_DATA_OUTPUT_RAW
+};
+
+static int
+eeg_data_get (struct adftool_file *file, size_t time_start,
+	      size_t time_length, size_t *time_max, size_t channel_start,
+	      size_t channel_length, size_t *channel_max,
+	      enum eeg_data_output output, void *data, size_t *raw_block_length,
+	      double *raw_scales, double *raw_offsets)
 {
+  /* Fill data with doubles, floats, or the codes themselves. In the
+     last case, also tell the decoder of each block. */
   int error = 0;
-  hid_t eeg_dataset = H5Dopen2 (file->hdf5_handle, "/eeg-data", H5P_DEFAULT);
+  hid_t eeg_dataset = adftool_file_eeg_dataset (file);
   if (eeg_dataset == H5I_INVALID_HID)
     {
       error = 1;
@@ -173,6 +1074,21 @@ adftool_eeg_get_data (struct adftool_file *file, size_t time_start,
     }
   *time_max = dimensions[0];
   *channel_max = dimensions[1];
+  if (output == EEG_DATA_OUTPUT_RAW)
+    {
+      hid_t block_decoders;
+      if (adftool_file_eeg_block_decoders (file, &block_decoders,
+					   raw_block_length) != 0)
+	{
+	  error = 1;
+	  goto clean_dataspace;
+	}
+      if (block_decoders == H5I_INVALID_HID)
+	{
+	  /* The whole recording is one block. */
+	  *raw_block_length = (dimensions[0] == 0 ? 1 : dimensions[0]);
+	}
+    }
   /* We are filling out rows of data. Data is a row-wise matrix, with
      channel_length columns. */
   const size_t output_row_length = channel_length;
@@ -194,133 +1110,496 @@ adftool_eeg_get_data (struct adftool_file *file, size_t time_start,
     {
       time_length = dimensions[0] - time_start;
     }
-  if (channel_length >= dimensions[1])
+  if (channel_start + channel_length > dimensions[1])
     {
       channel_length = dimensions[1] - channel_start;
     }
-  for (size_t j = channel_start; j - channel_start < channel_length; j++)
+  if (time_length == 0 || channel_length == 0)
+    {
+      goto clean_dataspace;
+    }
+  double *scales = malloc (channel_length * sizeof (double));
+  double *offsets = malloc (channel_length * sizeof (double));
+  double *block_decoders = NULL;
+  double *composed = NULL;
+  if (scales == NULL || offsets == NULL)
     {
-      struct adftool_term *identifier = term_alloc ();
-      if (identifier == NULL)
+      error = 1;
+      goto clean_decoders;
+    }
+  if (channel_decoder_table_get (file, channel_start, channel_length,
+				 scales, offsets) != 0)
+    {
+      error = 1;
+      goto clean_decoders;
+    }
+  size_t first_block, block_length, n_blocks;
+  if (eeg_data_get_block_decoders (file, time_start, time_length,
+				   channel_start, channel_length,
+				   &first_block, &block_length, &n_blocks,
+				   &block_decoders) != 0)
+    {
+      error = 1;
+      goto clean_decoders;
+    }
+  /* Compose the block decoders with the channel decoders, so that
+     each sample is decoded with a single multiply-add. For each
+     block, the composed table has the channel_length scales, then
+     the channel_length offsets. */
+  composed = malloc (n_blocks * channel_length * 2 * sizeof (double));
+  if (composed == NULL)
+    {
+      error = 1;
+      goto clean_decoders;
+    }
+  for (size_t b = 0; b < n_blocks; b++)
+    {
+      const double *block = block_decoders + b * channel_length * 2;
+      double *composed_scales = composed + b * channel_length * 2;
+      double *composed_offsets = composed_scales + channel_length;
+      for (size_t j = 0; j < channel_length; j++)
 	{
-	  error = 1;
-	  goto clean_dataspace;
+	  const double block_scale = block[2 * j];
+	  const double block_offset = block[2 * j + 1];
+	  composed_scales[j] = block_scale * scales[j];
+	  composed_offsets[j] = block_offset * scales[j] + offsets[j];
 	}
-      if (adftool_find_channel_identifier (file, j, identifier) != 0)
+    }
+  /* We want to read data starting at channel channel_start
+     (channel_length channels), time starting at time_start
+     (time_length points), all at once. */
+  hsize_t start[] = { 0, 0 };
+  hsize_t count[] = { 0, 0 };
+  start[0] = time_start;
+  start[1] = channel_start;
+  count[0] = time_length;
+  count[1] = channel_length;
+  herr_t selection_error =
+    H5Sselect_hyperslab (dataspace, H5S_SELECT_SET, start, NULL, count,
+			 NULL);
+  if (selection_error)
+    {
+      error = 1;
+      goto clean_decoders;
+    }
+  /* The memory is a dense row-wise block, with channel_length
+     columns. */
+  hid_t memspace = H5Screate_simple (2, count, count);
+  if (memspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_decoders;
+    }
+  uint16_t *encoded = malloc (time_length * channel_length
+			      * sizeof (uint16_t));
+  if (encoded == NULL)
+    {
+      error = 1;
+      goto clean_memory_space;
+    }
+  herr_t read_error = H5Dread (eeg_dataset, H5T_NATIVE_B16, memspace,
+			       dataspace, H5P_DEFAULT, encoded);
+  if (read_error < 0)
+    {
+      error = 1;
+      goto clean_encoded;
+    }
+  const enum eeg_kernels_isa isa = eeg_kernels_best_isa ();
+  for (size_t i = 0; i < time_length;)
+    {
+      /* Decode all the rows of the same block at once. */
+      const size_t block_index = (time_start + i) / block_length;
+      size_t block_end = (block_index + 1) * block_length - time_start;
+      if (block_end > time_length)
 	{
-	  error = 1;
-	  goto clean_identifier;
+	  block_end = time_length;
 	}
-      double scale, offset;
-      if (channel_decoder_get (file, identifier, &scale, &offset) != 0)
+      const double *composed_scales =
+	composed + (block_index - first_block) * channel_length * 2;
+      const double *composed_offsets = composed_scales + channel_length;
+      const uint16_t *block_encoded = encoded + i * channel_length;
+      switch (output)
 	{
-	  error = 1;
-	  goto clean_identifier;
+	case EEG_DATA_OUTPUT_DOUBLE:
+	  eeg_kernels_decode (isa, block_end - i, channel_length,
+			      block_encoded, composed_scales,
+			      composed_offsets, output_row_length,
+			      (double *) data + i * output_row_length);
+	  break;
+	case EEG_DATA_OUTPUT_FLOAT:
+	  eeg_kernels_decode_float (isa, block_end - i, channel_length,
+				    block_encoded, composed_scales,
+				    composed_offsets, output_row_length,
+				    (float *) data + i * output_row_length);
+	  break;
+	case EEG_DATA_OUTPUT_RAW:
+	  {
+	    uint16_t *raw = data;
+	    const size_t raw_block = block_index - first_block;
+	    for (size_t k = i; k < block_end; k++)
+	      {
+		memcpy (raw + k * output_row_length,
+			block_encoded + (k - i) * channel_length,
+			channel_length * sizeof (uint16_t));
+	      }
+	    memcpy (raw_scales + raw_block * output_row_length,
+		    composed_scales, channel_length * sizeof (double));
+	    memcpy (raw_offsets + raw_block * output_row_length,
+		    composed_offsets, channel_length * sizeof (double));
+	  }
+	  break;
 	}
+      i = block_end;
+    }
+clean_encoded:
+  free (encoded);
+clean_memory_space:
+  H5Sclose (memspace);
+clean_decoders:
+  free (composed);
+  free (block_decoders);
+  free (offsets);
+  free (scales);
+clean_dataspace:
+  H5Sclose (dataspace);
+wrapup:
+  return error;
+}
+
+int
+adftool_eeg_get_data (struct adftool_file *file, size_t time_start,
+		      size_t time_length, size_t *time_max,
+		      size_t channel_start, size_t channel_length,
+		      size_t *channel_max, double *data)
+{
+  return eeg_data_get (file, time_start, time_length, time_max,
+		       channel_start, channel_length, channel_max,
+		       EEG_DATA_OUTPUT_DOUBLE, data, NULL, NULL, NULL);
+}
+
+int
+adftool_eeg_get_data_float (struct adftool_file *file, size_t time_start,
+			    size_t time_length, size_t *time_max,
+			    size_t channel_start, size_t channel_length,
+			    size_t *channel_max, float *data)
+{
+  return eeg_data_get (file, time_start, time_length, time_max,
+		       channel_start, channel_length, channel_max,
+		       EEG_DATA_OUTPUT_FLOAT, data, NULL, NULL, NULL);
+}
+
+int
+adftool_eeg_get_data_raw (struct adftool_file *file, size_t time_start,
+			  size_t time_length, size_t *time_max,
+			  size_t channel_start, size_t channel_length,
+			  size_t *channel_max, uint16_t * data,
+			  size_t *block_length, double *scales,
+			  double *offsets)
+{
+  return eeg_data_get (file, time_start, time_length, time_max,
+		       channel_start, channel_length, channel_max,
+		       EEG_DATA_OUTPUT_RAW, data, block_length, scales,
+		       offsets);
+}
+
+static int
+eeg_envelope_read_level (struct adftool_file *file, size_t k,
+			 size_t bin_start, size_t n_bins, size_t channel_start,
+			 size_t channel_length, double *summaries)
+{
+  /* Read the min, max and mean of some bins of level k. */
+  int error = 0;
+  char name[64];
+  sprintf (name, "/eeg-envelope/%zu", k);
+  hid_t dataset = H5Dopen2 (file->hdf5_handle, name, H5P_DEFAULT);
+  if (dataset == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  hid_t dataspace = H5Dget_space (dataset);
+  if (dataspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_dataset;
+    }
+  const hsize_t start[3] = { bin_start, channel_start, 0 };
+  const hsize_t count[3] = { n_bins, channel_length, 3 };
+  if (H5Sselect_hyperslab (dataspace, H5S_SELECT_SET, start, NULL, count,
+			   NULL) < 0)
+    {
+      error = 1;
+      goto clean_dataspace;
+    }
+  hid_t memspace = H5Screate_simple (3, count, count);
+  if (memspace == H5I_INVALID_HID)
+    {
+      error = 1;
+      goto clean_dataspace;
+    }
+  if (H5Dread (dataset, H5T_NATIVE_DOUBLE, memspace, dataspace, H5P_DEFAULT,
+	       summaries) < 0)
+    {
+      error = 1;
+    }
+  H5Sclose (memspace);
+clean_dataspace:
+  H5Sclose (dataspace);
+clean_dataset:
+  H5Dclose (dataset);
+wrapup:
+  return error;
+}
 
-      hid_t selection_space = H5Screate_simple (2, dimensions, NULL);
-      if (selection_space == H5I_INVALID_HID)
+/* How many bins of the source are combined at once. */
+#define EEG_ENVELOPE_SLICE 4096
+
+int
+adftool_eeg_get_envelope (struct adftool_file *file, size_t time_start,
+			  size_t time_length, size_t n_pixels,
+			  size_t channel_start, size_t channel_length,
+			  size_t *first_bin, size_t *bin_length,
+			  size_t *n_bins, double *min, double *max,
+			  double *mean)
+{
+  int error = 0;
+  size_t time_max, channel_max;
+  *first_bin = 0;
+  *bin_length = 1;
+  *n_bins = 0;
+  if (adftool_eeg_get_data (file, 0, 0, &time_max, 0, 0, &channel_max, NULL)
+      != 0)
+    {
+      error = 1;
+      goto wrapup;
+    }
+  /* Same clipping as adftool_eeg_get_data. */
+  const size_t output_row_length = channel_length;
+  if (time_start >= time_max)
+    {
+      time_start = 0;
+      time_length = 0;
+    }
+  if (channel_start >= channel_max)
+    {
+      channel_start = 0;
+      channel_length = 0;
+    }
+  if (time_start + time_length > time_max)
+    {
+      time_length = time_max - time_start;
+    }
+  if (channel_start + channel_length > channel_max)
+    {
+      channel_length = channel_max - channel_start;
+    }
+  if (time_length == 0 || channel_length == 0 || n_pixels == 0)
+    {
+      goto wrapup;
+    }
+  /* Pick the smallest power of two such that there are at most
+     n_pixels + 1 bins. */
+  const size_t per_pixel = (time_length + n_pixels - 1) / n_pixels;
+  while (*bin_length < per_pixel)
+    {
+      *bin_length *= 2;
+    }
+  *first_bin = time_start / *bin_length;
+  *n_bins = (time_start + time_length - 1) / *bin_length - *first_bin + 1;
+  /* The source is the coarsest level whose bins divide the requested
+     bins. If there is none, summarize the raw data. */
+  bool use_level = false;
+  size_t level = 0;
+  size_t source_length = 1;
+  if (*bin_length >= EEG_ENVELOPE_BASE_BIN
+      && H5Lexists (file->hdf5_handle, "/eeg-envelope", H5P_DEFAULT) > 0)
+    {
+      use_level = true;
+      source_length = EEG_ENVELOPE_BASE_BIN;
+      while (level + 1 < EEG_ENVELOPE_N_LEVELS
+	     && 2 * source_length <= *bin_length)
 	{
-	  error = 1;
-	  goto clean_identifier;
-	}
-      /* We want to read data starting at channel j (1 channel), time
-         starting at time_start (time_length points) */
-      hsize_t start[] = { 0, 0 };
-      hsize_t count[] = { 0, 1 };
-      start[0] = time_start;
-      start[1] = j;
-      count[0] = time_length;
-      herr_t selection_error =
-	H5Sselect_hyperslab (selection_space, H5S_SELECT_AND, start, NULL,
-			     count, NULL);
-      if (selection_error)
+	  level++;
+	  source_length *= 2;
+	}
+    }
+  const size_t factor = *bin_length / source_length;
+  const size_t n_source = (time_max + source_length - 1) / source_length;
+  size_t source_end = (*first_bin + *n_bins) * factor;
+  if (source_end > n_source)
+    {
+      source_end = n_source;
+    }
+  double *weights = malloc (*n_bins * sizeof (double));
+  double *summaries =
+    malloc (EEG_ENVELOPE_SLICE * channel_length * 3 * sizeof (double));
+  double *scales = malloc (channel_length * sizeof (double));
+  double *offsets = malloc (channel_length * sizeof (double));
+  if (weights == NULL || summaries == NULL || scales == NULL
+      || offsets == NULL)
+    {
+      error = 1;
+      goto cleanup;
+    }
+  for (size_t b = 0; b < *n_bins; b++)
+    {
+      weights[b] = 0;
+      for (size_t j = 0; j < channel_length; j++)
 	{
-	  error = 1;
-	  goto clean_selection_space;
+	  min[b * output_row_length + j] = DBL_MAX;
+	  max[b * output_row_length + j] = -DBL_MAX;
+	  mean[b * output_row_length + j] = 0;
 	}
-      /* We want to store the result in an array of length
-         time_length. */
-      hsize_t mem_length = time_length;
-      hid_t memspace = H5Screate_simple (1, &mem_length, &mem_length);
-      if (memspace == H5I_INVALID_HID)
+    }
+  for (size_t slice_start = *first_bin * factor; slice_start < source_end;
+       slice_start += EEG_ENVELOPE_SLICE)
+    {
+      size_t slice_length = source_end - slice_start;
+      if (slice_length > EEG_ENVELOPE_SLICE)
 	{
-	  error = 1;
-	  goto clean_selection_space;
+	  slice_length = EEG_ENVELOPE_SLICE;
 	}
-      uint16_t *encoded = malloc (time_length * sizeof (uint16_t));
-      if (encoded == NULL)
+      if (use_level)
 	{
-	  error = 1;
-	  goto clean_memory_space;
+	  if (eeg_envelope_read_level (file, level, slice_start,
+				       slice_length, channel_start,
+				       channel_length, summaries) != 0)
+	    {
+	      error = 1;
+	      goto cleanup;
+	    }
 	}
-      herr_t read_error =
-	H5Dread (eeg_dataset, H5T_NATIVE_B16, memspace, selection_space,
-		 H5P_DEFAULT, encoded);
-      if (read_error < 0)
+      else
 	{
-	  error = 1;
-	  goto clean_encoded;
-	}
-      for (size_t i = time_start; i - time_start < time_length; i++)
-	{
-	  const size_t time_index = i - time_start;
-	  const size_t channel_index = j - channel_start;
-	  const size_t index = time_index * output_row_length + channel_index;
-	  const double raw = encoded[i - time_start];
-	  const double scaled = raw * scale + offset;
-	  data[index] = scaled;
-	}
-    clean_encoded:
-      free (encoded);
-    clean_memory_space:
-      H5Sclose (memspace);
-    clean_selection_space:
-      H5Sclose (selection_space);
-    clean_identifier:
-      term_free (identifier);
-      if (error)
+	  /* The raw values are their own summary. Read them at the end
+	     of the buffer, and spread them. */
+	  double *values = summaries + 2 * slice_length * channel_length;
+	  size_t check_time, check_channel;
+	  if (adftool_eeg_get_data (file, slice_start, slice_length,
+				    &check_time, channel_start,
+				    channel_length, &check_channel,
+				    values) != 0)
+	    {
+	      error = 1;
+	      goto cleanup;
+	    }
+	  for (size_t k = 0; k < slice_length * channel_length; k++)
+	    {
+	      const double value = values[k];
+	      summaries[3 * k] = value;
+	      summaries[3 * k + 1] = value;
+	      summaries[3 * k + 2] = value;
+	    }
+	}
+      for (size_t i = 0; i < slice_length; i++)
 	{
-	  goto clean_dataspace;
+	  const size_t source_index = slice_start + i;
+	  const size_t b = source_index / factor - *first_bin;
+	  /* The last source bin may be incomplete. */
+	  double weight = source_length;
+	  if ((source_index + 1) * source_length > time_max)
+	    {
+	      weight = time_max - source_index * source_length;
+	    }
+	  weights[b] += weight;
+	  const double *summary = summaries + i * channel_length * 3;
+	  double *bin_min = min + b * output_row_length;
+	  double *bin_max = max + b * output_row_length;
+	  double *bin_mean = mean + b * output_row_length;
+	  for (size_t j = 0; j < channel_length; j++)
+	    {
+	      if (summary[3 * j] < bin_min[j])
+		{
+		  bin_min[j] = summary[3 * j];
+		}
+	      if (summary[3 * j + 1] > bin_max[j])
+		{
+		  bin_max[j] = summary[3 * j + 1];
+		}
+	      bin_mean[j] += summary[3 * j + 2] * weight;
+	    }
 	}
     }
-clean_dataspace:
-  H5Sclose (dataspace);
+  if (use_level
+      && channel_decoder_table_get (file, channel_start, channel_length,
+				    scales, offsets) != 0)
+    {
+      error = 1;
+      goto cleanup;
+    }
+  for (size_t b = 0; b < *n_bins; b++)
+    {
+      double *bin_min = min + b * output_row_length;
+      double *bin_max = max + b * output_row_length;
+      double *bin_mean = mean + b * output_row_length;
+      for (size_t j = 0; j < channel_length; j++)
+	{
+	  bin_mean[j] /= weights[b];
+	  if (use_level)
+	    {
+	      /* The envelope is not calibrated yet. */
+	      const double low = bin_min[j] * scales[j] + offsets[j];
+	      const double high = bin_max[j] * scales[j] + offsets[j];
+	      bin_min[j] = (low < high ? low : high);
+	      bin_max[j] = (low < high ? high : low);
+	      bin_mean[j] = bin_mean[j] * scales[j] + offsets[j];
+	    }
+	}
+    }
+cleanup:
+  free (offsets);
+  free (scales);
+  free (summaries);
+  free (weights);
 wrapup:
-  H5Dclose (eeg_dataset);
   return error;
 }
 
 static void
-compute_encoding (size_t n, size_t p, size_t j, const double *data,
-		  double *offset, double *scale)
+compute_encoding (size_t n, size_t p, const double *data, double *offsets,
+		  double *scales)
 {
-  double mini = DBL_MAX;
-  double maxi = -DBL_MAX;
+  /* Scan the rows of the block in order, to find the range of each
+     of the p channels. */
+  for (size_t j = 0; j < p; j++)
+    {
+      offsets[j] = DBL_MAX;
+      scales[j] = -DBL_MAX;
+    }
+  double *mini = offsets;
+  double *maxi = scales;
   for (size_t i = 0; i < n; i++)
     {
-      const double value = data[i * p + j];
-      if (value < mini)
+      const double *row = data + i * p;
+      for (size_t j = 0; j < p; j++)
 	{
-	  mini = value;
-	}
-      if (value > maxi)
-	{
-	  maxi = value;
+	  if (row[j] < mini[j])
+	    {
+	      mini[j] = row[j];
+	    }
+	  if (row[j] > maxi[j])
+	    {
+	      maxi[j] = row[j];
+	    }
 	}
     }
   const double input_mini = 0;
   const double input_maxi = 65535;
-  /* Now find offset and scale such that: */
-  /* input_maxi * scale + offset = maxi */
-  /* input_mini * scale + offset = mini */
+  for (size_t j = 0; j < p; j++)
+    {
+      const double block_mini = mini[j];
+      const double block_maxi = maxi[j];
+      /* Now find offset and scale such that: */
+      /* input_maxi * scale + offset = maxi */
+      /* input_mini * scale + offset = mini */
 
-  /* Take the difference: */
-  /* (input_maxi - input_mini) * scale = maxi - mini */
-  *scale = (maxi - mini) / (input_maxi - input_mini);
+      /* Take the difference: */
+      /* (input_maxi - input_mini) * scale = maxi - mini */
+      scales[j] = (block_maxi - block_mini) / (input_maxi - input_mini);
 
-  /* Replace: */
-  *offset = maxi - input_maxi * (*scale);
+      /* Replace: */
+      offsets[j] = block_maxi - input_maxi * scales[j];
+    }
 }
 
 static struct adftool_statement *
@@ -0,0 +1,483 @@
+#ifndef H_ADFTOOL_EEG_KERNELS_INCLUDED
+# define H_ADFTOOL_EEG_KERNELS_INCLUDED
+
+# include <stdlib.h>
+# include <stdint.h>
+# include <stdbool.h>
+
+/* Conversion kernels between the 16-bit codes of /eeg-data and
+   doubles. There is a portable version of each kernel, and, on x86
+   with GCC, SSE2 and AVX2 versions, picked at run time. */
+
+# if defined __GNUC__ && (defined __x86_64__ || defined __i386__) \
+  && !defined __EMSCRIPTEN__
+#  define EEG_KERNELS_X86 1
+#  include <immintrin.h>
+#  define EEG_KERNELS_TARGET(isa) __attribute__ ((target (isa)))
+# endif
+
+enum eeg_kernels_isa
+{
+  EEG_KERNELS_SCALAR = 0,
+  EEG_KERNELS_SSE2,
+  EEG_KERNELS_AVX2
+};
+
+MAYBE_UNUSED static bool eeg_kernels_isa_supported (enum eeg_kernels_isa
+						    isa);
+
+MAYBE_UNUSED static enum eeg_kernels_isa eeg_kernels_best_isa (void);
+
+/* Decode a dense row-major block of n_rows × n_columns codes. Row i
+   of the output starts at output + i * output_stride. */
+MAYBE_UNUSED static void eeg_kernels_decode (enum eeg_kernels_isa isa,
+					     size_t n_rows,
+					     size_t n_columns,
+					     const uint16_t * encoded,
+					     const double *scales,
+					     const double *offsets,
+					     size_t output_stride,
+					     double *output);
+
+/* Same, but with single precision output. The values are computed
+   in double precision, then rounded. */
+MAYBE_UNUSED static void eeg_kernels_decode_float (enum eeg_kernels_isa
+						   isa, size_t n_rows,
+						   size_t n_columns,
+						   const uint16_t * encoded,
+						   const double *scales,
+						   const double *offsets,
+						   size_t output_stride,
+						   float *output);
+
+/* Encode a dense row-major block of n_rows × n_columns values, with
+   code = (value - offset) * inverse_scale, rounded to the nearest
+   integer and clipped to [0, 65535]. NaN is encoded as 0. */
+MAYBE_UNUSED static void eeg_kernels_encode (enum eeg_kernels_isa isa,
+					     size_t n_rows,
+					     size_t n_columns,
+					     const double *data,
+					     const double *offsets,
+					     const double *inverse_scales,
+					     uint16_t * encoded);
+
+static inline double
+eeg_kernels_decode_one (uint16_t code, double scale, double offset)
+{
+  const double raw = code;
+  return raw * scale + offset;
+}
+
+static inline uint16_t
+eeg_kernels_encode_one (double value, double offset, double inverse_scale)
+{
+  double code = (value - offset) * inverse_scale + 0.5;
+  if (!(code >= 0))
+    {
+      code = 0;
+    }
+  if (code > 65535)
+    {
+      code = 65535;
+    }
+  return (uint16_t) code;
+}
+
+static inline void
+eeg_kernels_decode_scalar (size_t n_rows, size_t n_columns,
+			   size_t column_start, const uint16_t * encoded,
+			   const double *scales, const double *offsets,
+			   size_t output_stride, double *output)
+{
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      const uint16_t *encoded_row = encoded + i * n_columns;
+      double *output_row = output + i * output_stride;
+      for (size_t j = column_start; j < n_columns; j++)
+	{
+	  output_row[j] =
+	    eeg_kernels_decode_one (encoded_row[j], scales[j], offsets[j]);
+	}
+    }
+}
+
+static inline void
+eeg_kernels_decode_float_scalar (size_t n_rows, size_t n_columns,
+				 size_t column_start,
+				 const uint16_t * encoded,
+				 const double *scales, const double *offsets,
+				 size_t output_stride, float *output)
+{
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      const uint16_t *encoded_row = encoded + i * n_columns;
+      float *output_row = output + i * output_stride;
+      for (size_t j = column_start; j < n_columns; j++)
+	{
+	  output_row[j] =
+	    eeg_kernels_decode_one (encoded_row[j], scales[j], offsets[j]);
+	}
+    }
+}
+
+static inline void
+eeg_kernels_encode_scalar (size_t n_rows, size_t n_columns,
+			   size_t column_start, const double *data,
+			   const double *offsets,
+			   const double *inverse_scales, uint16_t * encoded)
+{
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      const double *row = data + i * n_columns;
+      uint16_t *encoded_row = encoded + i * n_columns;
+      for (size_t j = column_start; j < n_columns; j++)
+	{
+	  encoded_row[j] =
+	    eeg_kernels_encode_one (row[j], offsets[j], inverse_scales[j]);
+	}
+    }
+}
+
+# ifdef EEG_KERNELS_X86
+
+EEG_KERNELS_TARGET ("sse2") static void
+eeg_kernels_decode_sse2 (size_t n_rows, size_t n_columns,
+			 const uint16_t * encoded,
+			 const double *scales, const double *offsets,
+			 size_t output_stride, double *output)
+{
+  const size_t n_vectorized = n_columns - n_columns % 8;
+  const __m128i zero = _mm_setzero_si128 ();
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      const uint16_t *encoded_row = encoded + i * n_columns;
+      double *output_row = output + i * output_stride;
+      for (size_t j = 0; j < n_vectorized; j += 8)
+	{
+	  const __m128i codes =
+	    _mm_loadu_si128 ((const __m128i *) (encoded_row + j));
+	  const __m128i low = _mm_unpacklo_epi16 (codes, zero);
+	  const __m128i high = _mm_unpackhi_epi16 (codes, zero);
+	  const __m128d parts[4] = {
+	    _mm_cvtepi32_pd (low),
+	    _mm_cvtepi32_pd (_mm_srli_si128 (low, 8)),
+	    _mm_cvtepi32_pd (high),
+	    _mm_cvtepi32_pd (_mm_srli_si128 (high, 8))
+	  };
+	  for (size_t k = 0; k < 4; k++)
+	    {
+	      const __m128d scale = _mm_loadu_pd (scales + j + 2 * k);
+	      const __m128d offset = _mm_loadu_pd (offsets + j + 2 * k);
+	      _mm_storeu_pd (output_row + j + 2 * k,
+			     _mm_add_pd (_mm_mul_pd (parts[k], scale),
+					 offset));
+	    }
+	}
+    }
+  eeg_kernels_decode_scalar (n_rows, n_columns, n_vectorized, encoded,
+			     scales, offsets, output_stride, output);
+}
+
+EEG_KERNELS_TARGET ("avx2") static void
+eeg_kernels_decode_avx2 (size_t n_rows, size_t n_columns,
+			 const uint16_t * encoded,
+			 const double *scales, const double *offsets,
+			 size_t output_stride, double *output)
+{
+  const size_t n_vectorized = n_columns - n_columns % 8;
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      const uint16_t *encoded_row = encoded + i * n_columns;
+      double *output_row = output + i * output_stride;
+      for (size_t j = 0; j < n_vectorized; j += 8)
+	{
+	  const __m256i codes =
+	    _mm256_cvtepu16_epi32 (_mm_loadu_si128
+				   ((const __m128i *) (encoded_row + j)));
+	  const __m256d low =
+	    _mm256_cvtepi32_pd (_mm256_castsi256_si128 (codes));
+	  const __m256d high =
+	    _mm256_cvtepi32_pd (_mm256_extracti128_si256 (codes, 1));
+	  _mm256_storeu_pd (output_row + j,
+			    _mm256_add_pd (_mm256_mul_pd
+					   (low, _mm256_loadu_pd (scales + j)),
+					   _mm256_loadu_pd (offsets + j)));
+	  _mm256_storeu_pd (output_row + j + 4,
+			    _mm256_add_pd (_mm256_mul_pd
+					   (high,
+					    _mm256_loadu_pd (scales + j + 4)),
+					   _mm256_loadu_pd (offsets + j + 4)));
+	}
+    }
+  eeg_kernels_decode_scalar (n_rows, n_columns, n_vectorized, encoded,
+			     scales, offsets, output_stride, output);
+}
+
+EEG_KERNELS_TARGET ("sse2") static void
+eeg_kernels_decode_float_sse2 (size_t n_rows, size_t n_columns,
+			       const uint16_t * encoded,
+			       const double *scales, const double *offsets,
+			       size_t output_stride, float *output)
+{
+  const size_t n_vectorized = n_columns - n_columns % 4;
+  const __m128i zero = _mm_setzero_si128 ();
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      const uint16_t *encoded_row = encoded + i * n_columns;
+      float *output_row = output + i * output_stride;
+      for (size_t j = 0; j < n_vectorized; j += 4)
+	{
+	  const __m128i codes =
+	    _mm_unpacklo_epi16 (_mm_loadl_epi64
+				((const __m128i *) (encoded_row + j)), zero);
+	  const __m128d low =
+	    _mm_add_pd (_mm_mul_pd (_mm_cvtepi32_pd (codes),
+				    _mm_loadu_pd (scales + j)),
+			_mm_loadu_pd (offsets + j));
+	  const __m128d high =
+	    _mm_add_pd (_mm_mul_pd
+			(_mm_cvtepi32_pd (_mm_srli_si128 (codes, 8)),
+			 _mm_loadu_pd (scales + j + 2)),
+			_mm_loadu_pd (offsets + j + 2));
+	  _mm_storeu_ps (output_row + j,
+			 _mm_movelh_ps (_mm_cvtpd_ps (low),
+					_mm_cvtpd_ps (high)));
+	}
+    }
+  eeg_kernels_decode_float_scalar (n_rows, n_columns, n_vectorized,
+				   encoded, scales, offsets, output_stride,
+				   output);
+}
+
+EEG_KERNELS_TARGET ("avx2") static void
+eeg_kernels_decode_float_avx2 (size_t n_rows, size_t n_columns,
+			       const uint16_t * encoded,
+			       const double *scales, const double *offsets,
+			       size_t output_stride, float *output)
+{
+  const size_t n_vectorized = n_columns - n_columns % 8;
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      const uint16_t *encoded_row = encoded + i * n_columns;
+      float *output_row = output + i * output_stride;
+      for (size_t j = 0; j < n_vectorized; j += 8)
+	{
+	  const __m256i codes =
+	    _mm256_cvtepu16_epi32 (_mm_loadu_si128
+				   ((const __m128i *) (encoded_row + j)));
+	  const __m256d low =
+	    _mm256_add_pd (_mm256_mul_pd
+			   (_mm256_cvtepi32_pd
+			    (_mm256_castsi256_si128 (codes)),
+			    _mm256_loadu_pd (scales + j)),
+			   _mm256_loadu_pd (offsets + j));
+	  const __m256d high =
+	    _mm256_add_pd (_mm256_mul_pd
+			   (_mm256_cvtepi32_pd
+			    (_mm256_extracti128_si256 (codes, 1)),
+			    _mm256_loadu_pd (scales + j + 4)),
+			   _mm256_loadu_pd (offsets + j + 4));
+	  _mm_storeu_ps (output_row + j, _mm256_cvtpd_ps (low));
+	  _mm_storeu_ps (output_row + j + 4, _mm256_cvtpd_ps (high));
+	}
+    }
+  eeg_kernels_decode_float_scalar (n_rows, n_columns, n_vectorized,
+				   encoded, scales, offsets, output_stride,
+				   output);
+}
+
+EEG_KERNELS_TARGET ("sse2") static void
+eeg_kernels_encode_sse2 (size_t n_rows, size_t n_columns,
+			 const double *data, const double *offsets,
+			 const double *inverse_scales,
+			 uint16_t * encoded)
+{
+  const size_t n_vectorized = n_columns - n_columns % 8;
+  const __m128d zero = _mm_setzero_pd ();
+  const __m128d half = _mm_set1_pd (0.5);
+  const __m128d maximum = _mm_set1_pd (65535);
+  /* SSE2 can only pack signed integers. */
+  const __m128i bias_32 = _mm_set1_epi32 (32768);
+  const __m128i bias_16 = _mm_set1_epi16 ((short) 0x8000);
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      const double *row = data + i * n_columns;
+      uint16_t *encoded_row = encoded + i * n_columns;
+      for (size_t j = 0; j < n_vectorized; j += 8)
+	{
+	  __m128i parts[4];
+	  for (size_t k = 0; k < 4; k++)
+	    {
+	      const size_t column = j + 2 * k;
+	      __m128d code =
+		_mm_sub_pd (_mm_loadu_pd (row + column),
+			    _mm_loadu_pd (offsets + column));
+	      code =
+		_mm_add_pd (_mm_mul_pd
+			    (code, _mm_loadu_pd (inverse_scales + column)),
+			    half);
+	      /* If code is NaN, max returns its second operand. */
+	      code = _mm_min_pd (_mm_max_pd (code, zero), maximum);
+	      parts[k] = _mm_cvttpd_epi32 (code);
+	    }
+	  const __m128i low =
+	    _mm_sub_epi32 (_mm_unpacklo_epi64 (parts[0], parts[1]), bias_32);
+	  const __m128i high =
+	    _mm_sub_epi32 (_mm_unpacklo_epi64 (parts[2], parts[3]), bias_32);
+	  const __m128i codes = _mm_xor_si128 (_mm_packs_epi32 (low, high),
+					       bias_16);
+	  _mm_storeu_si128 ((__m128i *) (encoded_row + j), codes);
+	}
+    }
+  eeg_kernels_encode_scalar (n_rows, n_columns, n_vectorized, data, offsets,
+			     inverse_scales, encoded);
+}
+
+EEG_KERNELS_TARGET ("avx2") static void
+eeg_kernels_encode_avx2 (size_t n_rows, size_t n_columns,
+			 const double *data, const double *offsets,
+			 const double *inverse_scales,
+			 uint16_t * encoded)
+{
+  const size_t n_vectorized = n_columns - n_columns % 8;
+  const __m256d zero = _mm256_setzero_pd ();
+  const __m256d half = _mm256_set1_pd (0.5);
+  const __m256d maximum = _mm256_set1_pd (65535);
+  for (size_t i = 0; i < n_rows; i++)
+    {
+      const double *row = data + i * n_columns;
+      uint16_t *encoded_row = encoded + i * n_columns;
+      for (size_t j = 0; j < n_vectorized; j += 8)
+	{
+	  __m128i parts[2];
+	  for (size_t k = 0; k < 2; k++)
+	    {
+	      const size_t column = j + 4 * k;
+	      __m256d code =
+		_mm256_sub_pd (_mm256_loadu_pd (row + column),
+			       _mm256_loadu_pd (offsets + column));
+	      code =
+		_mm256_add_pd (_mm256_mul_pd
+			       (code,
+				_mm256_loadu_pd (inverse_scales + column)),
+			       half);
+	      /* If code is NaN, max returns its second operand. */
+	      code = _mm256_min_pd (_mm256_max_pd (code, zero), maximum);
+	      parts[k] = _mm256_cvttpd_epi32 (code);
+	    }
+	  _mm_storeu_si128 ((__m128i *) (encoded_row + j),
+			    _mm_packus_epi32 (parts[0], parts[1]));
+	}
+    }
+  eeg_kernels_encode_scalar (n_rows, n_columns, n_vectorized, data, offsets,
+			     inverse_scales, encoded);
+}
+
+# endif/* EEG_KERNELS_X86 */
+
+static bool
+eeg_kernels_isa_supported (enum eeg_kernels_isa isa)
+{
+  switch (isa)
+    {
+    case EEG_KERNELS_SCALAR:
+      return true;
+# ifdef EEG_KERNELS_X86
+    case EEG_KERNELS_SSE2:
+      return __builtin_cpu_supports ("sse2");
+    case EEG_KERNELS_AVX2:
+      return __builtin_cpu_supports ("avx2");
+# endif
+    default:
+      return false;
+    }
+}
+
+static enum eeg_kernels_isa
+eeg_kernels_best_isa (void)
+{
+  if (eeg_kernels_isa_supported (EEG_KERNELS_AVX2))
+    {
+      return EEG_KERNELS_AVX2;
+    }
+  if (eeg_kernels_isa_supported (EEG_KERNELS_SSE2))
+    {
+      return EEG_KERNELS_SSE2;
+    }
+  return EEG_KERNELS_SCALAR;
+}
+
+static void
+eeg_kernels_decode (enum eeg_kernels_isa isa, size_t n_rows,
+		    size_t n_columns, const uint16_t * encoded,
+		    const double *scales, const double *offsets,
+		    size_t output_stride, double *output)
+{
+  switch (isa)
+    {
+# ifdef EEG_KERNELS_X86
+    case EEG_KERNELS_AVX2:
+      eeg_kernels_decode_avx2 (n_rows, n_columns, encoded, scales, offsets,
+			       output_stride, output);
+      break;
+    case EEG_KERNELS_SSE2:
+      eeg_kernels_decode_sse2 (n_rows, n_columns, encoded, scales, offsets,
+			       output_stride, output);
+      break;
+# endif
+    default:
+      eeg_kernels_decode_scalar (n_rows, n_columns, 0, encoded, scales,
+				 offsets, output_stride, output);
+    }
+}
+
+static void
+eeg_kernels_decode_float (enum eeg_kernels_isa isa, size_t n_rows,
+			  size_t n_columns, const uint16_t * encoded,
+			  const double *scales, const double *offsets,
+			  size_t output_stride, float *output)
+{
+  switch (isa)
+    {
+# ifdef EEG_KERNELS_X86
+    case EEG_KERNELS_AVX2:
+      eeg_kernels_decode_float_avx2 (n_rows, n_columns, encoded, scales,
+				     offsets, output_stride, output);
+      break;
+    case EEG_KERNELS_SSE2:
+      eeg_kernels_decode_float_sse2 (n_rows, n_columns, encoded, scales,
+				     offsets, output_stride, output);
+      break;
+# endif
+    default:
+      eeg_kernels_decode_float_scalar (n_rows, n_columns, 0, encoded,
+				       scales, offsets, output_stride,
+				       output);
+    }
+}
+
+static void
+eeg_kernels_encode (enum eeg_kernels_isa isa, size_t n_rows,
+		    size_t n_columns, const double *data,
+		    const double *offsets, const double *inverse_scales,
+		    uint16_t * encoded)
+{
+  switch (isa)
+    {
+# ifdef EEG_KERNELS_X86
+    case EEG_KERNELS_AVX2:
+      eeg_kernels_encode_avx2 (n_rows, n_columns, data, offsets,
+			       inverse_scales, encoded);
+      break;
+    case EEG_KERNELS_SSE2:
+      eeg_kernels_encode_sse2 (n_rows, n_columns, data, offsets,
+			       inverse_scales, encoded);
+      break;
+# endif
+    default:
+      eeg_kernels_encode_scalar (n_rows, n_columns, 0, data, offsets,
+				 inverse_scales, encoded);
+    }
+}
+
+#endif /* H_ADFTOOL_EEG_KERNELS_INCLUDED */
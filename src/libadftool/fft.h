@@ -0,0 +1,180 @@
+#ifndef H_ADFTOOL_FFT_INCLUDED
+# define H_ADFTOOL_FFT_INCLUDED
+
+# include <stdlib.h>
+# include <stdbool.h>
+# include <math.h>
+
+/* A radix-2 complex FFT. Complex numbers are stored as pairs of
+   doubles (real part, imaginary part). The transform size n must be
+   a power of 2. */
+
+MAYBE_UNUSED static size_t fft_size_at_least (size_t n);
+
+/* Fill the n / 2 twiddle factors exp (-2 i pi k / n). */
+MAYBE_UNUSED static void fft_twiddles (size_t n, double *twiddles);
+
+/* Transform data in place. The inverse transform is not scaled. */
+MAYBE_UNUSED static void fft_transform (size_t n, const double *twiddles,
+					bool inverse, double *data);
+
+/* Fill the 2 n values of spectrum with the transform of the
+   symmetric filter of 2 half_m + 1 coefficients, coef_0 in the
+   middle and coefficients on each side, delayed by half_m and scaled
+   by 1 / n. */
+MAYBE_UNUSED static void fft_filter_spectrum (size_t n,
+					      const double *twiddles,
+					      size_t half_m, double coef_0,
+					      const double *coefficients,
+					      double *spectrum);
+
+/* Filter signal by overlap-save, with the spectrum of a filter of 2
+   half_m + 1 coefficients, and zeros outside of the signal. work
+   holds 2 n values. */
+MAYBE_UNUSED static void fft_overlap_save (size_t n, const double *twiddles,
+					   const double *spectrum,
+					   size_t half_m,
+					   size_t signal_length,
+					   const double *signal,
+					   double *filtered, double *work);
+
+static size_t
+fft_size_at_least (size_t n)
+{
+  size_t size = 1;
+  while (size < n)
+    {
+      size *= 2;
+    }
+  return size;
+}
+
+static void
+fft_twiddles (size_t n, double *twiddles)
+{
+  for (size_t k = 0; k < n / 2; k++)
+    {
+      const double angle = -2 * M_PI * k / n;
+      twiddles[2 * k] = cos (angle);
+      twiddles[2 * k + 1] = sin (angle);
+    }
+}
+
+static void
+fft_transform (size_t n, const double *twiddles, bool inverse, double *data)
+{
+  /* Bit-reversal permutation. */
+  for (size_t i = 1, j = 0; i < n; i++)
+    {
+      size_t bit = n >> 1;
+      for (; j & bit; bit >>= 1)
+	{
+	  j ^= bit;
+	}
+      j ^= bit;
+      if (i < j)
+	{
+	  const double re = data[2 * i];
+	  const double im = data[2 * i + 1];
+	  data[2 * i] = data[2 * j];
+	  data[2 * i + 1] = data[2 * j + 1];
+	  data[2 * j] = re;
+	  data[2 * j + 1] = im;
+	}
+    }
+  const double sign = (inverse ? -1 : 1);
+  for (size_t length = 2; length <= n; length *= 2)
+    {
+      const size_t half = length / 2;
+      const size_t stride = n / length;
+      for (size_t start = 0; start < n; start += length)
+	{
+	  double *low = data + 2 * start;
+	  double *high = data + 2 * (start + half);
+	  for (size_t k = 0; k < half; k++)
+	    {
+	      const double w_re = twiddles[2 * k * stride];
+	      const double w_im = sign * twiddles[2 * k * stride + 1];
+	      const double t_re = high[2 * k] * w_re - high[2 * k + 1] * w_im;
+	      const double t_im = high[2 * k] * w_im + high[2 * k + 1] * w_re;
+	      high[2 * k] = low[2 * k] - t_re;
+	      high[2 * k + 1] = low[2 * k + 1] - t_im;
+	      low[2 * k] += t_re;
+	      low[2 * k + 1] += t_im;
+	    }
+	}
+    }
+}
+
+static void
+fft_filter_spectrum (size_t n, const double *twiddles, size_t half_m,
+		     double coef_0, const double *coefficients,
+		     double *spectrum)
+{
+  for (size_t i = 0; i < 2 * n; i++)
+    {
+      spectrum[i] = 0;
+    }
+  spectrum[2 * half_m] = coef_0 / n;
+  for (size_t i = 0; i < half_m; i++)
+    {
+      const double coef = coefficients[i] / n;
+      spectrum[2 * (half_m - i - 1)] = coef;
+      spectrum[2 * (half_m + i + 1)] = coef;
+    }
+  fft_transform (n, twiddles, false, spectrum);
+}
+
+/* Each block of n samples produces n - order + 1 outputs. Since the
+   signal is real, two blocks are transformed at once, one in the real
+   part and the other in the imaginary part. */
+static void
+fft_overlap_save (size_t n, const double *twiddles, const double *spectrum,
+		  size_t half_m, size_t signal_length, const double *signal,
+		  double *filtered, double *work)
+{
+  const size_t order = 2 * half_m + 1;
+  const size_t step = n - order + 1;
+  for (size_t start = 0; start < signal_length; start += 2 * step)
+    {
+      /* The output i needs the inputs from i - half_m to i + half_m;
+         the block for output start begins at start - half_m. */
+      for (size_t k = 0; k < n; k++)
+	{
+	  for (size_t part = 0; part < 2; part++)
+	    {
+	      const size_t position = start + part * step + k;
+	      double value = 0;
+	      if (position >= half_m && position - half_m < signal_length)
+		{
+		  value = signal[position - half_m];
+		}
+	      work[2 * k + part] = value;
+	    }
+	}
+      fft_transform (n, twiddles, false, work);
+      for (size_t k = 0; k < n; k++)
+	{
+	  const double re = work[2 * k];
+	  const double im = work[2 * k + 1];
+	  const double h_re = spectrum[2 * k];
+	  const double h_im = spectrum[2 * k + 1];
+	  work[2 * k] = re * h_re - im * h_im;
+	  work[2 * k + 1] = re * h_im + im * h_re;
+	}
+      fft_transform (n, twiddles, true, work);
+      for (size_t part = 0; part < 2; part++)
+	{
+	  for (size_t k = 0; k < step; k++)
+	    {
+	      const size_t i = start + part * step + k;
+	      if (i < signal_length)
+		{
+		  filtered[i] = work[2 * (order - 1 + k) + part];
+		}
+	    }
+	}
+    }
+}
+
+#endif /* H_ADFTOOL_FFT_INCLUDED */
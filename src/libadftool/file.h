@@ -77,12 +77,48 @@ static inline
   int adftool_file_insert (struct adftool_file *file,
 			   const struct adftool_statement *statement);
 
+MAYBE_UNUSED static hid_t adftool_file_eeg_dataset (struct adftool_file
+						    *file);
+
+MAYBE_UNUSED static void adftool_file_eeg_dataset_close (struct adftool_file
+							 *file);
+
+MAYBE_UNUSED static int adftool_file_eeg_block_decoders (struct adftool_file
+							 *file,
+							 hid_t * dataset,
+							 size_t *
+							 block_length);
+
+MAYBE_UNUSED static void adftool_file_eeg_decoders_invalidate (struct
+							       adftool_file
+							       *file);
+
+/* The channel decoders, indexed by column. They are only valid until
+   the next modification of the file. */
+struct adftool_file_eeg_decoders
+{
+  bool valid;
+  size_t n_channels;
+  /* NULL if the column has no identifier or no decoder. */
+  struct adftool_term **identifiers;
+  double *scales;
+  double *offsets;
+};
+
 struct adftool_file
 {
   hid_t hdf5_handle;
   struct adftool_dictionary_index *dictionary;
   struct adftool_quads *quads;
   struct adftool_quads_index *indices[6];
+  /* The /eeg-data dataset is kept open once it has been opened, so
+     that the HDF5 chunk cache survives from one read to the next. */
+  hid_t eeg_dataset;
+  /* /eeg-block-decoders is also kept open. It is absent from files
+     written by older versions of adftool. */
+  hid_t eeg_block_decoders;
+  size_t eeg_block_length;
+  struct adftool_file_eeg_decoders eeg_decoders;
 };
 
 static struct adftool_file *
@@ -95,6 +131,14 @@ adftool_file_alloc (hid_t file, size_t default_order,
       goto error;
     }
   ret->hdf5_handle = file;
+  ret->eeg_dataset = H5I_INVALID_HID;
+  ret->eeg_block_decoders = H5I_INVALID_HID;
+  ret->eeg_block_length = 0;
+  ret->eeg_decoders.valid = false;
+  ret->eeg_decoders.n_channels = 0;
+  ret->eeg_decoders.identifiers = NULL;
+  ret->eeg_decoders.scales = NULL;
+  ret->eeg_decoders.offsets = NULL;
   if (file == H5I_INVALID_HID)
     {
       goto cleanup;
@@ -256,6 +300,8 @@ adftool_file_free (struct adftool_file *file)
 {
   if (file != NULL)
     {
+      adftool_file_eeg_decoders_invalidate (file);
+      adftool_file_eeg_dataset_close (file);
       for (size_t i = 0; i < 6; i++)
 	{
 	  adftool_quads_index_free (file->indices[i]);
@@ -267,6 +313,117 @@ adftool_file_free (struct adftool_file *file)
   free (file);
 }
 
+/* The chunk cache must be able to hold a full row of chunks for a
+   typical montage, so that reading the channels one by one does not
+   decompress the same chunks over and over. */
+# define EEG_DATASET_CHUNK_CACHE_SLOTS 1021
+# define EEG_DATASET_CHUNK_CACHE_BYTES (16 * 1024 * 1024)
+
+static hid_t
+adftool_file_eeg_dataset (struct adftool_file *file)
+{
+  if (file->eeg_dataset == H5I_INVALID_HID)
+    {
+      hid_t access = H5Pcreate (H5P_DATASET_ACCESS);
+      if (access == H5I_INVALID_HID)
+	{
+	  return H5I_INVALID_HID;
+	}
+      if (H5Pset_chunk_cache (access, EEG_DATASET_CHUNK_CACHE_SLOTS,
+			      EEG_DATASET_CHUNK_CACHE_BYTES, 0.75) < 0)
+	{
+	  H5Pclose (access);
+	  return H5I_INVALID_HID;
+	}
+      file->eeg_dataset = H5Dopen2 (file->hdf5_handle, "/eeg-data", access);
+      H5Pclose (access);
+    }
+  return file->eeg_dataset;
+}
+
+static int
+adftool_file_eeg_block_decoders (struct adftool_file *file, hid_t * dataset,
+				 size_t *block_length)
+{
+  if (file->eeg_block_decoders == H5I_INVALID_HID)
+    {
+      htri_t exists =
+	H5Lexists (file->hdf5_handle, "/eeg-block-decoders", H5P_DEFAULT);
+      if (exists < 0)
+	{
+	  return 1;
+	}
+      if (exists == 0)
+	{
+	  *dataset = H5I_INVALID_HID;
+	  *block_length = 0;
+	  return 0;
+	}
+      hid_t decoders =
+	H5Dopen2 (file->hdf5_handle, "/eeg-block-decoders", H5P_DEFAULT);
+      if (decoders == H5I_INVALID_HID)
+	{
+	  return 1;
+	}
+      hid_t attribute = H5Aopen (decoders, "block-length", H5P_DEFAULT);
+      if (attribute == H5I_INVALID_HID)
+	{
+	  H5Dclose (decoders);
+	  return 1;
+	}
+      uint64_t length;
+      herr_t read_error = H5Aread (attribute, H5T_NATIVE_UINT64, &length);
+      H5Aclose (attribute);
+      if (read_error < 0 || length == 0)
+	{
+	  H5Dclose (decoders);
+	  return 1;
+	}
+      file->eeg_block_decoders = decoders;
+      file->eeg_block_length = length;
+    }
+  *dataset = file->eeg_block_decoders;
+  *block_length = file->eeg_block_length;
+  return 0;
+}
+
+static void
+adftool_file_eeg_dataset_close (struct adftool_file *file)
+{
+  if (file->eeg_dataset != H5I_INVALID_HID)
+    {
+      H5Dclose (file->eeg_dataset);
+      file->eeg_dataset = H5I_INVALID_HID;
+    }
+  if (file->eeg_block_decoders != H5I_INVALID_HID)
+    {
+      H5Dclose (file->eeg_block_decoders);
+      file->eeg_block_decoders = H5I_INVALID_HID;
+      file->eeg_block_length = 0;
+    }
+}
+
+static void
+adftool_file_eeg_decoders_invalidate (struct adftool_file *file)
+{
+  struct adftool_file_eeg_decoders *decoders = &(file->eeg_decoders);
+  if (decoders->identifiers != NULL)
+    {
+      for (size_t i = 0; i < decoders->n_channels; i++)
+	{
+	  term_free (decoders->identifiers[i]);
+	}
+    }
+  free (decoders->identifiers);
+  free (decoders->scales);
+  free (decoders->offsets);
+  decoders->valid = false;
+  decoders->n_channels = 0;
+  decoders->identifiers = NULL;
+  decoders->scales = NULL;
+  decoders->offsets = NULL;
+}
+
 static bool
 adftool_file_can_use_index (const struct adftool_statement *pattern,
 			    const char *index_order)
@@ -385,6 +542,7 @@ adftool_file_delete (struct adftool_file *file,
     .file = file,
     .deletion_date = deletion_date
   };
+  adftool_file_eeg_decoders_invalidate (file);
   for (size_t i = 0; i < 6; i++)
     {
       if (adftool_file_can_use_index (pattern, file->indices[i]->order))
@@ -435,6 +593,7 @@ adftool_file_insert (struct adftool_file *file,
       return 0;
     }
   /* The statement is not already present. */
+  adftool_file_eeg_decoders_invalidate (file);
   uint32_t new_id;
   int insertion_error =
     quads_insert (file->quads, file->dictionary, pattern, &new_id);
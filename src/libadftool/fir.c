@@ -4,12 +4,40 @@
 #include <stdlib.h>
 #include <math.h>
 #include <assert.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "fft.h"
+#include "fir_kernels.h"
+
+/* Above this order, filtering is done by FFT overlap-save instead of
+   the direct convolution. The faster the direct kernel, the later
+   the FFT pays off. The crossovers come from src/bench_fir_kernels
+   (make bench), on 65536 samples. */
+static size_t
+fir_fft_min_order (void)
+{
+  switch (eeg_kernels_best_isa ())
+    {
+    case EEG_KERNELS_AVX2:
+      return 256;
+    case EEG_KERNELS_SSE2:
+      return 128;
+    default:
+      return 64;
+    }
+}
 
 struct adftool_fir
 {
   size_t half_m;
   double coef_0;
   double *coefficients;		/* just the strictly positive half_m of them. */
+  /* For the FFT: NULL if the filter is too short. The spectrum is
+     scaled by the inverse of the FFT size. */
+  size_t fft_size;
+  double *twiddles;
+  double *spectrum;
 };
 
 void
@@ -58,11 +86,30 @@ adftool_fir_alloc (size_t order)
       ret->half_m = order / 2;
       ret->coef_0 = 0;
       ret->coefficients = calloc (order / 2, sizeof (double));
-      if (ret->coefficients == NULL)
+      ret->fft_size = 0;
+      ret->twiddles = NULL;
+      ret->spectrum = NULL;
+      if (order > fir_fft_min_order ())
+	{
+	  /* The blocks are 4 times longer than the filter. */
+	  ret->fft_size = fft_size_at_least (4 * order);
+	  ret->twiddles = malloc (ret->fft_size * sizeof (double));
+	  ret->spectrum = calloc (2 * ret->fft_size, sizeof (double));
+	}
+      if (ret->coefficients == NULL
+	  || (ret->fft_size != 0
+	      && (ret->twiddles == NULL || ret->spectrum == NULL)))
 	{
+	  free (ret->spectrum);
+	  free (ret->twiddles);
+	  free (ret->coefficients);
 	  free (ret);
 	  ret = NULL;
 	}
+      else if (ret->fft_size != 0)
+	{
+	  fft_twiddles (ret->fft_size, ret->twiddles);
+	}
     }
   return ret;
 }
@@ -93,11 +140,26 @@ adftool_fir_free (struct adftool_fir *filter)
 {
   if (filter)
     {
+      free (filter->spectrum);
+      free (filter->twiddles);
       free (filter->coefficients);
     }
   free (filter);
 }
 
+static void
+fir_update_spectrum (struct adftool_fir *filter)
+{
+  if (filter->fft_size == 0)
+    {
+      return;
+    }
+  /* The causal version of the filter, delayed by half_m. */
+  fft_filter_spectrum (filter->fft_size, filter->twiddles, filter->half_m,
+		       filter->coef_0, filter->coefficients,
+		       filter->spectrum);
+}
+
 #define BLACKMAN \
   (0.42 - 0.5 * cos (2 * M_PI * i_window) \
    + 0.08 * cos (4 * M_PI * i_window))
@@ -155,36 +217,433 @@ adftool_fir_design_bandpass (struct adftool_fir *filter, double sfreq,
 	    }
 	}
     }
+  fir_update_spectrum (filter);
+}
+
+static void
+fir_apply_direct (const struct adftool_fir *filter, size_t signal_length,
+		  const double *signal, double *filtered)
+{
+  fir_kernels_apply (eeg_kernels_best_isa (), filter->half_m,
+		     filter->coef_0, filter->coefficients, signal_length,
+		     signal, filtered);
+}
+
+/* Overlap-save, with zeros outside of the signal as in the direct
+   form. */
+static int
+fir_apply_fft (const struct adftool_fir *filter, size_t signal_length,
+	       const double *signal, double *filtered)
+{
+  const size_t n = filter->fft_size;
+  double *work = malloc (2 * n * sizeof (double));
+  if (work == NULL)
+    {
+      return 1;
+    }
+  fft_overlap_save (n, filter->twiddles, filter->spectrum, filter->half_m,
+		    signal_length, signal, filtered, work);
+  free (work);
+  return 0;
 }
 
 void
 adftool_fir_apply (const struct adftool_fir *filter, size_t signal_length,
 		   const double *signal, double *filtered)
 {
-  for (size_t i = 0; i < signal_length; i++)
+  if (filter->fft_size != 0 && signal_length >= filter->half_m
+      && fir_apply_fft (filter, signal_length, signal, filtered) == 0)
     {
-      filtered[i] = filter->coef_0 * signal[i];
+      return;
     }
-  /* Forward pass: */
-  for (size_t i = 0; i < signal_length; i++)
+  fir_apply_direct (filter, signal_length, signal, filtered);
+}
+
+/* Compute the outputs at first, first + decimation, … With a long
+   filter and a small decimation, the FFT of the whole signal is still
+   cheaper. */
+static void
+fir_apply_decimated (const struct adftool_fir *filter, size_t signal_length,
+		     const double *signal, size_t first, size_t decimation,
+		     size_t n_outputs, double *filtered)
+{
+  const size_t order = 2 * filter->half_m + 1;
+  if (filter->fft_size != 0 && signal_length >= filter->half_m
+      && order > decimation * fir_fft_min_order ())
     {
-      for (size_t j = 0; j < filter->half_m; j++)
+      double *all = malloc (signal_length * sizeof (double));
+      if (all != NULL
+	  && fir_apply_fft (filter, signal_length, signal, all) == 0)
 	{
-	  if (i + j + 1 < signal_length)
+	  for (size_t k = 0; k < n_outputs; k++)
 	    {
-	      filtered[i] += filter->coefficients[j] * signal[i + j + 1];
+	      filtered[k] = all[first + k * decimation];
 	    }
+	  free (all);
+	  return;
+	}
+      free (all);
+    }
+  fir_kernels_apply_decimated (eeg_kernels_best_isa (), filter->half_m,
+			       filter->coef_0, filter->coefficients,
+			       signal_length, signal, first, decimation,
+			       n_outputs, filtered);
+}
+
+size_t
+adftool_fir_apply_decimated (const struct adftool_fir *filter,
+			     size_t signal_length, const double *signal,
+			     size_t decimation, double *filtered)
+{
+  if (decimation == 0)
+    {
+      decimation = 1;
+    }
+  const size_t n_outputs = (signal_length + decimation - 1) / decimation;
+  if (decimation == 1)
+    {
+      adftool_fir_apply (filter, signal_length, signal, filtered);
+    }
+  else
+    {
+      fir_apply_decimated (filter, signal_length, signal, 0, decimation,
+			   n_outputs, filtered);
+    }
+  return n_outputs;
+}
+
+void
+adftool_fir_apply_multi (const struct adftool_fir *filter,
+			 size_t signal_length, size_t n_channels,
+			 int channel_major, const double *signal,
+			 double *filtered)
+{
+  if (channel_major)
+    {
+      for (size_t c = 0; c < n_channels; c++)
+	{
+	  adftool_fir_apply (filter, signal_length,
+			     signal + c * signal_length,
+			     filtered + c * signal_length);
 	}
+      return;
     }
-  /* Backward: */
-  for (size_t i = 0; i < signal_length; i++)
+  if (filter->fft_size != 0 && signal_length >= filter->half_m)
     {
-      for (size_t j = 0; j < filter->half_m; j++)
+      /* The FFT runs along the time axis, so each channel is copied
+         out of the block. */
+      double *channel = malloc (2 * signal_length * sizeof (double));
+      int error = (channel == NULL);
+      double *channel_filtered =
+	(channel == NULL ? NULL : channel + signal_length);
+      for (size_t c = 0; c < n_channels && !error; c++)
 	{
-	  if (i + j + 1 < signal_length)
+	  for (size_t i = 0; i < signal_length; i++)
 	    {
-	      filtered[i + j + 1] += filter->coefficients[j] * signal[i];
+	      channel[i] = signal[i * n_channels + c];
+	    }
+	  error = fir_apply_fft (filter, signal_length, channel,
+				 channel_filtered);
+	  for (size_t i = 0; i < signal_length && !error; i++)
+	    {
+	      filtered[i * n_channels + c] = channel_filtered[i];
 	    }
 	}
+      free (channel);
+      if (!error)
+	{
+	  return;
+	}
+    }
+  fir_kernels_apply_interleaved (eeg_kernels_best_isa (), filter->half_m,
+				 filter->coef_0, filter->coefficients,
+				 signal_length, n_channels, signal, filtered);
+}
+
+struct adftool_fir_stream
+{
+  const struct adftool_fir *filter;
+  /* The number of outputs that are centered before the first sample
+     of the signal. */
+  size_t n_to_skip;
+  /* Only keep one output every decimation, the first one being
+     centered on the first sample. n_centers is the number of outputs,
+     kept or not, since then. */
+  size_t decimation;
+  size_t n_centers;
+  /* The last 2 * half_m samples, then the new ones. */
+  size_t capacity;
+  double *samples;
+  double *filtered;
+};
+
+struct adftool_fir_stream *
+adftool_fir_stream_alloc (const struct adftool_fir *filter)
+{
+  return adftool_fir_stream_alloc_decimated (filter, 1);
+}
+
+struct adftool_fir_stream *
+adftool_fir_stream_alloc_decimated (const struct adftool_fir *filter,
+				    size_t decimation)
+{
+  struct adftool_fir_stream *ret = malloc (sizeof (struct adftool_fir_stream));
+  if (ret != NULL)
+    {
+      ret->filter = filter;
+      ret->decimation = (decimation == 0 ? 1 : decimation);
+      ret->capacity = 2 * filter->half_m + 1;
+      ret->samples = malloc (ret->capacity * sizeof (double));
+      ret->filtered = malloc (ret->capacity * sizeof (double));
+      if (ret->samples == NULL || ret->filtered == NULL)
+	{
+	  free (ret->filtered);
+	  free (ret->samples);
+	  free (ret);
+	  return NULL;
+	}
+      adftool_fir_stream_reset (ret, 0, NULL);
+    }
+  return ret;
+}
+
+void
+adftool_fir_stream_free (struct adftool_fir_stream *stream)
+{
+  if (stream)
+    {
+      free (stream->filtered);
+      free (stream->samples);
+    }
+  free (stream);
+}
+
+void
+adftool_fir_stream_reset (struct adftool_fir_stream *stream,
+			  size_t history_length, const double *history)
+{
+  const size_t half_m = stream->filter->half_m;
+  for (size_t i = 0; i < 2 * half_m; i++)
+    {
+      stream->samples[i] = 0;
+    }
+  if (history_length > half_m)
+    {
+      history += history_length - half_m;
+      history_length = half_m;
+    }
+  for (size_t i = 0; i < history_length; i++)
+    {
+      stream->samples[2 * half_m - history_length + i] = history[i];
+    }
+  stream->n_to_skip = half_m;
+  stream->n_centers = 0;
+}
+
+static int
+fir_stream_push (struct adftool_fir_stream *stream, size_t n_samples,
+		 const double *samples, size_t *n_filtered, double *filtered)
+{
+  /* If samples is NULL, push zeros. */
+  const size_t half_m = stream->filter->half_m;
+  *n_filtered = 0;
+  if (2 * half_m + n_samples > stream->capacity)
+    {
+      const size_t capacity = 2 * half_m + n_samples;
+      double *new_samples =
+	realloc (stream->samples, capacity * sizeof (double));
+      if (new_samples == NULL)
+	{
+	  return 1;
+	}
+      stream->samples = new_samples;
+      double *new_filtered =
+	realloc (stream->filtered, capacity * sizeof (double));
+      if (new_filtered == NULL)
+	{
+	  return 1;
+	}
+      stream->filtered = new_filtered;
+      stream->capacity = capacity;
+    }
+  for (size_t i = 0; i < n_samples; i++)
+    {
+      stream->samples[2 * half_m + i] = (samples == NULL ? 0 : samples[i]);
+    }
+  /* The outputs centered on the last half_m samples of the delay line
+     and the first new samples have all their inputs. */
+  size_t n_skipped = stream->n_to_skip;
+  if (n_skipped > n_samples)
+    {
+      n_skipped = n_samples;
+    }
+  stream->n_to_skip -= n_skipped;
+  const size_t n_centers = n_samples - n_skipped;
+  const size_t decimation = stream->decimation;
+  if (decimation == 1)
+    {
+      /* The FFT computes the others too, with missing inputs, and
+         they are discarded. */
+      const struct adftool_fir *filter = stream->filter;
+      const size_t signal_length = 2 * half_m + n_samples;
+      if (filter->fft_size == 0
+	  || fir_apply_fft (filter, signal_length, stream->samples,
+			    stream->filtered) != 0)
+	{
+	  fir_kernels_apply_steady (eeg_kernels_best_isa (), half_m,
+				    filter->coef_0, filter->coefficients,
+				    half_m + n_skipped,
+				    half_m + n_skipped + n_centers,
+				    stream->samples, stream->filtered);
+	}
+      *n_filtered = n_centers;
+      for (size_t i = 0; i < *n_filtered; i++)
+	{
+	  filtered[i] = stream->filtered[half_m + n_skipped + i];
+	}
+    }
+  else
+    {
+      const size_t first_kept =
+	(decimation - stream->n_centers % decimation) % decimation;
+      if (first_kept < n_centers)
+	{
+	  *n_filtered = (n_centers - first_kept + decimation - 1) / decimation;
+	  fir_apply_decimated (stream->filter, 2 * half_m + n_samples,
+			       stream->samples,
+			       half_m + n_skipped + first_kept, decimation,
+			       *n_filtered, filtered);
+	}
+    }
+  stream->n_centers += n_centers;
+  memmove (stream->samples, stream->samples + n_samples,
+	   2 * half_m * sizeof (double));
+  return 0;
+}
+
+int
+adftool_fir_stream_push (struct adftool_fir_stream *stream,
+			 size_t n_samples, const double *samples,
+			 size_t *n_filtered, double *filtered)
+{
+  return fir_stream_push (stream, n_samples, samples, n_filtered, filtered);
+}
+
+int
+adftool_fir_stream_finish (struct adftool_fir_stream *stream,
+			   size_t *n_filtered, double *filtered)
+{
+  /* The signal is 0 after its end. */
+  const size_t half_m = stream->filter->half_m;
+  int error = fir_stream_push (stream, half_m, NULL, n_filtered, filtered);
+  if (error == 0)
+    {
+      adftool_fir_stream_reset (stream, 0, NULL);
+    }
+  return error;
+}
+
+/* The filters designed by adftool_fir_acquire, shared by all
+   threads. */
+struct fir_shared
+{
+  double sfreq;
+  double freq_low;
+  double freq_high;
+  double trans_low;
+  double trans_high;
+  size_t n_references;
+  struct adftool_fir *filter;
+  struct fir_shared *next;
+};
+
+static pthread_mutex_t fir_shared_synchronizer = PTHREAD_MUTEX_INITIALIZER;
+static struct fir_shared *fir_shared_filters = NULL;
+
+const struct adftool_fir *
+adftool_fir_acquire (double sfreq, double freq_low, double freq_high,
+		     double trans_low, double trans_high)
+{
+  struct adftool_fir *ret = NULL;
+  if (pthread_mutex_lock (&fir_shared_synchronizer) != 0)
+    {
+      return NULL;
+    }
+  for (struct fir_shared * shared = fir_shared_filters; shared != NULL;
+       shared = shared->next)
+    {
+      if (shared->sfreq == sfreq && shared->freq_low == freq_low
+	  && shared->freq_high == freq_high && shared->trans_low == trans_low
+	  && shared->trans_high == trans_high)
+	{
+	  shared->n_references++;
+	  ret = shared->filter;
+	  goto unlock;
+	}
+    }
+  struct fir_shared *shared = malloc (sizeof (struct fir_shared));
+  if (shared == NULL)
+    {
+      goto unlock;
+    }
+  const double smallest_trans = (trans_high < trans_low ? trans_high
+				 : trans_low);
+  shared->filter =
+    adftool_fir_alloc (adftool_fir_auto_order (sfreq, smallest_trans));
+  if (shared->filter == NULL)
+    {
+      free (shared);
+      goto unlock;
+    }
+  adftool_fir_design_bandpass (shared->filter, sfreq, freq_low, freq_high,
+			       trans_low, trans_high);
+  shared->sfreq = sfreq;
+  shared->freq_low = freq_low;
+  shared->freq_high = freq_high;
+  shared->trans_low = trans_low;
+  shared->trans_high = trans_high;
+  shared->n_references = 1;
+  shared->next = fir_shared_filters;
+  fir_shared_filters = shared;
+  ret = shared->filter;
+unlock:
+  if (pthread_mutex_unlock (&fir_shared_synchronizer) != 0)
+    {
+      abort ();
+    }
+  return ret;
+}
+
+void
+adftool_fir_release (const struct adftool_fir *filter)
+{
+  if (filter == NULL)
+    {
+      return;
+    }
+  if (pthread_mutex_lock (&fir_shared_synchronizer) != 0)
+    {
+      abort ();
+    }
+  for (struct fir_shared ** shared = &fir_shared_filters; *shared != NULL;
+       shared = &((*shared)->next))
+    {
+      if ((*shared)->filter == filter)
+	{
+	  assert ((*shared)->n_references > 0);
+	  (*shared)->n_references--;
+	  if ((*shared)->n_references == 0)
+	    {
+	      struct fir_shared *unused = *shared;
+	      *shared = unused->next;
+	      adftool_fir_free (unused->filter);
+	      free (unused);
+	    }
+	  break;
+	}
+    }
+  if (pthread_mutex_unlock (&fir_shared_synchronizer) != 0)
+    {
+      abort ();
     }
 }
@@ -0,0 +1,624 @@
+#ifndef H_ADFTOOL_FIR_KERNELS_INCLUDED
+# define H_ADFTOOL_FIR_KERNELS_INCLUDED
+
+# include <stdlib.h>
+# include <stdbool.h>
+
+# include "eeg_kernels.h"
+
+/* Direct-form kernels for symmetric FIR filters: coef_0 is the center
+   tap, and coefficients[j] multiplies both signal[i + j + 1] and
+   signal[i - j - 1]. The signal is 0 outside of [0,
+   signal_length). The first and last half_m outputs need these
+   bounds checks; the others are computed by a branch-free loop,
+   vectorized along the outputs. */
+
+MAYBE_UNUSED static void fir_kernels_apply (enum eeg_kernels_isa isa,
+					    size_t half_m, double coef_0,
+					    const double *coefficients,
+					    size_t signal_length,
+					    const double *signal,
+					    double *filtered);
+
+/* Only compute the outputs from start to stop, which must have all
+   their inputs: half_m <= start and stop + half_m <= the length of
+   the signal. */
+MAYBE_UNUSED static void fir_kernels_apply_steady (enum eeg_kernels_isa isa,
+						   size_t half_m,
+						   double coef_0,
+						   const double *coefficients,
+						   size_t start, size_t stop,
+						   const double *signal,
+						   double *filtered);
+
+/* Same, for n_channels signals interleaved: sample i of channel c is
+   signal[i * n_channels + c], and the vectorized loops run across
+   the channels. */
+MAYBE_UNUSED static void fir_kernels_apply_interleaved (enum
+							eeg_kernels_isa isa,
+							size_t half_m,
+							double coef_0,
+							const double
+							*coefficients,
+							size_t signal_length,
+							size_t n_channels,
+							const double *signal,
+							double *filtered);
+
+/* Compute only n_outputs outputs, at first, first + decimation, …,
+   each one as a dot product along the taps. */
+MAYBE_UNUSED static void fir_kernels_apply_decimated (enum eeg_kernels_isa
+						      isa, size_t half_m,
+						      double coef_0,
+						      const double
+						      *coefficients,
+						      size_t signal_length,
+						      const double *signal,
+						      size_t first,
+						      size_t decimation,
+						      size_t n_outputs,
+						      double *filtered);
+
+static inline double
+fir_kernels_apply_one (size_t half_m, double coef_0,
+		       const double *coefficients, size_t signal_length,
+		       const double *signal, size_t i)
+{
+  double sum = coef_0 * signal[i];
+  for (size_t j = 0; j < half_m; j++)
+    {
+      double folded = 0;
+      if (i + j + 1 < signal_length)
+	{
+	  folded += signal[i + j + 1];
+	}
+      if (i >= j + 1)
+	{
+	  folded += signal[i - j - 1];
+	}
+      sum += coefficients[j] * folded;
+    }
+  return sum;
+}
+
+static inline void
+fir_kernels_apply_edges (size_t half_m, double coef_0,
+			 const double *coefficients, size_t signal_length,
+			 const double *signal, double *filtered)
+{
+  size_t head = half_m;
+  size_t tail_start = half_m;
+  if (signal_length >= half_m)
+    {
+      tail_start = signal_length - half_m;
+    }
+  if (head > signal_length)
+    {
+      head = signal_length;
+    }
+  if (tail_start < head)
+    {
+      tail_start = head;
+    }
+  for (size_t i = 0; i < head; i++)
+    {
+      filtered[i] =
+	fir_kernels_apply_one (half_m, coef_0, coefficients, signal_length,
+			       signal, i);
+    }
+  for (size_t i = tail_start; i < signal_length; i++)
+    {
+      filtered[i] =
+	fir_kernels_apply_one (half_m, coef_0, coefficients, signal_length,
+			       signal, i);
+    }
+}
+
+/* Compute the outputs from start to stop, which must all be at least
+   half_m samples away from the bounds. */
+static inline void
+fir_kernels_apply_steady_scalar (size_t half_m, double coef_0,
+				 const double *coefficients, size_t start,
+				 size_t stop, const double *signal,
+				 double *filtered)
+{
+  for (size_t i = start; i < stop; i++)
+    {
+      double sum = coef_0 * signal[i];
+      const double *after = signal + i + 1;
+      const double *before = signal + i - 1;
+      for (size_t j = 0; j < half_m; j++)
+	{
+	  sum += coefficients[j] * (after[j] + *(before - j));
+	}
+      filtered[i] = sum;
+    }
+}
+
+static inline bool
+fir_kernels_is_steady (size_t half_m, size_t signal_length, size_t i)
+{
+  return (i >= half_m && i + half_m < signal_length);
+}
+
+static inline double
+fir_kernels_dot_scalar (size_t half_m, size_t j_start,
+			const double *coefficients, const double *signal,
+			size_t i)
+{
+  /* The side taps of output i, from tap j_start on. It must be in the
+     steady state. */
+  double sum = 0;
+  for (size_t j = j_start; j < half_m; j++)
+    {
+      sum += coefficients[j] * (signal[i + j + 1] + signal[i - j - 1]);
+    }
+  return sum;
+}
+
+static inline void
+fir_kernels_apply_decimated_scalar (size_t half_m, double coef_0,
+				    const double *coefficients,
+				    size_t signal_length,
+				    const double *signal, size_t first,
+				    size_t decimation, size_t n_outputs,
+				    double *filtered)
+{
+  for (size_t k = 0; k < n_outputs; k++)
+    {
+      const size_t i = first + k * decimation;
+      if (fir_kernels_is_steady (half_m, signal_length, i))
+	{
+	  filtered[k] = coef_0 * signal[i]
+	    + fir_kernels_dot_scalar (half_m, 0, coefficients, signal, i);
+	}
+      else
+	{
+	  filtered[k] =
+	    fir_kernels_apply_one (half_m, coef_0, coefficients,
+				   signal_length, signal, i);
+	}
+    }
+}
+
+/* The number of taps that reach the signal after and before output
+   i: both for the first n_both taps. */
+static inline void
+fir_kernels_reach (size_t half_m, size_t signal_length, size_t i,
+		   size_t *n_after, size_t *n_before, size_t *n_both)
+{
+  *n_after = signal_length - 1 - i;
+  if (*n_after > half_m)
+    {
+      *n_after = half_m;
+    }
+  *n_before = (i < half_m ? i : half_m);
+  *n_both = (*n_after < *n_before ? *n_after : *n_before);
+}
+
+static inline void
+fir_kernels_apply_interleaved_scalar (size_t half_m, double coef_0,
+				      const double *coefficients,
+				      size_t signal_length,
+				      size_t n_channels, size_t channel_start,
+				      const double *signal, double *filtered)
+{
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      size_t n_after, n_before, n_both;
+      fir_kernels_reach (half_m, signal_length, i, &n_after, &n_before,
+			 &n_both);
+      const double *row = signal + i * n_channels;
+      for (size_t c = channel_start; c < n_channels; c++)
+	{
+	  double sum = coef_0 * row[c];
+	  for (size_t j = 0; j < n_both; j++)
+	    {
+	      const size_t distance = (j + 1) * n_channels;
+	      sum += coefficients[j] * (row[c + distance]
+					+ *(row + c - distance));
+	    }
+	  for (size_t j = n_both; j < n_after; j++)
+	    {
+	      sum += coefficients[j] * row[c + (j + 1) * n_channels];
+	    }
+	  for (size_t j = n_both; j < n_before; j++)
+	    {
+	      sum += coefficients[j] * *(row + c - (j + 1) * n_channels);
+	    }
+	  filtered[i * n_channels + c] = sum;
+	}
+    }
+}
+
+# ifdef EEG_KERNELS_X86
+
+EEG_KERNELS_TARGET ("sse2") static void
+fir_kernels_apply_steady_sse2 (size_t half_m, double coef_0,
+			       const double *coefficients, size_t start,
+			       size_t stop, const double *signal,
+			       double *filtered)
+{
+  /* 4 outputs at a time, in 2 independent accumulators. */
+  size_t i = start;
+  const __m128d center = _mm_set1_pd (coef_0);
+  for (; i + 4 <= stop; i += 4)
+    {
+      __m128d low = _mm_mul_pd (center, _mm_loadu_pd (signal + i));
+      __m128d high = _mm_mul_pd (center, _mm_loadu_pd (signal + i + 2));
+      for (size_t j = 0; j < half_m; j++)
+	{
+	  const __m128d coef = _mm_set1_pd (coefficients[j]);
+	  const double *after = signal + i + j + 1;
+	  const double *before = signal + i - j - 1;
+	  low =
+	    _mm_add_pd (low,
+			_mm_mul_pd (coef,
+				    _mm_add_pd (_mm_loadu_pd (after),
+						_mm_loadu_pd (before))));
+	  high =
+	    _mm_add_pd (high,
+			_mm_mul_pd (coef,
+				    _mm_add_pd (_mm_loadu_pd (after + 2),
+						_mm_loadu_pd (before + 2))));
+	}
+      _mm_storeu_pd (filtered + i, low);
+      _mm_storeu_pd (filtered + i + 2, high);
+    }
+  fir_kernels_apply_steady_scalar (half_m, coef_0, coefficients, i, stop,
+				   signal, filtered);
+}
+
+EEG_KERNELS_TARGET ("avx2") static void
+fir_kernels_apply_steady_avx2 (size_t half_m, double coef_0,
+			       const double *coefficients, size_t start,
+			       size_t stop, const double *signal,
+			       double *filtered)
+{
+  /* 8 outputs at a time, in 2 independent accumulators. */
+  size_t i = start;
+  const __m256d center = _mm256_set1_pd (coef_0);
+  for (; i + 8 <= stop; i += 8)
+    {
+      __m256d low = _mm256_mul_pd (center, _mm256_loadu_pd (signal + i));
+      __m256d high = _mm256_mul_pd (center, _mm256_loadu_pd (signal + i + 4));
+      for (size_t j = 0; j < half_m; j++)
+	{
+	  const __m256d coef = _mm256_broadcast_sd (coefficients + j);
+	  const double *after = signal + i + j + 1;
+	  const double *before = signal + i - j - 1;
+	  low =
+	    _mm256_add_pd (low,
+			   _mm256_mul_pd (coef,
+					  _mm256_add_pd (_mm256_loadu_pd
+							 (after),
+							 _mm256_loadu_pd
+							 (before))));
+	  high =
+	    _mm256_add_pd (high,
+			   _mm256_mul_pd (coef,
+					  _mm256_add_pd (_mm256_loadu_pd
+							 (after + 4),
+							 _mm256_loadu_pd
+							 (before + 4))));
+	}
+      _mm256_storeu_pd (filtered + i, low);
+      _mm256_storeu_pd (filtered + i + 4, high);
+    }
+  fir_kernels_apply_steady_scalar (half_m, coef_0, coefficients, i, stop,
+				   signal, filtered);
+}
+
+EEG_KERNELS_TARGET ("sse2") static void
+fir_kernels_apply_interleaved_sse2 (size_t half_m, double coef_0,
+				    const double *coefficients,
+				    size_t signal_length, size_t n_channels,
+				    const double *signal, double *filtered)
+{
+  /* 4 channels at a time. */
+  const size_t n_vectorized = n_channels - n_channels % 4;
+  const __m128d center = _mm_set1_pd (coef_0);
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      size_t n_after, n_before, n_both;
+      fir_kernels_reach (half_m, signal_length, i, &n_after, &n_before,
+			 &n_both);
+      const double *row = signal + i * n_channels;
+      for (size_t c = 0; c < n_vectorized; c += 4)
+	{
+	  __m128d low = _mm_mul_pd (center, _mm_loadu_pd (row + c));
+	  __m128d high = _mm_mul_pd (center, _mm_loadu_pd (row + c + 2));
+	  for (size_t j = 0; j < n_both; j++)
+	    {
+	      const __m128d coef = _mm_set1_pd (coefficients[j]);
+	      const double *after = row + c + (j + 1) * n_channels;
+	      const double *before = row + c - (j + 1) * n_channels;
+	      low =
+		_mm_add_pd (low,
+			    _mm_mul_pd (coef,
+					_mm_add_pd (_mm_loadu_pd (after),
+						    _mm_loadu_pd (before))));
+	      high =
+		_mm_add_pd (high,
+			    _mm_mul_pd (coef,
+					_mm_add_pd (_mm_loadu_pd (after + 2),
+						    _mm_loadu_pd (before +
+								  2))));
+	    }
+	  for (size_t j = n_both; j < n_after; j++)
+	    {
+	      const __m128d coef = _mm_set1_pd (coefficients[j]);
+	      const double *after = row + c + (j + 1) * n_channels;
+	      low = _mm_add_pd (low, _mm_mul_pd (coef, _mm_loadu_pd (after)));
+	      high =
+		_mm_add_pd (high, _mm_mul_pd (coef, _mm_loadu_pd (after + 2)));
+	    }
+	  for (size_t j = n_both; j < n_before; j++)
+	    {
+	      const __m128d coef = _mm_set1_pd (coefficients[j]);
+	      const double *before = row + c - (j + 1) * n_channels;
+	      low = _mm_add_pd (low, _mm_mul_pd (coef, _mm_loadu_pd (before)));
+	      high =
+		_mm_add_pd (high,
+			    _mm_mul_pd (coef, _mm_loadu_pd (before + 2)));
+	    }
+	  _mm_storeu_pd (filtered + i * n_channels + c, low);
+	  _mm_storeu_pd (filtered + i * n_channels + c + 2, high);
+	}
+    }
+  fir_kernels_apply_interleaved_scalar (half_m, coef_0, coefficients,
+					signal_length, n_channels,
+					n_vectorized, signal, filtered);
+}
+
+EEG_KERNELS_TARGET ("avx2") static void
+fir_kernels_apply_interleaved_avx2 (size_t half_m, double coef_0,
+				    const double *coefficients,
+				    size_t signal_length, size_t n_channels,
+				    const double *signal, double *filtered)
+{
+  /* 8 channels at a time. */
+  const size_t n_vectorized = n_channels - n_channels % 8;
+  const __m256d center = _mm256_set1_pd (coef_0);
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      size_t n_after, n_before, n_both;
+      fir_kernels_reach (half_m, signal_length, i, &n_after, &n_before,
+			 &n_both);
+      const double *row = signal + i * n_channels;
+      for (size_t c = 0; c < n_vectorized; c += 8)
+	{
+	  __m256d low = _mm256_mul_pd (center, _mm256_loadu_pd (row + c));
+	  __m256d high = _mm256_mul_pd (center, _mm256_loadu_pd (row + c + 4));
+	  for (size_t j = 0; j < n_both; j++)
+	    {
+	      const __m256d coef = _mm256_broadcast_sd (coefficients + j);
+	      const double *after = row + c + (j + 1) * n_channels;
+	      const double *before = row + c - (j + 1) * n_channels;
+	      low =
+		_mm256_add_pd (low,
+			       _mm256_mul_pd (coef,
+					      _mm256_add_pd (_mm256_loadu_pd
+							     (after),
+							     _mm256_loadu_pd
+							     (before))));
+	      high =
+		_mm256_add_pd (high,
+			       _mm256_mul_pd (coef,
+					      _mm256_add_pd (_mm256_loadu_pd
+							     (after + 4),
+							     _mm256_loadu_pd
+							     (before + 4))));
+	    }
+	  for (size_t j = n_both; j < n_after; j++)
+	    {
+	      const __m256d coef = _mm256_broadcast_sd (coefficients + j);
+	      const double *after = row + c + (j + 1) * n_channels;
+	      low =
+		_mm256_add_pd (low,
+			       _mm256_mul_pd (coef, _mm256_loadu_pd (after)));
+	      high =
+		_mm256_add_pd (high,
+			       _mm256_mul_pd (coef,
+					      _mm256_loadu_pd (after + 4)));
+	    }
+	  for (size_t j = n_both; j < n_before; j++)
+	    {
+	      const __m256d coef = _mm256_broadcast_sd (coefficients + j);
+	      const double *before = row + c - (j + 1) * n_channels;
+	      low =
+		_mm256_add_pd (low,
+			       _mm256_mul_pd (coef, _mm256_loadu_pd (before)));
+	      high =
+		_mm256_add_pd (high,
+			       _mm256_mul_pd (coef,
+					      _mm256_loadu_pd (before + 4)));
+	    }
+	  _mm256_storeu_pd (filtered + i * n_channels + c, low);
+	  _mm256_storeu_pd (filtered + i * n_channels + c + 4, high);
+	}
+    }
+  fir_kernels_apply_interleaved_scalar (half_m, coef_0, coefficients,
+					signal_length, n_channels,
+					n_vectorized, signal, filtered);
+}
+
+EEG_KERNELS_TARGET ("sse2") static void
+fir_kernels_apply_decimated_sse2 (size_t half_m, double coef_0,
+				  const double *coefficients,
+				  size_t signal_length, const double *signal,
+				  size_t first, size_t decimation,
+				  size_t n_outputs, double *filtered)
+{
+  /* 2 taps at a time. The samples before the output are loaded in
+     increasing order, and swapped to match the taps. */
+  const size_t n_vectorized = half_m - half_m % 2;
+  for (size_t k = 0; k < n_outputs; k++)
+    {
+      const size_t i = first + k * decimation;
+      if (!fir_kernels_is_steady (half_m, signal_length, i))
+	{
+	  filtered[k] =
+	    fir_kernels_apply_one (half_m, coef_0, coefficients,
+				   signal_length, signal, i);
+	  continue;
+	}
+      __m128d sum = _mm_setzero_pd ();
+      for (size_t j = 0; j < n_vectorized; j += 2)
+	{
+	  const __m128d after = _mm_loadu_pd (signal + i + j + 1);
+	  const __m128d before = _mm_loadu_pd (signal + i - j - 2);
+	  const __m128d folded =
+	    _mm_add_pd (after, _mm_shuffle_pd (before, before, 1));
+	  sum =
+	    _mm_add_pd (sum,
+			_mm_mul_pd (_mm_loadu_pd (coefficients + j), folded));
+	}
+      double lanes[2];
+      _mm_storeu_pd (lanes, sum);
+      filtered[k] = coef_0 * signal[i] + lanes[0] + lanes[1]
+	+ fir_kernels_dot_scalar (half_m, n_vectorized, coefficients,
+				  signal, i);
+    }
+}
+
+EEG_KERNELS_TARGET ("avx2") static void
+fir_kernels_apply_decimated_avx2 (size_t half_m, double coef_0,
+				  const double *coefficients,
+				  size_t signal_length, const double *signal,
+				  size_t first, size_t decimation,
+				  size_t n_outputs, double *filtered)
+{
+  /* 4 taps at a time. */
+  const size_t n_vectorized = half_m - half_m % 4;
+  for (size_t k = 0; k < n_outputs; k++)
+    {
+      const size_t i = first + k * decimation;
+      if (!fir_kernels_is_steady (half_m, signal_length, i))
+	{
+	  filtered[k] =
+	    fir_kernels_apply_one (half_m, coef_0, coefficients,
+				   signal_length, signal, i);
+	  continue;
+	}
+      __m256d sum = _mm256_setzero_pd ();
+      for (size_t j = 0; j < n_vectorized; j += 4)
+	{
+	  const __m256d after = _mm256_loadu_pd (signal + i + j + 1);
+	  const __m256d before = _mm256_loadu_pd (signal + i - j - 4);
+	  const __m256d folded =
+	    _mm256_add_pd (after, _mm256_permute4x64_pd (before, 0x1B));
+	  sum =
+	    _mm256_add_pd (sum,
+			   _mm256_mul_pd (_mm256_loadu_pd (coefficients + j),
+					  folded));
+	}
+      double lanes[4];
+      _mm256_storeu_pd (lanes, sum);
+      filtered[k] = coef_0 * signal[i] + (lanes[0] + lanes[1])
+	+ (lanes[2] + lanes[3])
+	+ fir_kernels_dot_scalar (half_m, n_vectorized, coefficients,
+				  signal, i);
+    }
+}
+
+# endif	/* EEG_KERNELS_X86 */
+
+static void
+fir_kernels_apply (enum eeg_kernels_isa isa, size_t half_m, double coef_0,
+		   const double *coefficients, size_t signal_length,
+		   const double *signal, double *filtered)
+{
+  fir_kernels_apply_edges (half_m, coef_0, coefficients, signal_length,
+			   signal, filtered);
+  if (signal_length <= 2 * half_m)
+    {
+      return;
+    }
+  fir_kernels_apply_steady (isa, half_m, coef_0, coefficients, half_m,
+			    signal_length - half_m, signal, filtered);
+}
+
+static void
+fir_kernels_apply_steady (enum eeg_kernels_isa isa, size_t half_m,
+			  double coef_0, const double *coefficients,
+			  size_t start, size_t stop, const double *signal,
+			  double *filtered)
+{
+  switch (isa)
+    {
+# ifdef EEG_KERNELS_X86
+    case EEG_KERNELS_AVX2:
+      fir_kernels_apply_steady_avx2 (half_m, coef_0, coefficients, start,
+				     stop, signal, filtered);
+      break;
+    case EEG_KERNELS_SSE2:
+      fir_kernels_apply_steady_sse2 (half_m, coef_0, coefficients, start,
+				     stop, signal, filtered);
+      break;
+# endif
+    default:
+      fir_kernels_apply_steady_scalar (half_m, coef_0, coefficients, start,
+				       stop, signal, filtered);
+      break;
+    }
+}
+
+static void
+fir_kernels_apply_interleaved (enum eeg_kernels_isa isa, size_t half_m,
+			       double coef_0, const double *coefficients,
+			       size_t signal_length, size_t n_channels,
+			       const double *signal, double *filtered)
+{
+  switch (isa)
+    {
+# ifdef EEG_KERNELS_X86
+    case EEG_KERNELS_AVX2:
+      fir_kernels_apply_interleaved_avx2 (half_m, coef_0, coefficients,
+					  signal_length, n_channels, signal,
+					  filtered);
+      break;
+    case EEG_KERNELS_SSE2:
+      fir_kernels_apply_interleaved_sse2 (half_m, coef_0, coefficients,
+					  signal_length, n_channels, signal,
+					  filtered);
+      break;
+# endif
+    default:
+      fir_kernels_apply_interleaved_scalar (half_m, coef_0, coefficients,
+					    signal_length, n_channels, 0,
+					    signal, filtered);
+      break;
+    }
+}
+
+static void
+fir_kernels_apply_decimated (enum eeg_kernels_isa isa, size_t half_m,
+			     double coef_0, const double *coefficients,
+			     size_t signal_length, const double *signal,
+			     size_t first, size_t decimation,
+			     size_t n_outputs, double *filtered)
+{
+  switch (isa)
+    {
+# ifdef EEG_KERNELS_X86
+    case EEG_KERNELS_AVX2:
+      fir_kernels_apply_decimated_avx2 (half_m, coef_0, coefficients,
+					signal_length, signal, first,
+					decimation, n_outputs, filtered);
+      break;
+    case EEG_KERNELS_SSE2:
+      fir_kernels_apply_decimated_sse2 (half_m, coef_0, coefficients,
+					signal_length, signal, first,
+					decimation, n_outputs, filtered);
+      break;
+# endif
+    default:
+      fir_kernels_apply_decimated_scalar (half_m, coef_0, coefficients,
+					  signal_length, signal, first,
+					  decimation, n_outputs, filtered);
+      break;
+    }
+}
+
+#endif /* H_ADFTOOL_FIR_KERNELS_INCLUDED */
@@ -0,0 +1,221 @@
+#include <config.h>
+#include <attribute.h>
+#include <adftool.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+/* The impulse response of each section is assumed to be negligible
+   once it has decayed by this factor. */
+#define IIR_SETTLE_TOLERANCE 1e-5
+
+/* Direct form II transposed biquads, normalized so that a0 = 1. */
+struct iir_section
+{
+  double b0, b1, b2;
+  double a1, a2;
+};
+
+struct adftool_iir
+{
+  /* The number of poles for each edge of the band. It is even, so
+     that each edge is a cascade of order / 2 sections. */
+  size_t order;
+  size_t n_sections;
+  struct iir_section *sections;
+  size_t settle_length;
+};
+
+struct adftool_iir *
+adftool_iir_alloc (size_t order)
+{
+  struct adftool_iir *ret = malloc (sizeof (struct adftool_iir));
+  if (ret != NULL)
+    {
+      if (order < 2)
+	{
+	  order = 2;
+	}
+      ret->order = order + order % 2;
+      ret->n_sections = 0;
+      ret->settle_length = 0;
+      ret->sections = malloc (ret->order * sizeof (struct iir_section));
+      if (ret->sections == NULL)
+	{
+	  free (ret);
+	  ret = NULL;
+	}
+    }
+  return ret;
+}
+
+void
+adftool_iir_free (struct adftool_iir *filter)
+{
+  if (filter)
+    {
+      free (filter->sections);
+    }
+  free (filter);
+}
+
+size_t
+adftool_iir_order (const struct adftool_iir *filter)
+{
+  return filter->order;
+}
+
+size_t
+adftool_iir_settle_length (const struct adftool_iir *filter)
+{
+  return filter->settle_length;
+}
+
+static size_t
+iir_section_settle_length (const struct iir_section *section)
+{
+  /* The impulse response decays as the largest pole magnitude. */
+  const double discriminant =
+    section->a1 * section->a1 - 4 * section->a2;
+  double radius;
+  if (discriminant < 0)
+    {
+      radius = sqrt (section->a2);
+    }
+  else
+    {
+      radius = (fabs (section->a1) + sqrt (discriminant)) / 2;
+    }
+  if (radius <= 0)
+    {
+      return 2;
+    }
+  if (radius >= 1)
+    {
+      /* Unstable: nothing can be done. */
+      return 0;
+    }
+  return 2 + ceil (log (IIR_SETTLE_TOLERANCE) / log (radius));
+}
+
+static void
+iir_design_section (struct iir_section *section, int is_highpass,
+		    double sfreq, double freq, double quality)
+{
+  /* Bilinear transform of a second order analog section, with the
+     frequency prewarped. */
+  const double w0 = 2 * M_PI * freq / sfreq;
+  const double cos_w0 = cos (w0);
+  const double alpha = sin (w0) / (2 * quality);
+  const double a0 = 1 + alpha;
+  if (is_highpass)
+    {
+      section->b0 = (1 + cos_w0) / 2 / a0;
+      section->b1 = -(1 + cos_w0) / a0;
+    }
+  else
+    {
+      section->b0 = (1 - cos_w0) / 2 / a0;
+      section->b1 = (1 - cos_w0) / a0;
+    }
+  section->b2 = section->b0;
+  section->a1 = -2 * cos_w0 / a0;
+  section->a2 = (1 - alpha) / a0;
+}
+
+void
+adftool_iir_design_bandpass (struct adftool_iir *filter, double sfreq,
+			     double freq_low, double freq_high)
+{
+  /* A Butterworth high-pass filter at freq_low, then a Butterworth
+     low-pass filter at freq_high. An edge at 0 or past the Nyquist
+     frequency is left open. The poles of the section k of each are
+     at the angle (2k + 1) pi / (2 order) from the real axis. */
+  const size_t n_per_edge = filter->order / 2;
+  filter->n_sections = 0;
+  filter->settle_length = 0;
+  for (int is_highpass = 1; is_highpass >= 0; is_highpass--)
+    {
+      const double freq = (is_highpass ? freq_low : freq_high);
+      if (freq <= 0 || freq >= sfreq / 2)
+	{
+	  continue;
+	}
+      for (size_t k = 0; k < n_per_edge; k++)
+	{
+	  const double quality =
+	    1 / (2 * cos ((2 * k + 1) * M_PI / (2 * filter->order)));
+	  struct iir_section *section =
+	    &(filter->sections[filter->n_sections++]);
+	  iir_design_section (section, is_highpass, sfreq, freq, quality);
+	  filter->settle_length += iir_section_settle_length (section);
+	}
+    }
+}
+
+static void
+iir_section_apply (const struct iir_section *section, size_t signal_length,
+		   ptrdiff_t step, double *signal)
+{
+  /* In place, starting from signal[0] and going by step. */
+  double z1 = 0, z2 = 0;
+  for (size_t i = 0; i < signal_length; i++)
+    {
+      double *x = signal + (ptrdiff_t) i * step;
+      const double y = section->b0 * *x + z1;
+      z1 = section->b1 * *x - section->a1 * y + z2;
+      z2 = section->b2 * *x - section->a2 * y;
+      *x = y;
+    }
+}
+
+void
+adftool_iir_apply (const struct adftool_iir *filter, size_t signal_length,
+		   const double *signal, double *filtered)
+{
+  if (filtered != signal)
+    {
+      memmove (filtered, signal, signal_length * sizeof (double));
+    }
+  for (size_t k = 0; k < filter->n_sections; k++)
+    {
+      iir_section_apply (&(filter->sections[k]), signal_length, 1,
+			 filtered);
+    }
+}
+
+int
+adftool_iir_apply_zero_phase (const struct adftool_iir *filter,
+			      size_t signal_length, const double *signal,
+			      double *filtered)
+{
+  /* Filter forward, then backward. The signal is 0 after its end, but
+     the forward pass still rings there, so the backward pass starts
+     once the ringing has settled. */
+  const size_t work_length = signal_length + filter->settle_length;
+  double *work = malloc (work_length * sizeof (double));
+  if (work == NULL)
+    {
+      return 1;
+    }
+  memcpy (work, signal, signal_length * sizeof (double));
+  for (size_t i = signal_length; i < work_length; i++)
+    {
+      work[i] = 0;
+    }
+  for (size_t k = 0; k < filter->n_sections; k++)
+    {
+      iir_section_apply (&(filter->sections[k]), work_length, 1, work);
+    }
+  if (work_length != 0)
+    {
+      for (size_t k = 0; k < filter->n_sections; k++)
+	{
+	  iir_section_apply (&(filter->sections[k]), work_length, -1,
+			     work + work_length - 1);
+	}
+    }
+  memcpy (filtered, work, signal_length * sizeof (double));
+  free (work);
+  return 0;
+}
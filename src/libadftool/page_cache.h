@@ -0,0 +1,453 @@
+#ifndef H_ADFTOOL_PAGE_CACHE_INCLUDED
+# define H_ADFTOOL_PAGE_CACHE_INCLUDED
+
+# include <stdlib.h>
+# include <string.h>
+# include <stdbool.h>
+# include <stdint.h>
+# include <pthread.h>
+# include <assert.h>
+# include "safe-alloc.h"
+
+/* A cache of pages of at most page_bytes, shared by several owners,
+   within a byte budget. A page is identified by its owner and its
+   index. When the cache is full, the CLOCK algorithm evicts a page
+   that has not been read since the hand last passed over it, whatever
+   its owner. The pages are found with a hash table, chained through
+   the entries, so that the cache lock is held for a constant time.
+
+   The pages may be smaller than page_bytes, if they are compressed:
+   then, more of them fit in the budget, up to PAGE_CACHE_MAX_PACKING
+   times as many as full pages. */
+
+# define DEALLOC_PAGE_CACHE \
+  ATTRIBUTE_DEALLOC (page_cache_free, 1)
+
+struct page_cache;
+
+MAYBE_UNUSED static void page_cache_free (struct page_cache *cache);
+
+MAYBE_UNUSED DEALLOC_PAGE_CACHE
+  static struct page_cache *page_cache_alloc (size_t page_bytes,
+					      size_t budget);
+
+/* The end of a bucket chain. */
+# define PAGE_CACHE_NONE SIZE_MAX
+
+# define PAGE_CACHE_MAX_PACKING 16
+
+struct page_cache_entry
+{
+  const void *owner;
+  size_t index;
+  void *page;
+  size_t size;
+  bool referenced;
+  /* The next entry in the same bucket. */
+  size_t next;
+};
+
+struct page_cache
+{
+  pthread_mutex_t synchronizer;
+  size_t page_bytes;
+  size_t budget;
+  size_t used_bytes;
+  /* The number of full pages that fit in the budget. */
+  size_t max_pages;
+  /* The entries grow up to max_entries, when the pages are small. */
+  size_t max_entries;
+  size_t n_entries;
+  size_t n_pages;
+  struct page_cache_entry *entries;
+  size_t hand;
+  size_t n_owners;
+  /* A power of 2, at least max_entries. */
+  size_t n_buckets;
+  size_t *buckets;
+};
+
+static struct page_cache *
+page_cache_alloc (size_t page_bytes, size_t budget)
+{
+  /* The cache holds at least one page, even if the budget is
+     smaller. */
+  struct page_cache *ret = NULL;
+  if (ALLOC (ret) < 0)
+    {
+      goto failure;
+    }
+  ret->page_bytes = page_bytes;
+  ret->budget = budget;
+  ret->used_bytes = 0;
+  ret->max_pages = budget / page_bytes;
+  if (ret->max_pages == 0)
+    {
+      ret->max_pages = 1;
+    }
+  ret->max_entries = ret->max_pages * PAGE_CACHE_MAX_PACKING;
+  ret->n_entries = ret->max_pages;
+  ret->n_pages = 0;
+  ret->hand = 0;
+  ret->n_owners = 0;
+  ret->n_buckets = 1;
+  while (ret->n_buckets < ret->max_entries)
+    {
+      ret->n_buckets *= 2;
+    }
+  if (ALLOC_N (ret->entries, ret->n_entries) < 0)
+    {
+      goto failure_cache;
+    }
+  if (ALLOC_N (ret->buckets, ret->n_buckets) < 0)
+    {
+      goto failure_entries;
+    }
+  for (size_t i = 0; i < ret->n_buckets; i++)
+    {
+      ret->buckets[i] = PAGE_CACHE_NONE;
+    }
+  if (pthread_mutex_init (&(ret->synchronizer), NULL) != 0)
+    {
+      goto failure_buckets;
+    }
+  return ret;
+failure_buckets:
+  FREE (ret->buckets);
+failure_entries:
+  FREE (ret->entries);
+failure_cache:
+  FREE (ret);
+failure:
+  return NULL;
+}
+
+static void
+page_cache_free (struct page_cache *cache)
+{
+  if (cache != NULL)
+    {
+      for (size_t i = 0; i < cache->n_pages; i++)
+	{
+	  FREE (cache->entries[i].page);
+	}
+      FREE (cache->entries);
+      FREE (cache->buckets);
+      if (pthread_mutex_destroy (&(cache->synchronizer)) != 0)
+	{
+	  abort ();
+	}
+    }
+  FREE (cache);
+}
+
+static inline void
+page_cache_lock (struct page_cache *cache)
+{
+  if (pthread_mutex_lock (&(cache->synchronizer)) != 0)
+    {
+      abort ();
+    }
+}
+
+static inline void
+page_cache_unlock (struct page_cache *cache)
+{
+  if (pthread_mutex_unlock (&(cache->synchronizer)) != 0)
+    {
+      abort ();
+    }
+}
+
+static inline size_t *
+page_cache_bucket (const struct page_cache *cache, const void *owner,
+		   size_t index)
+{
+  /* Fibonacci hashing of the owner address and the page index. */
+  const uint64_t key =
+    ((uint64_t) (uintptr_t) owner) ^ ((uint64_t) index * 0x9E3779B97F4A7C15);
+  const uint64_t hash = (key ^ (key >> 29)) * 0xBF58476D1CE4E5B9;
+  return &(cache->buckets[(hash >> 32) & (cache->n_buckets - 1)]);
+}
+
+static inline size_t
+page_cache_find (const struct page_cache *cache, const void *owner,
+		 size_t index)
+{
+  /* Return the position of the page in the entries, or n_pages if it
+     is not there. The cache must be locked. */
+  size_t i = *page_cache_bucket (cache, owner, index);
+  while (i != PAGE_CACHE_NONE
+	 && (cache->entries[i].owner != owner
+	     || cache->entries[i].index != index))
+    {
+      i = cache->entries[i].next;
+    }
+  if (i == PAGE_CACHE_NONE)
+    {
+      return cache->n_pages;
+    }
+  return i;
+}
+
+static inline void
+page_cache_link (struct page_cache *cache, size_t i)
+{
+  size_t *bucket =
+    page_cache_bucket (cache, cache->entries[i].owner,
+		       cache->entries[i].index);
+  cache->entries[i].next = *bucket;
+  *bucket = i;
+}
+
+static inline void
+page_cache_unlink (struct page_cache *cache, size_t i)
+{
+  size_t *link =
+    page_cache_bucket (cache, cache->entries[i].owner,
+		       cache->entries[i].index);
+  while (*link != i)
+    {
+      link = &(cache->entries[*link].next);
+    }
+  *link = cache->entries[i].next;
+}
+
+static inline void
+page_cache_register (struct page_cache *cache)
+{
+  page_cache_lock (cache);
+  cache->n_owners += 1;
+  page_cache_unlock (cache);
+}
+
+static inline size_t
+page_cache_share (struct page_cache *cache)
+{
+  /* The number of pages that each owner can expect to keep, at the
+     current mean page size. */
+  page_cache_lock (cache);
+  size_t n_owners = cache->n_owners;
+  if (n_owners == 0)
+    {
+      n_owners = 1;
+    }
+  uint64_t capacity = cache->max_pages;
+  if (cache->used_bytes != 0)
+    {
+      /* budget * n_pages / used_bytes, dividing first so that it does
+         not wrap around where size_t has 32 bits. */
+      const uint64_t whole = cache->budget / cache->used_bytes;
+      const uint64_t rest = cache->budget % cache->used_bytes;
+      capacity = cache->max_entries;
+      if (whole < cache->max_entries)
+	{
+	  capacity =
+	    whole * cache->n_pages + rest * cache->n_pages / cache->used_bytes;
+	}
+    }
+  if (capacity < cache->max_pages)
+    {
+      capacity = cache->max_pages;
+    }
+  if (capacity > cache->max_entries)
+    {
+      capacity = cache->max_entries;
+    }
+  size_t share = (size_t) capacity / n_owners;
+  page_cache_unlock (cache);
+  if (share == 0)
+    {
+      share = 1;
+    }
+  return share;
+}
+
+static inline bool
+page_cache_has (struct page_cache *cache, const void *owner, size_t index)
+{
+  page_cache_lock (cache);
+  const bool ret = (page_cache_find (cache, owner, index) < cache->n_pages);
+  page_cache_unlock (cache);
+  return ret;
+}
+
+static inline bool
+page_cache_touch (struct page_cache *cache, const void *owner, size_t index)
+{
+  /* Protect the page from the next eviction, because it is still
+     useful. Return false if it is not in cache. */
+  page_cache_lock (cache);
+  const size_t i = page_cache_find (cache, owner, index);
+  const bool found = (i < cache->n_pages);
+  if (found)
+    {
+      cache->entries[i].referenced = true;
+    }
+  page_cache_unlock (cache);
+  return found;
+}
+
+static inline bool
+page_cache_read (struct page_cache *cache, const void *owner, size_t index,
+		 void *page)
+{
+  /* Copy the page, and protect it from the next eviction. Return
+     false if it is not in cache. page must have room for page_bytes,
+     but only the size of the page is copied. */
+  page_cache_lock (cache);
+  const size_t i = page_cache_find (cache, owner, index);
+  const bool found = (i < cache->n_pages);
+  if (found)
+    {
+      memcpy (page, cache->entries[i].page, cache->entries[i].size);
+      cache->entries[i].referenced = true;
+    }
+  page_cache_unlock (cache);
+  return found;
+}
+
+static inline void
+page_cache_remove (struct page_cache *cache, size_t i)
+{
+  /* Drop the page at i, and move the last entry there. */
+  FREE (cache->entries[i].page);
+  cache->used_bytes -= cache->entries[i].size;
+  page_cache_unlink (cache, i);
+  cache->n_pages -= 1;
+  const size_t last = cache->n_pages;
+  if (i != last)
+    {
+      page_cache_unlink (cache, last);
+      cache->entries[i] = cache->entries[last];
+      cache->entries[last].page = NULL;
+      page_cache_link (cache, i);
+    }
+  if (cache->hand == last)
+    {
+      cache->hand = i;
+    }
+  if (cache->hand >= cache->n_pages)
+    {
+      cache->hand = 0;
+    }
+}
+
+static inline bool
+page_cache_is_full (struct page_cache *cache, size_t size)
+{
+  /* Whether a page must be evicted before inserting one of size
+     bytes. The cache always has room for one page. */
+  if (cache->n_pages == 0)
+    {
+      return false;
+    }
+  if (cache->used_bytes + size > cache->budget)
+    {
+      return true;
+    }
+  if (cache->n_pages == cache->n_entries
+      && cache->n_entries < cache->max_entries)
+    {
+      size_t n_entries = 2 * cache->n_entries;
+      if (n_entries > cache->max_entries)
+	{
+	  n_entries = cache->max_entries;
+	}
+      struct page_cache_entry *entries =
+	realloc (cache->entries, n_entries * sizeof (*entries));
+      if (entries != NULL)
+	{
+	  cache->entries = entries;
+	  cache->n_entries = n_entries;
+	}
+    }
+  /* If the entries cannot grow, evict. */
+  return (cache->n_pages == cache->n_entries);
+}
+
+static inline void
+page_cache_insert (struct page_cache *cache, const void *owner,
+		   size_t index, void *page, size_t size)
+{
+  /* The cache takes ownership of page, which has been allocated with
+     malloc, and holds size bytes, at most page_bytes. */
+  assert (size <= cache->page_bytes);
+  page_cache_lock (cache);
+  /* The page goes in slot, or after the last one if it is
+     PAGE_CACHE_NONE. */
+  size_t slot = page_cache_find (cache, owner, index);
+  if (slot == cache->n_pages)
+    {
+      slot = PAGE_CACHE_NONE;
+    }
+  else if (cache->used_bytes - cache->entries[slot].size + size
+	   > cache->budget)
+    {
+      /* The new page is bigger, and needs room. */
+      page_cache_remove (cache, slot);
+      slot = PAGE_CACHE_NONE;
+    }
+  while (slot == PAGE_CACHE_NONE && page_cache_is_full (cache, size))
+    {
+      while (cache->entries[cache->hand].referenced)
+	{
+	  cache->entries[cache->hand].referenced = false;
+	  cache->hand = (cache->hand + 1) % cache->n_pages;
+	}
+      if (cache->used_bytes - cache->entries[cache->hand].size + size
+	  <= cache->budget)
+	{
+	  /* The new page takes the place of the last evicted one, so
+	     that the hand passes over it last. */
+	  slot = cache->hand;
+	  cache->hand = (cache->hand + 1) % cache->n_pages;
+	}
+      else
+	{
+	  page_cache_remove (cache, cache->hand);
+	}
+    }
+  if (slot == PAGE_CACHE_NONE)
+    {
+      slot = cache->n_pages;
+      cache->n_pages += 1;
+    }
+  else
+    {
+      FREE (cache->entries[slot].page);
+      cache->used_bytes -= cache->entries[slot].size;
+      page_cache_unlink (cache, slot);
+    }
+  cache->entries[slot].owner = owner;
+  cache->entries[slot].index = index;
+  cache->entries[slot].page = page;
+  cache->entries[slot].size = size;
+  cache->entries[slot].referenced = true;
+  cache->used_bytes += size;
+  page_cache_link (cache, slot);
+  page_cache_unlock (cache);
+}
+
+static inline void
+page_cache_unregister (struct page_cache *cache, const void *owner)
+{
+  /* Drop all the pages of owner. */
+  page_cache_lock (cache);
+  size_t i = 0;
+  while (i < cache->n_pages)
+    {
+      if (cache->entries[i].owner == owner)
+	{
+	  page_cache_remove (cache, i);
+	}
+      else
+	{
+	  i++;
+	}
+    }
+  cache->n_owners -= 1;
+  page_cache_unlock (cache);
+}
+
+#endif /* not H_ADFTOOL_PAGE_CACHE_INCLUDED */
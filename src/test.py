@@ -1,3 +1,4 @@
+import array
 import os
 import sys
 
@@ -91,3 +92,31 @@ assert strings[0][0] == b'foo'
 assert strings[0][1] is None
 assert strings[1][0] == b'hello, world!'
 assert strings[1][1] == b'en-us'
+
+eeg_values = [ 1.5, -2.0, 3.25, 0.0, -1.0, 4.0, 2.0, -3.5 ]
+f.set_eeg_data (4, 2, eeg_values)
+
+def decoded_near (actual, expected):
+    return abs (actual - expected) < 1e-3
+
+n_points, n_channels, floats = f.get_eeg_data_float (1, 2)
+floats = array.array ('f', floats)
+print('Single precision EEG data:', list (floats))
+assert n_points == 2
+assert n_channels == 2
+assert len (floats) == 4
+for i in range (4):
+    assert decoded_near (floats[i], eeg_values[2 + i])
+
+n_points, n_channels, codes, block_length, scales, offsets = f.get_eeg_data_raw (1, 2)
+codes = array.array ('H', codes)
+print('Raw EEG data:', list (codes), block_length, scales, offsets)
+assert n_points == 2
+assert n_channels == 2
+assert len (codes) == 4
+assert block_length > 0
+assert len (scales) == 2
+assert len (offsets) == 2
+for i in range (4):
+    j = i % 2
+    assert decoded_near (codes[i] * scales[j] + offsets[j], eeg_values[2 + i])